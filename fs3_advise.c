@@ -0,0 +1,252 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_advise.c
+//  Description    : This is the implementation of fs3_advise, access hints
+//                   in the manner of posix_fadvise.  NOREUSE files put the
+//                   sectors they read and write at the cold end of the cache,
+//                   DONTNEED drops a range from the cache, and WILLNEED and
+//                   SEQUENTIAL readahead queue sectors for a prefetch thread
+//                   that reads them in track order between driver calls.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_driver.h>
+#include <fs3_driver_pi.h>
+#include <fs3_ctx_pi.h>
+#include <fs3_cache.h>
+#include <fs3_metrics.h>
+
+//
+// Defines
+#define FS3_ADVISE_BATCH 16           // Sectors prefetched per hold of the driver lock
+
+//
+// Implementation
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : prefetch_thread
+// Description  : Read queued sectors into the cache until stopped, at the
+//                cold end for NOREUSE files.  Runs with the driver lock and
+//                after each batch waits until the calls that queued up on
+//                it (in lock_volume) have had it, so the foreground is never
+//                held up by more than one batch.  With I/O classes each batch is
+//                one class's and is admitted as a request of that class.
+//
+// Inputs       : arg - the volume
+// Outputs      : NULL
+
+void *prefetch_thread(void *arg) {
+	struct SectorRead batch[FS3_ADVISE_BATCH];
+	char buf[FS3_SECTOR_SIZE];
+	int i, n, cls, queued;
+
+	fs3_cur = arg;
+	pthread_mutex_lock(&fs3_cur->lock);
+	while (!fs3_cur->pf_stop) {
+		if (fs3_cur->pf_count == 0) {
+			pthread_cond_wait(&fs3_cur->pf_cond, &fs3_cur->lock);
+			continue;
+		}
+
+		// take the batch of one class needing the fewest seeks from where
+		// the disk is now
+		qsort(fs3_cur->pf_queue, fs3_cur->pf_count, sizeof(struct SectorRead), compare_reads);
+		cls = fs3_cur->pf_queue[0].cls;
+		for (i = n = 0; i < fs3_cur->pf_count; i++) {
+			if ((n < FS3_ADVISE_BATCH) && (fs3_cur->pf_queue[i].cls == cls)) {
+				batch[n++] = fs3_cur->pf_queue[i];
+			} else {
+				fs3_cur->pf_queue[i - n] = fs3_cur->pf_queue[i];
+			}
+		}
+		fs3_cur->pf_count -= n;
+
+		// it waits its turn at the controller like any read of the class
+		if ((queued = fs3_cur->qos_on)) {
+			pthread_mutex_unlock(&fs3_cur->lock);
+			admit_class(cls, n * FS3_SECTOR_SIZE);
+			pthread_mutex_lock(&fs3_cur->lock);
+		}
+		for (i = 0; (i < n) && !fs3_cur->pf_stop; i++) {
+			if (fs3_in_cache(batch[i].track, batch[i].sector)) continue;
+			fix_track(batch[i].track);
+			fs3_syscall(FS3_OP_RDSECT, batch[i].sector, 0, 0, buf);
+			fs3_fill_cache(batch[i].track, batch[i].sector, buf, batch[i].cold);
+			fs3_metrics_add(FS3_CNT_PREFETCH, FS3_SECTOR_SIZE);
+		}
+		if (queued) fs3_qos_done();
+
+		// hand the lock to the calls that came in during the batch
+		while (__atomic_load_n(&fs3_cur->lock_waiters, __ATOMIC_RELAXED) && !fs3_cur->pf_stop) {
+			pthread_cond_wait(&fs3_cur->pf_cond, &fs3_cur->lock);
+		}
+	}
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : prefetch_range
+// Description  : Queue the placed, uncached blocks of a range of a file for
+//                the prefetch thread (called with the driver lock)
+//
+// Inputs       : fptr - the file
+//                first - first block
+//                last - block after the last one
+// Outputs      : number of sectors queued
+
+int prefetch_range(struct File *fptr, uint32_t first, uint32_t last) {
+	struct Block *bptr = fptr->bhead;
+	uint32_t blk;
+	int queued = 0;
+
+	for (blk = 0; bptr && (blk < first); blk++) {
+		bptr = bptr->next;
+	}
+	for (; bptr && (blk < last); blk++, bptr = bptr->next) {
+		if ((bptr->track == FS3_NO_TRACK) || fs3_in_cache(bptr->track, bptr->sector)) continue;
+		if (fs3_cur->pf_count == fs3_cur->pf_max) {
+			fs3_cur->pf_max = fs3_cur->pf_max ? fs3_cur->pf_max * 2 : 64;
+			fs3_cur->pf_queue = realloc(fs3_cur->pf_queue, sizeof(struct SectorRead) * fs3_cur->pf_max);
+		}
+		memset(&fs3_cur->pf_queue[fs3_cur->pf_count], 0x0, sizeof(struct SectorRead));
+		fs3_cur->pf_queue[fs3_cur->pf_count].track = bptr->track;
+		fs3_cur->pf_queue[fs3_cur->pf_count].sector = bptr->sector;
+		fs3_cur->pf_queue[fs3_cur->pf_count].cls = fptr->qos_class;
+		fs3_cur->pf_queue[fs3_cur->pf_count++].cold = fptr->noreuse;
+		queued++;
+	}
+	if (queued == 0) return 0;
+
+	if (!fs3_cur->pf_running) {
+		fs3_cur->pf_stop = 0;
+		if (pthread_create(&fs3_cur->pf_thread, NULL, prefetch_thread, fs3_cur) != 0) {
+			logMessage(LOG_ERROR_LEVEL, "fs3_advise could not start the prefetch thread");
+			fs3_cur->pf_count = 0;
+			return 0;
+		}
+		fs3_cur->pf_running = 1;
+	}
+	pthread_cond_signal(&fs3_cur->pf_cond);
+	return queued;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : advise_readahead
+// Description  : Keep the next FS3_ADVISE_READAHEAD blocks past the file
+//                position queued for a file read sequentially (called with
+//                the driver lock after each read of the file's blocks)
+//
+// Inputs       : fptr - the file
+// Outputs      : none
+
+void advise_readahead(struct File *fptr) {
+	uint32_t first = (fptr->loc + FS3_SECTOR_SIZE - 1) / FS3_SECTOR_SIZE;
+	uint32_t last = first + FS3_ADVISE_READAHEAD;
+	uint32_t nblocks = (fptr->size + FS3_SECTOR_SIZE - 1) / FS3_SECTOR_SIZE;
+
+	// only the part of the window not queued by an earlier read
+	if (first < fptr->ra_next) first = fptr->ra_next;
+	if (last > nblocks) last = nblocks;
+	if (first >= last) return;
+	prefetch_range(fptr, first, last);
+	fptr->ra_next = last;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_advise_shutdown
+// Description  : Stop the prefetch thread and free the queue, called at
+//                unmount without the driver lock
+//
+// Inputs       : none
+// Outputs      : none
+
+void fs3_advise_shutdown(void) {
+	lock_volume();
+	fs3_cur->pf_count = 0;
+	fs3_cur->pf_stop = 1;
+	pthread_cond_broadcast(&fs3_cur->pf_cond);
+	pthread_mutex_unlock(&fs3_cur->lock);
+	if (fs3_cur->pf_running) {
+		pthread_join(fs3_cur->pf_thread, NULL);
+		fs3_cur->pf_running = 0;
+	}
+	free(fs3_cur->pf_queue);
+	fs3_cur->pf_queue = NULL;
+	fs3_cur->pf_max = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_advise
+// Description  : Tell the driver how a range of an open file will be used
+//
+// Inputs       : fd - the file descriptor
+//                offset - start of the range
+//                len - bytes in the range, 0 for the rest of the file
+//                hint - one of FS3AdviceTypes
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_advise(int16_t fd, uint32_t offset, uint32_t len, int hint) {
+	struct File *fptr;
+	struct Block *bptr;
+	uint32_t first, last, blk;
+
+	lock_volume();
+	fptr = get_file_by_fd(fd);
+	if (!fptr || !fptr->is_open || (hint < FS3_ADVICE_NORMAL) || (hint > FS3_ADVICE_DONTNEED)) {
+		pthread_mutex_unlock(&fs3_cur->lock);
+		return -1;
+	}
+
+	// the range in blocks, clipped to the file
+	first = offset / FS3_SECTOR_SIZE;
+	last = ((len == 0) || ((uint64_t) offset + len > fptr->size)) ? fptr->size : offset + len;
+	last = (last + FS3_SECTOR_SIZE - 1) / FS3_SECTOR_SIZE;
+
+	switch (hint) {
+	case FS3_ADVICE_NORMAL:
+		fptr->noreuse = 0;
+		// fall through
+	case FS3_ADVICE_SEQUENTIAL:
+	case FS3_ADVICE_RANDOM:
+		fptr->advice = hint;
+		fptr->ra_next = 0;
+		break;
+
+	case FS3_ADVICE_NOREUSE:
+		fptr->noreuse = 1;
+		break;
+
+	case FS3_ADVICE_WILLNEED:
+		if (!fptr->slot) {
+			prefetch_range(fptr, first, last);
+		}
+		break;
+
+	case FS3_ADVICE_DONTNEED:
+		// a slot sector holds other files too, leave it alone
+		if (fptr->slot) break;
+		for (blk = 0, bptr = fptr->bhead; bptr && (blk < last); blk++, bptr = bptr->next) {
+			if ((blk >= first) && (bptr->track != FS3_NO_TRACK)) {
+				fs3_drop_cache(bptr->track, bptr->sector);
+			}
+		}
+		break;
+	}
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return 0;
+}
@@ -0,0 +1,536 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_bench.c
+//  Description    : This is the microbenchmark driver for the FS3 cache,
+//                   driver and network layers.  Each benchmark emits one
+//                   JSON object per line so results can be compared across
+//                   builds.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+// Project Includes
+#include <fs3_driver.h>
+#include <fs3_controller.h>
+#include <fs3_common.h>
+#include <fs3_cache.h>
+#include <fs3_network.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define FS3_BENCH_DEFAULT_OPS 10000
+#define FS3_BENCH_FILE_SIZE (4*1024*1024)
+#define FS3_BENCH_NET_TRACK (FS3_MAX_TRACKS-1)
+#define FS3_BENCH_SMALL_MIN 16
+#define FS3_BENCH_SMALL_MAX 400
+#define FS3_ARGUMENTS "hvn:o:s:l:i:p:"
+#define USAGE \
+	"USAGE: fs3_bench [-h] [-v] [-n <ops>] [-o <outfile>] [-s <suites>] [-l <logfile>]\n" \
+	"\n" \
+	"where:\n" \
+	"    -h - help mode (display this message)\n" \
+	"    -v - verbose output\n" \
+	"    -n - number of operations per benchmark (default 10000)\n" \
+	"    -o - write results to <outfile> instead of stdout\n" \
+	"    -s - comma separated suites to run (cache,network,driver,open,small)\n" \
+	"    -l - write log messages to the filename <logfile>\n" \
+	"    -i - IP address of server to connect to.\n" \
+	"    -p - port number of server to connect to.\n" \
+	"\n" \
+	"    The network, driver, open and small suites require a running fs3_server.\n" \
+	"\n" \
+
+//
+// Global Data
+int bench_ops = FS3_BENCH_DEFAULT_OPS;
+FILE *bench_out = NULL;
+uint64_t *bench_lat = NULL;
+uint64_t bench_seed = 0x2545F4914F6CDD1DULL;
+
+//
+// Functional Prototypes
+
+int bench_cache(void);                      // Cache put/get benchmarks
+int bench_network(void);                    // Raw controller round trips
+int bench_driver(void);                     // fs3_read/fs3_write benchmarks
+int bench_open(void);                       // fs3_open lookup benchmarks
+int bench_small(void);                      // Tiny file capacity and access
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_now
+// Description  : Get a monotonic timestamp in nanoseconds
+//
+// Inputs       : none
+// Outputs      : the current time
+
+static inline uint64_t bench_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_rand
+// Description  : Deterministic xorshift generator so runs are repeatable
+//
+// Inputs       : none
+// Outputs      : the next pseudo-random value
+
+static inline uint64_t bench_rand(void) {
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 7;
+	bench_seed ^= bench_seed << 17;
+	return bench_seed;
+}
+
+static int compare_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
+
+static uint64_t percentile(uint64_t *lat, int n, double p) {
+	int idx = (int) (p * (n - 1) + 0.5);
+	return lat[idx];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_report
+// Description  : Sort the collected latencies and write one JSON result line
+//
+// Inputs       : suite - the suite name
+//                name - the benchmark name
+//                params - pre-formatted JSON members describing the run
+//                n - the number of latencies collected in bench_lat
+//                elapsed - total wall time of the run in nanoseconds
+// Outputs      : 0 if successful, -1 if failure
+
+int bench_report(const char *suite, const char *name, const char *params, int n, uint64_t elapsed) {
+	if (n <= 0) return -1;
+	qsort(bench_lat, n, sizeof(uint64_t), compare_u64);
+	fprintf(bench_out, "{\"suite\":\"%s\",\"bench\":\"%s\",%s%s\"ops\":%d,"
+		"\"ops_per_sec\":%.1f,\"lat_ns\":{\"min\":%lu,\"p50\":%lu,\"p90\":%lu,"
+		"\"p99\":%lu,\"p999\":%lu,\"max\":%lu}}\n",
+		suite, name, params, *params ? "," : "", n,
+		elapsed ? n * 1e9 / elapsed : 0.0,
+		bench_lat[0], percentile(bench_lat, n, 0.50), percentile(bench_lat, n, 0.90),
+		percentile(bench_lat, n, 0.99), percentile(bench_lat, n, 0.999), bench_lat[n-1]);
+	fflush(bench_out);
+	logMessage(FS3SimulatorLLevel, "FS3_BENCH : %s/%s %s done, %d ops.", suite, name, params, n);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the FS3 benchmark
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main( int argc, char *argv[] ) {
+
+	// Local variables
+	int ch, verbose = 0, log_initialized = 0, err = 0;
+	char *suites = "cache,network,driver,open,small";
+
+	// Process the command line parameters
+	bench_out = stdout;
+	while ((ch = getopt(argc, argv, FS3_ARGUMENTS)) != -1) {
+
+		switch (ch) {
+		case 'h': // Help, print usage
+			fprintf( stderr, USAGE );
+			return( -1 );
+
+		case 'v': // Verbose Flag
+			verbose = 1;
+			break;
+
+		case 'n': // Number of operations
+			if ( (sscanf(optarg, "%d", &bench_ops) != 1) || (bench_ops <= 0) ) {
+				fprintf( stderr, "Bad operation count [%s]\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'o': // Output file
+			if ( (bench_out = fopen(optarg, "w")) == NULL ) {
+				fprintf( stderr, "Failed opening output file [%s]\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 's': // Suite selection
+			suites = optarg;
+			break;
+
+		case 'l': // Set the log filename
+			initializeLogWithFilename( optarg );
+			log_initialized = 1;
+			break;
+
+		case 'i': // Get the IP address
+			if (inet_addr(optarg) == INADDR_NONE) {
+				fprintf( stderr, "Bad IP address [%s]\n", optarg );
+				return(-1);
+			}
+			fs3_network_address = (unsigned char *)strdup(optarg);
+			break;
+
+		case 'p': // Set the network port number
+			if ( sscanf(optarg, "%hu", &fs3_network_port) != 1 ) {
+				fprintf( stderr, "Bad port number [%s]\n", optarg );
+				return(-1);
+			}
+			break;
+
+		default:  // Default (unknown)
+			fprintf( stderr, "Unknown command line option (%c), aborting.\n", ch );
+			return( -1 );
+		}
+	}
+
+	// Setup the log as needed
+	if ( ! log_initialized ) {
+		initializeLogWithFilehandle( CMPSC311_LOG_STDERR );
+	}
+	FS3DriverLLevel = registerLogLevel("FS3_DRIVER", 0);          // Driver log level
+	FS3SimulatorLLevel = registerLogLevel("FS3_SIMULATOR", 0);    // Simulator log level
+	if ( verbose ) {
+		enableLogLevels(FS3SimulatorLLevel);
+	}
+
+	// Latency samples are shared by every benchmark
+	if ( (bench_lat = malloc(sizeof(uint64_t) * bench_ops)) == NULL ) {
+		logMessage( LOG_ERROR_LEVEL, "FS3 benchmark failed allocating sample buffer." );
+		return( -1 );
+	}
+
+	// The cache suite runs standalone, the rest share one mounted disk
+	if ( strstr(suites, "cache") ) {
+		err |= bench_cache();
+	}
+	if ( strstr(suites, "network") || strstr(suites, "driver") || strstr(suites, "open") ||
+		 strstr(suites, "small") ) {
+		if ( (fs3_mount_disk() == -1) || (fs3_init_cache(FS3_DEFAULT_CACHE_SIZE) == -1) ) {
+			logMessage( LOG_ERROR_LEVEL, "FS3 benchmark failed to mount disk." );
+			return( -1 );
+		}
+		fs3_mkdir("bench");
+		if ( strstr(suites, "network") ) err |= bench_network();
+		if ( strstr(suites, "driver") ) err |= bench_driver();
+		if ( strstr(suites, "open") ) err |= bench_open();
+		if ( strstr(suites, "small") ) err |= bench_small();
+		fs3_unmount_disk();
+		fs3_close_cache();
+	}
+
+	free(bench_lat);
+	if ( bench_out != stdout ) {
+		fclose( bench_out );
+	}
+	return( err ? -1 : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_cache
+// Description  : Time cache lookups (with insert on miss) across cache sizes
+//                and target hit ratios.  The working set is sized so that
+//                uniform random access yields roughly the target hit ratio.
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int bench_cache(void) {
+
+	// Local variables
+	static const int sizes[] = { 64, 256, 1024, 4096, 16384 };
+	static const double hits[] = { 0.50, 0.90, 0.99 };
+	char buf[FS3_SECTOR_SIZE], params[128];
+	int s, h, i, hitcnt, wset, key;
+	uint64_t start, t0, t1;
+
+	memset(buf, 0xa5, FS3_SECTOR_SIZE);
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		for (h = 0; h < sizeof(hits) / sizeof(hits[0]); h++) {
+
+			// Warm the cache with the first part of the working set
+			wset = (int) (sizes[s] / hits[h]);
+			fs3_init_cache(sizes[s]);
+			for (i = 0; i < sizes[s]; i++) {
+				fs3_put_cache(i / FS3_TRACK_SIZE, i % FS3_TRACK_SIZE, buf);
+			}
+
+			// Now do the timed accesses
+			hitcnt = 0;
+			start = bench_now();
+			for (i = 0; i < bench_ops; i++) {
+				key = bench_rand() % wset;
+				t0 = bench_now();
+				if (fs3_get_cache(key / FS3_TRACK_SIZE, key % FS3_TRACK_SIZE)) {
+					hitcnt++;
+				} else {
+					fs3_put_cache(key / FS3_TRACK_SIZE, key % FS3_TRACK_SIZE, buf);
+				}
+				t1 = bench_now();
+				bench_lat[i] = t1 - t0;
+			}
+			t1 = bench_now();
+			fs3_close_cache();
+
+			snprintf(params, sizeof(params), "\"cachelines\":%d,\"target_hit\":%.2f,"
+				"\"hit_ratio\":%.4f", sizes[s], hits[h], (double) hitcnt / bench_ops);
+			bench_report("cache", "access", params, bench_ops, t1 - start);
+		}
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_network
+// Description  : Time raw controller round trips through network_fs3_syscall.
+//                Uses the last track so file data is never touched.
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int bench_network(void) {
+
+	// Local variables
+	static const int ops[] = { FS3_OP_TSEEK, FS3_OP_WRSECT, FS3_OP_RDSECT };
+	static const char *names[] = { "tseek", "wrsect", "rdsect" };
+	char buf[FS3_SECTOR_SIZE];
+	FS3CmdBlk cmd, ret;
+	int o, i;
+	uint64_t start, t0, t1;
+
+	memset(buf, 0x5a, FS3_SECTOR_SIZE);
+	for (o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+
+		// Park on the benchmark track before the sector operations
+		cmd = construct_cmdBlock(FS3_OP_TSEEK, 0, FS3_BENCH_NET_TRACK, 0);
+		if (network_fs3_syscall(cmd, &ret, buf) == -1) {
+			logMessage( LOG_ERROR_LEVEL, "FS3 benchmark network seek failed." );
+			return( -1 );
+		}
+
+		start = bench_now();
+		for (i = 0; i < bench_ops; i++) {
+			if (ops[o] == FS3_OP_TSEEK) {
+				// Alternate tracks so every seek actually moves the head
+				cmd = construct_cmdBlock(ops[o], 0, FS3_BENCH_NET_TRACK - (i & 1), 0);
+			} else {
+				cmd = construct_cmdBlock(ops[o], i % FS3_TRACK_SIZE, 0, 0);
+			}
+			t0 = bench_now();
+			if (network_fs3_syscall(cmd, &ret, buf) == -1) {
+				logMessage( LOG_ERROR_LEVEL, "FS3 benchmark network %s failed.", names[o] );
+				return( -1 );
+			}
+			t1 = bench_now();
+			bench_lat[i] = t1 - t0;
+		}
+		bench_report("network", names[o], "", bench_ops, bench_now() - start);
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_driver
+// Description  : Time fs3_read/fs3_write at a range of I/O sizes, with
+//                sector-aligned and unaligned random offsets.
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int bench_driver(void) {
+
+	// Local variables
+	static const int iosizes[] = { 64, 512, 1024, 4096, 16384 };
+	char *buf, params[128], path[64];
+	int s, a, w, i, fd;
+	uint32_t off;
+	uint64_t start, t0, t1;
+
+	if ((buf = malloc(FS3_BENCH_FILE_SIZE)) == NULL) {
+		return( -1 );
+	}
+	memset(buf, 'b', FS3_BENCH_FILE_SIZE);
+
+	for (s = 0; s < sizeof(iosizes) / sizeof(iosizes[0]); s++) {
+
+		// Each I/O size gets its own pre-filled file, larger than the cache
+		snprintf(path, sizeof(path), "bench/driver-%05d", iosizes[s]);
+		fd = fs3_open(path);
+		if ((fd == -1) || (fs3_write(fd, buf, FS3_BENCH_FILE_SIZE) != FS3_BENCH_FILE_SIZE)) {
+			logMessage( LOG_ERROR_LEVEL, "FS3 benchmark failed creating [%s].", path );
+			free(buf);
+			return( -1 );
+		}
+
+		for (a = 0; a < 2; a++) {
+			for (w = 0; w < 2; w++) {
+				start = bench_now();
+				for (i = 0; i < bench_ops; i++) {
+					off = bench_rand() % (FS3_BENCH_FILE_SIZE - iosizes[s] - FS3_SECTOR_SIZE);
+					off = a ? off : off - off % FS3_SECTOR_SIZE;
+					t0 = bench_now();
+					fs3_seek(fd, off);
+					if ((w ? fs3_write(fd, buf, iosizes[s]) : fs3_read(fd, buf, iosizes[s])) != iosizes[s]) {
+						logMessage( LOG_ERROR_LEVEL, "FS3 benchmark I/O on [%s] failed.", path );
+						free(buf);
+						return( -1 );
+					}
+					t1 = bench_now();
+					bench_lat[i] = t1 - t0;
+				}
+				t1 = bench_now();
+
+				snprintf(params, sizeof(params), "\"iosize\":%d,\"aligned\":%s",
+					iosizes[s], a ? "false" : "true");
+				bench_report("driver", w ? "write" : "read", params, bench_ops, t1 - start);
+			}
+		}
+		fs3_close(fd);
+	}
+
+	free(buf);
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_open
+// Description  : Time fs3_open and fs3_stat of existing files as one
+//                directory grows to 10^5 entries
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int bench_open(void) {
+
+	// Local variables
+	static const int counts[] = { 16, 256, 4096, 100000 };
+	char path[64], params[64];
+	int c, i, fd, created = 0;
+	uint64_t start, elapsed, t0, t1;
+	FS3Stat st;
+
+	fs3_mkdir("bench/open");
+	for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+
+		// Grow the directory up to the next file count
+		for (; created < counts[c]; created++) {
+			snprintf(path, sizeof(path), "bench/open/f%06d", created);
+			fs3_close(fs3_open(path));
+		}
+
+		// Time the opens only, closing keeps the handle table small
+		elapsed = 0;
+		for (i = 0; i < bench_ops; i++) {
+			snprintf(path, sizeof(path), "bench/open/f%06d", (int) (bench_rand() % counts[c]));
+			t0 = bench_now();
+			fd = fs3_open(path);
+			t1 = bench_now();
+			if (fd == -1) {
+				logMessage( LOG_ERROR_LEVEL, "FS3 benchmark open of [%s] failed.", path );
+				return( -1 );
+			}
+			fs3_close(fd);
+			bench_lat[i] = t1 - t0;
+			elapsed += t1 - t0;
+		}
+		snprintf(params, sizeof(params), "\"files\":%d", counts[c]);
+		bench_report("open", "lookup", params, bench_ops, elapsed);
+
+		start = bench_now();
+		for (i = 0; i < bench_ops; i++) {
+			snprintf(path, sizeof(path), "bench/open/f%06d", (int) (bench_rand() % counts[c]));
+			t0 = bench_now();
+			if (fs3_stat(path, &st) == -1) {
+				logMessage( LOG_ERROR_LEVEL, "FS3 benchmark stat of [%s] failed.", path );
+				return( -1 );
+			}
+			t1 = bench_now();
+			bench_lat[i] = t1 - t0;
+		}
+		bench_report("open", "stat", params, bench_ops, bench_now() - start);
+	}
+	return( 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : bench_small
+// Description  : Create one tiny (16-400 byte) file per op and report the
+//                sectors they take, then time open+read of random ones
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int bench_small(void) {
+
+	// Local variables
+	char path[64], params[64], buf[FS3_BENCH_SMALL_MAX];
+	int i, fd, len;
+	uint64_t elapsed = 0, t0, t1;
+	FS3StatFs before, after;
+
+	memset(buf, 's', sizeof(buf));
+	fs3_mkdir("bench/small");
+	fs3_statfs(&before);
+	for (i = 0; i < bench_ops; i++) {
+		snprintf(path, sizeof(path), "bench/small/f%06d", i);
+		len = FS3_BENCH_SMALL_MIN + (int) (bench_rand() % (FS3_BENCH_SMALL_MAX - FS3_BENCH_SMALL_MIN + 1));
+		t0 = bench_now();
+		fd = fs3_open(path);
+		if ((fd == -1) || (fs3_write(fd, buf, len) != len)) {
+			logMessage( LOG_ERROR_LEVEL, "FS3 benchmark failed creating [%s].", path );
+			return( -1 );
+		}
+		fs3_close(fd);
+		t1 = bench_now();
+		bench_lat[i] = t1 - t0;
+		elapsed += t1 - t0;
+	}
+	fs3_statfs(&after);
+	snprintf(params, sizeof(params), "\"sectors\":%u", after.used_sectors - before.used_sectors);
+	bench_report("small", "create", params, bench_ops, elapsed);
+
+	elapsed = 0;
+	for (i = 0; i < bench_ops; i++) {
+		snprintf(path, sizeof(path), "bench/small/f%06d", (int) (bench_rand() % bench_ops));
+		t0 = bench_now();
+		fd = fs3_open(path);
+		if ((fd == -1) || (fs3_read(fd, buf, sizeof(buf)) < FS3_BENCH_SMALL_MIN)) {
+			logMessage( LOG_ERROR_LEVEL, "FS3 benchmark failed reading [%s].", path );
+			return( -1 );
+		}
+		fs3_close(fd);
+		t1 = bench_now();
+		bench_lat[i] = t1 - t0;
+		elapsed += t1 - t0;
+	}
+	bench_report("small", "open_read", params, bench_ops, elapsed);
+	return( 0 );
+}
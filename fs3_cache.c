@@ -16,16 +16,11 @@
 // Project Includes
 #include <fs3_cache.h>
 #include <fs3_cache_pi.h>
-
-//
-// Support Macros/Data
-int cache_size = 0;
-int cache_capacity = 0;
-
-int insert_count = 0;
-int get_count = 0;
-int hit_count = 0;
-int miss_count = 0;
+#include <fs3_ctx_pi.h>
+#include <fs3_metrics.h>
+#include <fs3_trace.h>
+#include <fs3_mrc.h>
+#include <fs3_lease.h>
 
 //
 // Implementation
@@ -44,15 +39,139 @@ int less(int track0, int sector0, int track1, int sector1) {
 // Outputs      : 0 if successful, -1 if failure
 
 int fs3_init_cache(uint16_t cachelines) {
-    croot = NULL;
-    chead = NULL;
-    ctail = NULL;
-    cache_size = 0;
-    cache_capacity = cachelines;
-    insert_count = 0;
-    get_count = 0;
-    hit_count = 0;
-    miss_count = 0;
+    if (fs3_cur->shm) {
+        shm_cache_detach();
+    }
+    if (fs3_cur->zc_buckets) {
+        zcache_close();
+    }
+    if (fs3_cur->l2) {
+        l2_cache_detach();
+    }
+    fs3_cur->croot = NULL;
+    fs3_cur->chead = NULL;
+    fs3_cur->ctail = NULL;
+    fs3_cur->cache_size = 0;
+    fs3_cur->cache_capacity = cachelines;
+    fs3_cur->insert_count = 0;
+    fs3_cur->get_count = 0;
+    fs3_cur->hit_count = 0;
+    fs3_cur->miss_count = 0;
+    if (fs3_cur->shm_name && (shm_cache_attach(fs3_cur->shm_name, cachelines) == -1)) {
+        return -1;
+    }
+    if (fs3_cur->l2_path && !fs3_cur->shm && cachelines && (l2_cache_attach() == -1)) {
+        return -1;
+    }
+    if (fs3_cur->zc_percent && !fs3_cur->shm && cachelines) {
+        if (zcache_init(split_cache(cachelines)) == -1) {
+            return -1;
+        }
+    }
+    return fs3_mrc_reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : split_cache
+// Description  : Split the memory of a number of cache lines between the
+//                uncompressed lines and the compressed tier's pages
+//
+// Inputs       : cachelines - the number of cache lines of memory
+// Outputs      : the pages of the compressed tier
+
+uint32_t split_cache(uint16_t cachelines) {
+    uint32_t pages = (uint32_t) cachelines * fs3_cur->zc_percent / 100 / (FS3_ZC_PAGE / FS3_SECTOR_SIZE);
+    uint32_t zlines = pages * (FS3_ZC_PAGE / FS3_SECTOR_SIZE);
+
+    fs3_cur->cache_capacity = (cachelines - zlines) ? cachelines - zlines : 1;
+    return pages;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_compress_cache
+// Description  : Keep part of the cache's memory compressed from the next
+//                fs3_init_cache.  Lines evicted from the uncompressed lines
+//                are compressed into it, so the same memory holds more
+//                lines when the data compresses.
+//
+// Inputs       : percent - share of the cache lines' memory, 0 for none
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_compress_cache(uint8_t percent) {
+    if (percent > FS3_ZC_MAX_PERCENT) {
+        logMessage(LOG_ERROR_LEVEL, "Compressed share %u%% is over %d%%", percent, FS3_ZC_MAX_PERCENT);
+        return -1;
+    }
+    fs3_cur->zc_percent = percent;
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_share_cache
+// Description  : Keep the cache in a shared-memory segment from the next
+//                fs3_init_cache, shared with every process naming it.  The
+//                first process to attach sizes the segment; it is removed
+//                when the last one closes its cache.
+//
+// Inputs       : name - the segment name ("/name"), NULL for a private cache
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_share_cache(const char *name) {
+    if (name && ((name[0] != '/') || strchr(name + 1, '/'))) {
+        logMessage(LOG_ERROR_LEVEL, "Shared cache name [%s] must be /name", name);
+        return -1;
+    }
+    free(fs3_cur->shm_name);
+    fs3_cur->shm_name = name ? strdup(name) : NULL;
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_cache_l2
+// Description  : Keep lines evicted from the cache in a victim file from the
+//                next fs3_init_cache.  Its lines are kept for the next run
+//                if the disk is logged and the cache is set up after mount.
+//
+// Inputs       : path - the file, NULL for none
+//                cachelines - lines it holds
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_cache_l2(const char *path, uint32_t cachelines) {
+    if (path && (cachelines < FS3_L2_WAYS)) {
+        logMessage(LOG_ERROR_LEVEL, "Victim file [%s] needs at least %d lines", path, FS3_L2_WAYS);
+        return -1;
+    }
+    free(fs3_cur->l2_path);
+    fs3_cur->l2_path = path ? strdup(path) : NULL;
+    fs3_cur->l2_lines = cachelines;
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_resize_cache
+// Description  : Change the number of cache lines without flushing; when
+//                shrinking, the least recently used sectors are dropped
+//
+// Inputs       : cachelines - the new number of cache lines
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_resize_cache(uint16_t cachelines) {
+    if (fs3_cur->shm) {
+        logMessage(LOG_ERROR_LEVEL, "The shared cache keeps the size it was created with");
+        return -1;
+    }
+    fs3_cur->cache_capacity = cachelines;
+    if (fs3_cur->zc_buckets) {
+        zcache_shrink(split_cache(cachelines));
+    }
+    while (fs3_cur->cache_size > fs3_cur->cache_capacity) {
+        fs3_cur->croot = pop_lru(fs3_cur->croot);
+    }
     return 0;
 }
 
@@ -65,10 +184,19 @@ int fs3_init_cache(uint16_t cachelines) {
 // Outputs      : 0 if successful, -1 if failure
 
 int fs3_close_cache(void)  {
-    while (chead) {
-        struct Cache *cptr = chead->next;
-        free(chead);
-        chead = cptr;
+    if (fs3_cur->shm) {
+        shm_cache_detach();
+    }
+    if (fs3_cur->zc_buckets) {
+        zcache_close();
+    }
+    if (fs3_cur->l2) {
+        l2_cache_detach();
+    }
+    while (fs3_cur->chead) {
+        struct Cache *cptr = fs3_cur->chead->next;
+        free(fs3_cur->chead);
+        fs3_cur->chead = cptr;
     }
     return 0;
 }
@@ -79,23 +207,24 @@ struct Cache * create_cache(int track, int sector, char *buf) {
     // load data
     cptr->track = track;
     cptr->sector = sector;
+    cptr->epoch = fs3_cur->lease_epoch[track];
     memcpy(cptr->data, buf, FS3_SECTOR_SIZE);
     cptr->left = NULL;
     cptr->right = NULL;
 
     // put into queue
-    if (chead == NULL) {
+    if (fs3_cur->chead == NULL) {
         cptr->prev = NULL;
         cptr->next = NULL;
-        chead = ctail = cptr;
+        fs3_cur->chead = fs3_cur->ctail = cptr;
     } else {
-        cptr->prev = ctail;
+        cptr->prev = fs3_cur->ctail;
         cptr->next = NULL;
-        ctail->next = cptr;
-        ctail = cptr;
+        fs3_cur->ctail->next = cptr;
+        fs3_cur->ctail = cptr;
     }
 
-    cache_size++;
+    fs3_cur->cache_size++;
     return cptr;
 }
 
@@ -128,18 +257,26 @@ struct Cache * remove_cache(struct Cache *cptr) {
     }
 
     // free cache, remove from queue
-    cache_size--;
-    chead = chead->next;
-    chead->prev = NULL;
+    fs3_cur->cache_size--;
+    if (cptr->prev) cptr->prev->next = cptr->next;
+    else fs3_cur->chead = cptr->next;
+    if (cptr->next) cptr->next->prev = cptr->prev;
+    else fs3_cur->ctail = cptr->prev;
     free(cptr);
 
     return curr;
 }
 
 struct Cache * pop_lru(struct Cache *cptr) {
-    if (cptr == chead) {
+    if (cptr == fs3_cur->chead) {
+        FS3_TRACE(FS3_TR_CACHE_EVICT, FS3_TR_INSTANT, cptr->track, cptr->sector, 0);
+        if (fs3_cur->zc_buckets) {
+            zcache_put(cptr->track, cptr->sector, cptr->data, cptr->epoch);
+        } else if (fs3_cur->l2) {
+            l2_cache_put(cptr->track, cptr->sector, cptr->data, cptr->epoch);
+        }
         return remove_cache(cptr);
-    } else if (less(cptr->track, cptr->sector, chead->track, chead->sector)) {
+    } else if (less(cptr->track, cptr->sector, fs3_cur->chead->track, fs3_cur->chead->sector)) {
         cptr->right = pop_lru(cptr->right);
     } else {
         cptr->left = pop_lru(cptr->left);
@@ -148,21 +285,64 @@ struct Cache * pop_lru(struct Cache *cptr) {
 }
 
 void move_to_tail(struct Cache *cptr) {
-    if (cptr != ctail) {
-        if (chead == cptr) {
-            chead = chead->next;
-            chead->prev = NULL;
+    if (cptr != fs3_cur->ctail) {
+        if (fs3_cur->chead == cptr) {
+            fs3_cur->chead = fs3_cur->chead->next;
+            fs3_cur->chead->prev = NULL;
         } else {
             cptr->prev->next = cptr->next;
             if (cptr->next) cptr->next->prev = cptr->prev;
         }
-        cptr->prev = ctail;
-        ctail->next = cptr;
-        ctail = cptr;
-        ctail->next = NULL;
+        cptr->prev = fs3_cur->ctail;
+        fs3_cur->ctail->next = cptr;
+        fs3_cur->ctail = cptr;
+        fs3_cur->ctail->next = NULL;
     }
 }
 
+void move_to_head(struct Cache *cptr) {
+    if (cptr != fs3_cur->chead) {
+        if (fs3_cur->ctail == cptr) {
+            fs3_cur->ctail = fs3_cur->ctail->prev;
+            fs3_cur->ctail->next = NULL;
+        } else {
+            cptr->prev->next = cptr->next;
+            cptr->next->prev = cptr->prev;
+        }
+        cptr->next = fs3_cur->chead;
+        fs3_cur->chead->prev = cptr;
+        fs3_cur->chead = cptr;
+        fs3_cur->chead->prev = NULL;
+    }
+}
+
+struct Cache * find_cache(int track, int sector) {
+    struct Cache *cptr = fs3_cur->croot;
+    while (cptr) {
+        if (less(cptr->track, cptr->sector, track, sector)) {
+            cptr = cptr->right;
+        } else if (less(track, sector, cptr->track, cptr->sector)) {
+            cptr = cptr->left;
+        } else {
+            break;
+        }
+    }
+    return cptr;
+}
+
+struct Cache * drop_cache(struct Cache *cptr, int track, int sector) {
+    if (cptr == NULL) {
+        return NULL;
+    } else if (less(cptr->track, cptr->sector, track, sector)) {
+        cptr->right = drop_cache(cptr->right, track, sector);
+    } else if (less(track, sector, cptr->track, cptr->sector)) {
+        cptr->left = drop_cache(cptr->left, track, sector);
+    } else {
+        return remove_cache(cptr);
+    }
+    return cptr;
+}
+
 struct Cache * insert_cache(struct Cache *cptr, int track, int sector, char *buf) {
     if (cptr == NULL) {
         return create_cache(track, sector, buf);
@@ -172,6 +352,7 @@ struct Cache * insert_cache(struct Cache *cptr, int track, int sector, char *buf
         cptr->left = insert_cache(cptr->left, track, sector, buf);
     } else {
         // update cache
+        cptr->epoch = fs3_cur->lease_epoch[track];
         memcpy(cptr->data, buf, FS3_SECTOR_SIZE);
         // move to tail (recent)
         move_to_tail(cptr);
@@ -189,14 +370,180 @@ struct Cache * insert_cache(struct Cache *cptr, int track, int sector, char *buf
 // Outputs      : 0 if inserted, -1 if not inserted
 
 int fs3_put_cache(FS3TrackIndex trk, FS3SectorIndex sct, void *buf) {
-    insert_count++;
-    croot = insert_cache(croot, trk, sct, buf);
-    if (cache_size > cache_capacity) {
-        croot = pop_lru(croot);
+    return put_cache(trk, sct, buf, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_fill_cache
+// Description  : Put an element just read from the disk after a miss.  The
+//                shared cache refuses it if another process wrote or dropped
+//                the sector since the miss, as the data read may be older.
+//
+// Inputs       : trk - the track number of the sector to put in cache
+//                sct - the sector number of the sector to put in cache
+//                buf - the data read
+//                cold - nonzero to put it at the least recently used end
+// Outputs      : 0 if inserted, -1 if not inserted
+
+int fs3_fill_cache(FS3TrackIndex trk, FS3SectorIndex sct, void *buf, int cold) {
+    return cold ? put_cache_cold(trk, sct, buf, 1) : put_cache(trk, sct, buf, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : put_cache
+// Description  : Put an element in the cache, as a write or as a fill
+//
+// Inputs       : trk - the track number of the sector to put in cache
+//                sct - the sector number of the sector to put in cache
+//                buf - the data
+//                fill - nonzero if it was read from the disk after a miss
+// Outputs      : 0 if inserted, -1 if not inserted
+
+int put_cache(FS3TrackIndex trk, FS3SectorIndex sct, void *buf, int fill) {
+    uint64_t start = fs3_metrics_now();
+    fs3_cur->insert_count++;
+    fs3_mrc_access(trk, sct, 0);
+    FS3_TRACE(FS3_TR_CACHE_PUT, FS3_TR_INSTANT, trk, sct, 0);
+    if (fs3_cur->observer) fs3_cur->observer(trk, sct, 0);
+    if (fs3_cur->shm) {
+        shm_cache_put(trk, sct, buf, 0, fill);
+    } else {
+        if (fs3_cur->zc_buckets) {
+            zcache_drop(trk, sct);
+        }
+        if (fs3_cur->l2) {
+            l2_cache_drop(trk, sct);
+        }
+        fs3_cur->croot = insert_cache(fs3_cur->croot, trk, sct, buf);
+        if (fs3_cur->cache_size > fs3_cur->cache_capacity) {
+            fs3_cur->croot = pop_lru(fs3_cur->croot);
+        }
+    }
+    if (fs3_cur->leases) {
+        // after the insert, so a write that raced the read drops it
+        fs3_lease_drain();
+    }
+    fs3_metrics_record(FS3_MET_CACHE_PUT, start);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_put_cache_cold
+// Description  : Put an element in the cache at the least recently used end,
+//                so it is the next line evicted unless it is used again
+//
+// Inputs       : trk - the track number of the sector to put in cache
+//                sct - the sector number of the sector to put in cache
+// Outputs      : 0 if inserted, -1 if not inserted
+
+int fs3_put_cache_cold(FS3TrackIndex trk, FS3SectorIndex sct, void *buf) {
+    return put_cache_cold(trk, sct, buf, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : put_cache_cold
+// Description  : Put an element at the least recently used end of the
+//                cache, as a write or as a fill
+//
+// Inputs       : trk - the track number of the sector to put in cache
+//                sct - the sector number of the sector to put in cache
+//                buf - the data
+//                fill - nonzero if it was read from the disk after a miss
+// Outputs      : 0 if inserted, -1 if not inserted
+
+int put_cache_cold(FS3TrackIndex trk, FS3SectorIndex sct, void *buf, int fill) {
+    uint64_t start = fs3_metrics_now();
+    struct Cache *cptr = fs3_cur->shm ? NULL : find_cache(trk, sct);
+    if (fs3_cur->cache_capacity == 0) return -1;
+    fs3_cur->insert_count++;
+    fs3_mrc_access(trk, sct, 0);
+    FS3_TRACE(FS3_TR_CACHE_PUT, FS3_TR_INSTANT, trk, sct, 0);
+    if (fs3_cur->observer) fs3_cur->observer(trk, sct, 0);
+    if (fs3_cur->zc_buckets) {
+        zcache_drop(trk, sct);
+    }
+    if (fs3_cur->l2) {
+        l2_cache_drop(trk, sct);
+    }
+    if (fs3_cur->shm) {
+        shm_cache_put(trk, sct, buf, 1, fill);
+    } else if (cptr) {
+        cptr->epoch = fs3_cur->lease_epoch[trk];
+        memcpy(cptr->data, buf, FS3_SECTOR_SIZE);
+    } else {
+        if (fs3_cur->cache_size >= fs3_cur->cache_capacity) {
+            fs3_cur->croot = pop_lru(fs3_cur->croot);
+        }
+        fs3_cur->croot = insert_cache(fs3_cur->croot, trk, sct, buf);
+        move_to_head(fs3_cur->ctail);
+    }
+    if (fs3_cur->leases) {
+        fs3_lease_drain();
+    }
+    fs3_metrics_record(FS3_MET_CACHE_PUT, start);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_drop_cache
+// Description  : Remove an element from the cache, if it is there
+//
+// Inputs       : trk - the track number of the sector to drop
+//                sct - the sector number of the sector to drop
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_drop_cache(FS3TrackIndex trk, FS3SectorIndex sct) {
+    if (fs3_cur->shm) return shm_cache_drop(trk, sct);
+    if (fs3_cur->zc_buckets) {
+        zcache_drop(trk, sct);
+    }
+    if (fs3_cur->l2) {
+        l2_cache_drop(trk, sct);
     }
+    fs3_cur->croot = drop_cache(fs3_cur->croot, trk, sct);
     return 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_in_cache
+// Description  : Check for an element without counting a get or changing
+//                its place in the LRU order
+//
+// Inputs       : trk - the track number of the sector to find
+//                sct - the sector number of the sector to find
+// Outputs      : 1 if cached, 0 if not
+
+int fs3_in_cache(FS3TrackIndex trk, FS3SectorIndex sct) {
+    if (fs3_cur->shm) return shm_cache_contains(trk, sct);
+    return find_cache(trk, sct) != NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : promote_cache
+// Description  : Bring a line found below the cache back into it as the most
+//                recently used
+//
+// Inputs       : trk - the track number of the sector
+//                sct - the sector number of the sector
+//                buf - the data
+// Outputs      : the line
+
+struct Cache * promote_cache(FS3TrackIndex trk, FS3SectorIndex sct, char *buf) {
+    // back into the cache, copied before the line it evicts is stored
+    fs3_cur->croot = insert_cache(fs3_cur->croot, trk, sct, buf);
+    if (fs3_cur->cache_size > fs3_cur->cache_capacity) {
+        fs3_cur->croot = pop_lru(fs3_cur->croot);
+    }
+    return fs3_cur->ctail;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Function     : fs3_get_cache
@@ -207,23 +554,65 @@ int fs3_put_cache(FS3TrackIndex trk, FS3SectorIndex sct, void *buf) {
 // Outputs      : returns NULL if not found or failed, pointer to buffer if found
 
 void * fs3_get_cache(FS3TrackIndex trk, FS3SectorIndex sct)  {
-    get_count++;
-    struct Cache *cptr = croot;
-    while (cptr) {
-        if (less(cptr->track, cptr->sector, trk, sct)) {
-            cptr = cptr->right;
-        } else if (less(trk, sct, cptr->track, cptr->sector)) {
-            cptr = cptr->left;
-        } else {
-            hit_count++;
+    uint64_t start = fs3_metrics_now();
+    fs3_cur->get_count++;
+    fs3_mrc_access(trk, sct, 1);
+    if (fs3_cur->observer) fs3_cur->observer(trk, sct, 1);
+    char *data = NULL, *stored, unpacked[FS3_SECTOR_SIZE];
+    uint32_t epoch;
+    if (fs3_cur->leases) {
+        fs3_lease_drain();
+    }
+    if (fs3_cur->shm) {
+        data = shm_cache_get(trk, sct);
+    } else {
+        struct Cache *cptr = find_cache(trk, sct);
+        if (cptr && fs3_cur->leases && !fs3_lease_valid(trk, cptr->epoch)) {
+            // the lease ran out, another client may have written it
+            fs3_cur->croot = drop_cache(fs3_cur->croot, trk, sct);
+            cptr = NULL;
+        }
+        if (!cptr && fs3_cur->zc_buckets && zcache_get(trk, sct, unpacked, &epoch) &&
+            (!fs3_cur->leases || fs3_lease_valid(trk, epoch))) {
+            cptr = promote_cache(trk, sct, unpacked);
+            fs3_cur->zc_hits++;
+        }
+        if (!cptr && fs3_cur->l2 && fs3_cur->cache_capacity && (stored = l2_cache_get(trk, sct, &epoch)) &&
+            (!fs3_cur->leases || fs3_lease_valid(trk, epoch))) {
+            cptr = promote_cache(trk, sct, stored);
+            fs3_cur->l2_hits++;
+        }
+        if (cptr) {
             move_to_tail(cptr);
-            return cptr->data;
+            data = cptr->data;
         }
     }
-    miss_count++;
+    if (data) {
+        fs3_cur->hit_count++;
+        FS3_TRACE(FS3_TR_CACHE_HIT, FS3_TR_INSTANT, trk, sct, 0);
+        fs3_metrics_record(FS3_MET_CACHE_GET, start);
+        return data;
+    }
+    fs3_cur->miss_count++;
+    FS3_TRACE(FS3_TR_CACHE_MISS, FS3_TR_INSTANT, trk, sct, 0);
+    fs3_metrics_record(FS3_MET_CACHE_GET, start);
     return NULL;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_observe_cache
+// Description  : Have a function called on every cache get and put, so the
+//                reference stream can be analyzed offline
+//
+// Inputs       : fn - the observer, NULL to stop observing
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_observe_cache(FS3CacheObserver fn) {
+    fs3_cur->observer = fn;
+    return 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Function     : fs3_log_cache_metrics
@@ -233,13 +622,35 @@ void * fs3_get_cache(FS3TrackIndex trk, FS3SectorIndex sct)  {
 // Outputs      : 0 if successful, -1 if failure
 
 int fs3_log_cache_metrics(void) {
+    uint32_t lines;
     logMessage(LOG_OUTPUT_LEVEL, "** FS3 cache Metrics **");
-    logMessage(LOG_OUTPUT_LEVEL, "Cache inserts    [%9d]", insert_count);
-    logMessage(LOG_OUTPUT_LEVEL, "Cache gets       [%9d]", get_count);
-    logMessage(LOG_OUTPUT_LEVEL, "Cache hits       [%9d]", hit_count);
-    logMessage(LOG_OUTPUT_LEVEL, "Cache misses     [%9d]", miss_count);
+    logMessage(LOG_OUTPUT_LEVEL, "Cache inserts    [%9d]", fs3_cur->insert_count);
+    logMessage(LOG_OUTPUT_LEVEL, "Cache gets       [%9d]", fs3_cur->get_count);
+    logMessage(LOG_OUTPUT_LEVEL, "Cache hits       [%9d]", fs3_cur->hit_count);
+    logMessage(LOG_OUTPUT_LEVEL, "Cache misses     [%9d]", fs3_cur->miss_count);
     logMessage(LOG_OUTPUT_LEVEL, "Cache hit ratio  [%%%5.2f]", 
-               100.0 * hit_count / get_count);
+               100.0 * fs3_cur->hit_count / fs3_cur->get_count);
+    if (fs3_cur->shm) {
+        shm_cache_log();
+    }
+    if (fs3_cur->zc_buckets) {
+        zcache_log();
+    }
+    if (fs3_cur->l2) {
+        l2_cache_log();
+    }
+
+    // Predicted miss-ratio curve, doubling from 128 lines to the whole disk
+    if (fs3_mrc_samples() == 0) return(0);
+    logMessage(LOG_OUTPUT_LEVEL, "Predicted hit ratio by cache size (%lu sampled gets)", fs3_mrc_samples());
+    for (lines = 128; lines <= FS3_MRC_KEYS; lines *= 2) {
+        logMessage(LOG_OUTPUT_LEVEL, "  %6u lines    [%%%5.2f]%s", lines, 100.0 * fs3_mrc_hit_ratio(lines),
+                   (lines == fs3_cur->cache_capacity) ? " <- current" : "");
+    }
+    if ((fs3_cur->cache_capacity & (fs3_cur->cache_capacity - 1)) || (fs3_cur->cache_capacity < 128)) {
+        logMessage(LOG_OUTPUT_LEVEL, "  %6u lines    [%%%5.2f] <- current", fs3_cur->cache_capacity,
+                   100.0 * fs3_mrc_hit_ratio(fs3_cur->cache_capacity));
+    }
     return(0);
 }
 
@@ -15,7 +15,10 @@
 #include <fs3_controller.h>
 
 // Defines
-#define FS3_DEFAULT_CACHE_SIZE 2048; // 256 cache entries, by default
+#define FS3_DEFAULT_CACHE_SIZE 2048 // 256 cache entries, by default
+
+// This is called on each get (is_get 1) and put (is_get 0)
+typedef void (*FS3CacheObserver)(FS3TrackIndex trk, FS3SectorIndex sct, int is_get);
 
 //
 // Cache Functions
@@ -23,15 +26,42 @@
 int fs3_init_cache(uint16_t cachelines);
     // Initialize the cache with a fixed number of cache lines
 
+int fs3_share_cache(const char *name);
+    // Keep the cache in a named shared-memory segment from the next init (NULL for private)
+
+int fs3_cache_l2(const char *path, uint32_t cachelines);
+    // Keep evicted lines in a victim file from the next init, warm across runs on a logged disk
+
+int fs3_compress_cache(uint8_t percent);
+    // Keep percent of the cache's memory as compressed lines from the next init (0 for none)
+
 int fs3_close_cache(void);
     // Close the cache, freeing any buffers held in it
 
+int fs3_resize_cache(uint16_t cachelines);
+    // Change the number of cache lines, keeping the most recently used
+
 int fs3_put_cache(FS3TrackIndex trk, FS3SectorIndex sct, void *buf);
     // Put an element in the cache
 
+int fs3_put_cache_cold(FS3TrackIndex trk, FS3SectorIndex sct, void *buf);
+    // Put an element in the cache as the next to be evicted
+
+int fs3_fill_cache(FS3TrackIndex trk, FS3SectorIndex sct, void *buf, int cold);
+    // Put an element read from the disk after a miss (cold as fs3_put_cache_cold)
+
+int fs3_drop_cache(FS3TrackIndex trk, FS3SectorIndex sct);
+    // Remove an element from the cache
+
+int fs3_in_cache(FS3TrackIndex trk, FS3SectorIndex sct);
+    // Check for an element without counting a get or touching the LRU order
+
 void * fs3_get_cache(FS3TrackIndex trk, FS3SectorIndex sct);
     // Get an element from the cache (returns NULL if not found)
 
+int fs3_observe_cache(FS3CacheObserver fn);
+    // Call fn on every get and put (NULL to stop)
+
 int fs3_log_cache_metrics(void);
     // Log the metrics for the cache 
 
@@ -3,17 +3,108 @@
 #ifndef FS3_CACHE_PI_INCLUDED
 #define FS3_CACHE_PI_INCLUDED
 
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
 #include "fs3_cache.h"
 
+#define FS3_SHM_MAGIC 0x4d485333            // "3SHM"
+#define FS3_SHM_STRIPES 64                  // Locks over the hash buckets
+#define FS3_SHM_FREE 0                      // Slot key of an empty slot
+#define FS3_SHM_RESERVED UINT32_MAX         // Slot key of a slot being filled
+#define FS3_SHM_KEYS (FS3_MAX_TRACKS * FS3_TRACK_SIZE)  // Sectors with a generation
+#define FS3_L2_MAGIC 0x43324c33             // "3L2C"
+#define FS3_L2_WAYS 8                       // Lines per set of the victim file
+#define FS3_ZC_PAGE 16384                   // Slab page of the compressed lines
+#define FS3_ZC_CLASS 64                     // Chunk sizes are multiples of this
+#define FS3_ZC_CLASSES (FS3_SECTOR_SIZE / FS3_ZC_CLASS)
+#define FS3_ZC_BUCKETS 4096                 // Hash buckets of the compressed lines
+#define FS3_ZC_MAX_PERCENT 90               // Most of the cache that may be compressed
+#define FS3_ZC_TRAIN 64                     // Lines the byte code is built from
+#define FS3_ZC_MAX_BITS 15                  // Longest byte code
+#define FS3_ZC_LZ 0x1                       // Line was compressed by matches
+#define FS3_ZC_CODED 0x2                    // and then by the byte code
+
 struct Cache {
     int track;
     int sector;
+    uint32_t epoch;     // lease epoch of the track when it was put
     char data[FS3_SECTOR_SIZE];
     struct Cache *left;
     struct Cache *right;
     struct Cache *prev;
     struct Cache *next;
-} *croot, *chead, *ctail;
+};
+
+// Shared cache, a segment is a ShmCache, the bucket heads and the slots
+struct ShmSlot {
+    uint32_t key;       // track * FS3_TRACK_SIZE + sector + 1, or FREE/RESERVED
+    uint32_t next;      // next slot in the bucket + 1, 0 at the end
+    pid_t owner;        // process filling a RESERVED slot
+    uint8_t ref;        // used since the clock hand last passed
+    uint64_t stored;    // fs3_metrics_now() when the data was stored
+    char data[FS3_SECTOR_SIZE];
+};
+
+struct ShmCache {
+    uint32_t magic;     // set last by the creator
+    uint32_t capacity;
+    uint32_t nbuckets;
+    uint32_t users;     // attached processes, under clock_lock
+    uint32_t hand;      // clock hand, under clock_lock
+    pthread_mutex_t clock_lock;
+    pthread_mutex_t stripes[FS3_SHM_STRIPES];   // bucket b is under stripes[b % FS3_SHM_STRIPES]
+    uint64_t hits, misses, inserts, evictions, recoveries, stale_fills;
+    uint32_t gens[FS3_SHM_KEYS];    // per sector, bumped by each write or drop under its stripe
+};
+
+// Victim file, an L2Cache, the entries and (page aligned) the sectors
+struct L2Entry {
+    uint32_t key;       // track * FS3_TRACK_SIZE + sector + 1, 0 if empty
+    uint32_t epoch;     // lease epoch of the track when it was stored
+    uint64_t used;      // clock value of the last store or hit
+};
+
+struct L2Cache {
+    uint32_t magic;
+    uint32_t lines;
+    uint32_t clean;     // closed properly, the lines match the disk
+    uint32_t pad;
+    uint64_t stamp;     // fs3_wal_stamp() of the mount it was closed in
+    uint64_t clock;
+};
+
+// Compressed lines, kept in chunks of slab pages of one size class each
+struct ZPage {
+    struct ZPage *prev, *next;  // pages of the class with a free chunk, or free pages
+    int cls;                    // size class, -1 if free
+    uint32_t used;              // chunks in use
+    uint64_t map[FS3_ZC_PAGE / FS3_ZC_CLASS / 64];
+    char data[FS3_ZC_PAGE];
+};
+
+// Canonical byte code built from the first lines compressed, fixed after
+struct ZModel {
+    uint32_t freq[256];         // byte counts of the lines seen so far
+    uint32_t lines;             // lines seen, the code is built at FS3_ZC_TRAIN
+    uint8_t bits[256];          // code length of each byte, all 0 until built
+    uint16_t code[256];
+    uint16_t first[FS3_ZC_MAX_BITS + 1];   // first code of each length
+    uint16_t count[FS3_ZC_MAX_BITS + 1];   // codes of each length
+    uint16_t offset[FS3_ZC_MAX_BITS + 1];  // index in sorted of the first
+    uint8_t sorted[256];        // bytes by code
+};
+
+struct ZEntry {
+    uint32_t key;               // track * FS3_TRACK_SIZE + sector
+    uint32_t epoch;             // lease epoch of the track when it was cached
+    uint16_t len;               // compressed length, FS3_SECTOR_SIZE if stored raw
+    uint16_t chunk;
+    uint8_t codec;              // FS3_ZC_LZ and FS3_ZC_CODED passes applied, 0 raw
+    struct ZPage *page;
+    struct ZEntry *hnext;       // next in the hash bucket
+    struct ZEntry *prev, *next; // LRU order, head is least recent
+};
 
 int sector_less(int track0, int sector0, int track1, int sector1);
 
@@ -27,6 +118,60 @@ struct Cache * pop_lru(struct Cache *cptr);
 
 struct Cache * insert_cache(struct Cache *cptr, int track, int sector, char *buf);
 
+struct Cache * promote_cache(FS3TrackIndex trk, FS3SectorIndex sct, char *buf);
+
+int put_cache(FS3TrackIndex trk, FS3SectorIndex sct, void *buf, int fill);
+
+int put_cache_cold(FS3TrackIndex trk, FS3SectorIndex sct, void *buf, int fill);
+
+uint32_t split_cache(uint16_t cachelines);
+
 void move_to_tail(struct Cache *cptr);
 
+void move_to_head(struct Cache *cptr);
+
+struct Cache * find_cache(int track, int sector);
+
+struct Cache * drop_cache(struct Cache *cptr, int track, int sector);
+
+int shm_cache_attach(const char *name, uint16_t cachelines);
+
+int shm_cache_detach(void);
+
+char * shm_cache_get(int track, int sector);
+
+int shm_cache_contains(int track, int sector);
+
+int shm_cache_put(int track, int sector, char *buf, int cold, int fill);
+
+int shm_cache_drop(int track, int sector);
+
+void shm_cache_log(void);
+
+int l2_cache_attach(void);
+
+int l2_cache_detach(void);
+
+char * l2_cache_get(int track, int sector, uint32_t *epoch);
+
+void l2_cache_put(int track, int sector, char *buf, uint32_t epoch);
+
+void l2_cache_drop(int track, int sector);
+
+void l2_cache_log(void);
+
+int zcache_init(uint32_t pages);
+
+void zcache_close(void);
+
+int zcache_get(int track, int sector, char *buf, uint32_t *epoch);
+
+void zcache_put(int track, int sector, char *buf, uint32_t epoch);
+
+void zcache_drop(int track, int sector);
+
+void zcache_shrink(uint32_t pages);
+
+void zcache_log(void);
+
 #endif
\ No newline at end of file
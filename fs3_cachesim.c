@@ -0,0 +1,827 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_cachesim.c
+//  Description    : This is the offline cache analyzer for the FS3
+//                   filesystem.  It replays a workload through the driver
+//                   against an in-memory disk (no server needed), or reads a
+//                   trace written by fs3_client -T, and records every
+//                   sector the cache is asked for or given.  From that
+//                   reference string it reports the reuse-distance
+//                   histogram, the working set over time and the hit ratios
+//                   of LRU, ARC and Belady's OPT at a range of cache sizes.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Project Includes
+#include <fs3_driver.h>
+#include <fs3_cache.h>
+#include <fs3_network.h>
+#include <fs3_workload.h>
+#include <fs3_trace.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define FS3_CACHESIM_KEYS (FS3_MAX_TRACKS * FS3_TRACK_SIZE)   // One key per disk sector
+#define FS3_CACHESIM_GET 0x80000000                            // Reference flag, a get (else a put)
+#define FS3_CACHESIM_NEVER UINT32_MAX                          // Next use of a sector never used again
+#define FS3_CACHESIM_MAX_SIZES 32
+#define FS3_CACHESIM_WINDOW 10000
+#define USAGE \
+	"USAGE: fs3_cachesim [-h] [-s <sizes>] [-W <refs>] <workload-file|trace-file>\n" \
+	"\n" \
+	"where:\n" \
+	"    -h - help mode (display this message)\n" \
+	"    -s - comma separated cache sizes in lines (default 128,256,...,16384)\n" \
+	"    -W - working set window in references (default 10000)\n" \
+	"\n" \
+	"    <workload-file> - text or compiled workload, replayed without a server\n" \
+	"    <trace-file>    - binary trace written by fs3_client -T\n" \
+	"\n" \
+
+// These are the lists of the ARC simulation
+typedef enum {
+
+	ARC_NONE = 0,   // Not tracked
+	ARC_T1   = 1,   // Cached, seen once recently
+	ARC_T2   = 2,   // Cached, seen at least twice recently
+	ARC_B1   = 3,   // Ghost, evicted from T1
+	ARC_B2   = 4,   // Ghost, evicted from T2
+	ARC_MAXVAL = 5
+
+} ArcLists;
+
+//
+// Global Data
+uint32_t *refs = NULL;                     // Reference string, key | FS3_CACHESIM_GET
+uint64_t nrefs = 0, ref_capacity = 0;
+uint64_t ngets = 0, nputs = 0;
+int sim_recording = 0;                     // Observer records while set
+char *sim_disk = NULL;                     // The in-memory disk
+int sim_track = 0;                         // Track selected by the last TSEEK
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : network_fs3_syscall
+// Description  : Stand in for the controller with an in-memory disk, so the
+//                driver's sector mapping runs without a server
+//
+// Inputs       : cmd - the command block
+//                ret - the reply block
+//                buf - the sector buffer
+// Outputs      : 0 if successful, -1 if failure
+
+int network_fs3_syscall(FS3CmdBlk cmd, FS3CmdBlk *ret, void *buf) {
+	int opcode, sector, track;
+	char *sptr;
+
+	deconstruct_cmdBlock(cmd, &opcode, &sector, &track, NULL);
+	switch (opcode) {
+	case FS3_OP_MOUNT:
+		if ((sim_disk == NULL) &&
+			((sim_disk = calloc(FS3_CACHESIM_KEYS, FS3_SECTOR_SIZE)) == NULL)) {
+			return -1;
+		}
+		break;
+
+	case FS3_OP_TSEEK:
+		if (track >= FS3_MAX_TRACKS) return -1;
+		sim_track = track;
+		break;
+
+	case FS3_OP_RDSECT:
+	case FS3_OP_WRSECT:
+		if ((sim_disk == NULL) || (sector >= FS3_TRACK_SIZE)) return -1;
+		sptr = sim_disk + ((size_t) sim_track * FS3_TRACK_SIZE + sector) * FS3_SECTOR_SIZE;
+		if (opcode == FS3_OP_RDSECT) {
+			memcpy(buf, sptr, FS3_SECTOR_SIZE);
+		} else {
+			memcpy(sptr, buf, FS3_SECTOR_SIZE);
+		}
+		break;
+
+	case FS3_OP_UMOUNT:
+		break;
+
+	default:
+		return -1;
+	}
+	*ret = construct_cmdBlock(opcode, sector, track, 0);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : add_ref
+// Description  : Append a reference to the reference string.  A put right
+//                after a missed get of the same sector is the driver filling
+//                the cache from disk, which the get already accounts for.
+//
+// Inputs       : key - the sector (track * FS3_TRACK_SIZE + sector)
+//                is_get - nonzero for a get
+// Outputs      : none
+
+void add_ref(uint32_t key, int is_get) {
+	if (!is_get && nrefs && (refs[nrefs - 1] == (key | FS3_CACHESIM_GET))) return;
+
+	if (nrefs == ref_capacity) {
+		ref_capacity = ref_capacity ? ref_capacity * 2 : 1024 * 1024;
+		refs = realloc(refs, sizeof(uint32_t) * ref_capacity);
+		CMPSC311_ASSERT0(refs != NULL, "fs3_cachesim out of memory for references");
+	}
+	refs[nrefs++] = key | (is_get ? FS3_CACHESIM_GET : 0);
+	if (is_get) {
+		ngets++;
+	} else {
+		nputs++;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : observe_ref
+// Description  : The cache observer, records each get and put of the replay
+//
+// Inputs       : trk - the track
+//                sct - the sector
+//                is_get - nonzero for a get
+// Outputs      : none
+
+void observe_ref(FS3TrackIndex trk, FS3SectorIndex sct, int is_get) {
+	if (sim_recording) {
+		add_ref((uint32_t) trk * FS3_TRACK_SIZE + sct, is_get);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : load_compiled
+// Description  : Replay a compiled workload and record its references
+//
+// Inputs       : path - the workload file
+//                base - the mapped workload
+//                size - length of the mapping
+// Outputs      : 0 if successful, -1 if failure
+
+int load_compiled(char *path, char *base, size_t size) {
+	FS3WorkloadHeader *hdr = (FS3WorkloadHeader *) base;
+	FS3WorkloadName *names;
+	FS3WorkloadOp *op, *end;
+	char *payload, *rbuf;
+	int16_t *fds;
+	int ret = 0;
+
+	if (fs3_workload_check(base, size) == -1) {
+		logMessage(LOG_ERROR_LEVEL, "Compiled workload [%s] is corrupt or the wrong version.", path);
+		return -1;
+	}
+	names = (FS3WorkloadName *) (base + hdr->names);
+	payload = base + hdr->payload;
+	fds = malloc(sizeof(int16_t) * (hdr->nfiles ? hdr->nfiles : 1));
+	rbuf = malloc(hdr->maxread ? hdr->maxread : 1);
+	if ((fds == NULL) || (rbuf == NULL)) {
+		logMessage(LOG_ERROR_LEVEL, "fs3_cachesim failed replay allocation.");
+		free(fds);
+		free(rbuf);
+		return -1;
+	}
+	memset(fds, 0xff, sizeof(int16_t) * hdr->nfiles);
+
+	for (op = (FS3WorkloadOp *) (base + hdr->ops), end = op + hdr->nops; (op < end) && !ret; op++) {
+		ret = fs3_workload_op(&fds[op->file], names[op->file], op, payload, rbuf);
+	}
+	free(rbuf);
+	free(fds);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : load_text
+// Description  : Replay a text workload and record its references
+//
+// Inputs       : path - the workload file
+// Outputs      : 0 if successful, -1 if failure
+
+int load_text(char *path) {
+	char line[1024], fname[128], command[128], *sep, *rbuf = NULL;
+	char **fnames = NULL;
+	int16_t *fds = NULL;
+	uint32_t file, nfiles = 0, rsize = 0;
+	int32_t len, off, i, linecount = 0;
+	FS3WorkloadOp op;
+	int ret = 0;
+	FILE *in;
+
+	if ((in = fopen(path, "r")) == NULL) {
+		logMessage(LOG_ERROR_LEVEL, "Failure opening the workload file [%s], error: %s.",
+			path, strerror(errno));
+		return -1;
+	}
+	while (!ret && (fgets(line, 1024, in) != NULL)) {
+		linecount++;
+		sep = strchr(line, ':');
+		if ((sscanf(line, "%s %s %d %d", fname, command, &len, &off) != 4) || (sep == NULL) || (len < 0)) {
+			logMessage(LOG_ERROR_LEVEL, "FS3 un-parsable workload string, aborting [%s], line %d",
+				line, linecount);
+			ret = -1;
+			break;
+		}
+		if (strncmp(command, "WRITEAT", 7) == 0) {
+			op.opcode = FS3_WL_WRITEAT;
+		} else if (strncmp(command, "WRITE", 5) == 0) {
+			op.opcode = FS3_WL_WRITE;
+		} else if (strncmp(command, "SEEK", 4) == 0) {
+			op.opcode = FS3_WL_SEEK;
+		} else if (strncmp(command, "READ", 4) == 0) {
+			op.opcode = FS3_WL_READ;
+		} else {
+			logMessage(LOG_ERROR_LEVEL, "FS3 unknown workload command [%s], line %d", command, linecount);
+			ret = -1;
+			break;
+		}
+
+		// Workloads use a handful of files, so a linear lookup will do
+		for (file = 0; (file < nfiles) && strcmp(fnames[file], fname); file++);
+		if (file == nfiles) {
+			fnames = realloc(fnames, sizeof(char *) * (nfiles + 1));
+			fds = realloc(fds, sizeof(int16_t) * (nfiles + 1));
+			fnames[nfiles] = strdup(fname);
+			fds[nfiles++] = -1;
+		}
+
+		// Writes carry their data after the ':' with '^' for newlines
+		if ((op.opcode == FS3_WL_WRITE) || (op.opcode == FS3_WL_WRITEAT)) {
+			CMPSC311_ASSERT2((strlen(sep+1)>=len), "Workload str [%d<%d]", strlen(sep+1), len);
+			for (i = 0, sep++; i < len; i++) {
+				sep[i] = (sep[i] == '^') ? '\n' : sep[i];
+			}
+		}
+		if (len > rsize) {
+			rsize = len;
+			rbuf = realloc(rbuf, rsize);
+		}
+		op.file = file;
+		op.len = len;
+		op.off = off;
+		op.data = 0;
+		ret = fs3_workload_op(&fds[file], fnames[file], &op, sep, rbuf);
+	}
+	fclose(in);
+	for (file = 0; file < nfiles; file++) {
+		free(fnames[file]);
+	}
+	free(fnames);
+	free(fds);
+	free(rbuf);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : compare_events
+// Description  : Order trace events by timestamp
+//
+// Inputs       : a, b - the events
+// Outputs      : <0, 0, >0 as a is before, with or after b
+
+int compare_events(const void *a, const void *b) {
+	const FS3TraceEvent *ea = a, *eb = b;
+	return (ea->ts < eb->ts) ? -1 : (ea->ts > eb->ts);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : load_trace
+// Description  : Record the cache references of a trace, merging the
+//                thread rings by timestamp
+//
+// Inputs       : path - the trace file
+//                base - the mapped trace
+//                size - length of the mapping
+// Outputs      : 0 if successful, -1 if failure
+
+int load_trace(char *path, char *base, size_t size) {
+	FS3TraceHeader *hdr = (FS3TraceHeader *) base;
+	FS3TraceRingHeader *rhdr;
+	FS3TraceEvent *evs = NULL, *ev;
+	uint64_t nevs = 0, dropped = 0, i;
+	size_t pos;
+	uint32_t r;
+
+	if ((size < sizeof(FS3TraceHeader)) || (hdr->version < 1) || (hdr->version > FS3_TRACE_VERSION)) {
+		logMessage(LOG_ERROR_LEVEL, "Trace [%s] is corrupt or the wrong version.", path);
+		return -1;
+	}
+
+	// Keep only the cache gets and puts of every ring
+	for (r = 0, pos = sizeof(FS3TraceHeader); r < hdr->nrings; r++) {
+		rhdr = (FS3TraceRingHeader *) (base + pos);
+		pos += sizeof(FS3TraceRingHeader);
+		if ((pos > size) || (rhdr->count > (size - pos) / sizeof(FS3TraceEvent))) {
+			logMessage(LOG_ERROR_LEVEL, "Trace [%s] is truncated.", path);
+			free(evs);
+			return -1;
+		}
+		evs = realloc(evs, sizeof(FS3TraceEvent) * (nevs + rhdr->count));
+		for (i = 0, ev = (FS3TraceEvent *) (base + pos); i < rhdr->count; i++, ev++) {
+			if ((ev->type == FS3_TR_CACHE_HIT) || (ev->type == FS3_TR_CACHE_MISS) ||
+				(ev->type == FS3_TR_CACHE_PUT)) {
+				evs[nevs++] = *ev;
+			}
+		}
+		pos += sizeof(FS3TraceEvent) * rhdr->count;
+		dropped += rhdr->dropped;
+	}
+	if (dropped) {
+		fprintf(stderr, "warning: %lu trace events were overwritten, the start of the run is missing\n", dropped);
+	}
+	if (hdr->version < 2) {
+		fprintf(stderr, "warning: version %u trace has no cache puts, writes are not modeled\n", hdr->version);
+	}
+
+	qsort(evs, nevs, sizeof(FS3TraceEvent), compare_events);
+	for (i = 0; i < nevs; i++) {
+		if ((evs[i].arg0 < FS3_MAX_TRACKS) && (evs[i].arg1 < FS3_TRACK_SIZE)) {
+			add_ref(evs[i].arg0 * FS3_TRACK_SIZE + evs[i].arg1, evs[i].type != FS3_TR_CACHE_PUT);
+		}
+	}
+	free(evs);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : load_refs
+// Description  : Build the reference string from a workload or trace file
+//
+// Inputs       : path - the input file
+// Outputs      : 0 if successful, -1 if failure
+
+int load_refs(char *path) {
+	struct stat stats;
+	char *base = MAP_FAILED;
+	int fd, ret;
+
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		logMessage(LOG_ERROR_LEVEL, "Failure opening [%s], error: %s.", path, strerror(errno));
+		return -1;
+	}
+	if ((fstat(fd, &stats) == 0) && (stats.st_size >= 4)) {
+		base = mmap(NULL, stats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+
+	// A trace is read as is, a workload is replayed through the driver
+	if ((base != MAP_FAILED) && !memcmp(base, FS3_TRACE_MAGIC, 4)) {
+		ret = load_trace(path, base, stats.st_size);
+		munmap(base, stats.st_size);
+		return ret;
+	}
+	if ((fs3_mount_disk() == -1) || (fs3_init_cache(0) == -1)) {
+		logMessage(LOG_ERROR_LEVEL, "fs3_cachesim failed to mount the in-memory disk.");
+		if (base != MAP_FAILED) munmap(base, stats.st_size);
+		return -1;
+	}
+	fs3_observe_cache(observe_ref);
+	sim_recording = 1;
+	if ((base != MAP_FAILED) && !memcmp(base, FS3_WORKLOAD_MAGIC, 4)) {
+		ret = load_compiled(path, base, stats.st_size);
+	} else {
+		ret = load_text(path);
+	}
+
+	// Unmount writes back what is still dirty, which is part of the run
+	if (fs3_unmount_disk() == -1) ret = -1;
+	sim_recording = 0;
+	fs3_observe_cache(NULL);
+	fs3_close_cache();
+	if (base != MAP_FAILED) munmap(base, stats.st_size);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : reuse_distances
+// Description  : Compute the exact LRU stack distance of every get (the
+//                number of distinct sectors referenced since the last use
+//                of the sector) with a Fenwick tree over reference times
+//
+// Inputs       : hist - gets by distance, FS3_CACHESIM_KEYS entries
+//                cold - set to the number of first-time gets
+// Outputs      : 0 if successful, -1 if failure
+
+int reuse_distances(uint64_t *hist, uint64_t *cold) {
+	uint32_t *last, *tree, key, t, j;
+	uint64_t i, before, since;
+
+	last = calloc(FS3_CACHESIM_KEYS, sizeof(uint32_t));
+	tree = calloc(nrefs + 1, sizeof(uint32_t));
+	if ((last == NULL) || (tree == NULL)) {
+		free(last);
+		free(tree);
+		return -1;
+	}
+
+	// A time is marked while it is the last use of its sector, so the marks
+	// after the last use of a sector count the distinct sectors used since
+	*cold = 0;
+	for (i = 0; i < nrefs; i++) {
+		key = refs[i] & ~FS3_CACHESIM_GET;
+		t = i + 1;
+		if (last[key]) {
+			for (since = 0, j = t - 1; j > 0; j -= j & -j) since += tree[j];
+			for (before = 0, j = last[key]; j > 0; j -= j & -j) before += tree[j];
+			if (refs[i] & FS3_CACHESIM_GET) hist[since - before]++;
+			for (j = last[key]; j <= nrefs; j += j & -j) tree[j]--;
+		} else if (refs[i] & FS3_CACHESIM_GET) {
+			(*cold)++;
+		}
+		for (j = t; j <= nrefs; j += j & -j) tree[j]++;
+		last[key] = t;
+	}
+	free(last);
+	free(tree);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : arc_remove / arc_push
+// Description  : Unlink a sector from its ARC list / link it at the MRU end
+//                of a list
+//
+// Inputs       : key - the sector
+//                list - the list (arc_push)
+// Outputs      : none
+
+uint32_t *arc_prev, *arc_next;
+uint8_t *arc_where;
+uint32_t arc_head[ARC_MAXVAL], arc_tail[ARC_MAXVAL], arc_len[ARC_MAXVAL];
+
+void arc_remove(uint32_t key) {
+	int l = arc_where[key];
+
+	if (arc_prev[key] != FS3_CACHESIM_NEVER) arc_next[arc_prev[key]] = arc_next[key];
+	else arc_head[l] = arc_next[key];
+	if (arc_next[key] != FS3_CACHESIM_NEVER) arc_prev[arc_next[key]] = arc_prev[key];
+	else arc_tail[l] = arc_prev[key];
+	arc_len[l]--;
+	arc_where[key] = ARC_NONE;
+}
+
+void arc_push(uint32_t key, int list) {
+	arc_prev[key] = arc_tail[list];
+	arc_next[key] = FS3_CACHESIM_NEVER;
+	if (arc_tail[list] != FS3_CACHESIM_NEVER) arc_next[arc_tail[list]] = key;
+	else arc_head[list] = key;
+	arc_tail[list] = key;
+	arc_len[list]++;
+	arc_where[key] = list;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : arc_replace
+// Description  : Move the LRU sector of T1 or T2 to its ghost list, as the
+//                REPLACE step of ARC (Megiddo and Modha)
+//
+// Inputs       : in_b2 - the sector being brought in was found in B2
+//                p - the target size of T1
+// Outputs      : none
+
+void arc_replace(int in_b2, uint32_t p) {
+	uint32_t key;
+
+	if (arc_len[ARC_T1] && ((in_b2 && (arc_len[ARC_T1] == p)) || (arc_len[ARC_T1] > p))) {
+		key = arc_head[ARC_T1];
+		arc_remove(key);
+		arc_push(key, ARC_B1);
+	} else if (arc_len[ARC_T2]) {
+		key = arc_head[ARC_T2];
+		arc_remove(key);
+		arc_push(key, ARC_B2);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulate_arc
+// Description  : Count the gets an ARC cache of a given size would hit
+//
+// Inputs       : c - the cache size in lines
+// Outputs      : the number of hits
+
+uint64_t simulate_arc(uint32_t c) {
+	uint32_t key, p = 0, delta;
+	uint64_t i, hits = 0;
+	int l;
+
+	memset(arc_where, 0x0, FS3_CACHESIM_KEYS);
+	for (l = 0; l < ARC_MAXVAL; l++) {
+		arc_head[l] = arc_tail[l] = FS3_CACHESIM_NEVER;
+		arc_len[l] = 0;
+	}
+
+	for (i = 0; i < nrefs; i++) {
+		key = refs[i] & ~FS3_CACHESIM_GET;
+		switch (arc_where[key]) {
+		case ARC_T1:
+		case ARC_T2:
+			if (refs[i] & FS3_CACHESIM_GET) hits++;
+			arc_remove(key);
+			arc_push(key, ARC_T2);
+			break;
+
+		case ARC_B1:
+			delta = (arc_len[ARC_B2] > arc_len[ARC_B1]) ? arc_len[ARC_B2] / arc_len[ARC_B1] : 1;
+			p = (p + delta > c) ? c : p + delta;
+			arc_replace(0, p);
+			arc_remove(key);
+			arc_push(key, ARC_T2);
+			break;
+
+		case ARC_B2:
+			delta = (arc_len[ARC_B1] > arc_len[ARC_B2]) ? arc_len[ARC_B1] / arc_len[ARC_B2] : 1;
+			p = (p > delta) ? p - delta : 0;
+			arc_replace(1, p);
+			arc_remove(key);
+			arc_push(key, ARC_T2);
+			break;
+
+		default:
+			if (arc_len[ARC_T1] + arc_len[ARC_B1] == c) {
+				if (arc_len[ARC_T1] < c) {
+					arc_remove(arc_head[ARC_B1]);
+					arc_replace(0, p);
+				} else {
+					arc_remove(arc_head[ARC_T1]);
+				}
+			} else if (arc_len[ARC_T1] + arc_len[ARC_T2] + arc_len[ARC_B1] + arc_len[ARC_B2] >= c) {
+				if (arc_len[ARC_T1] + arc_len[ARC_T2] + arc_len[ARC_B1] + arc_len[ARC_B2] == 2 * c) {
+					arc_remove(arc_head[ARC_B2]);
+				}
+				arc_replace(0, p);
+			}
+			arc_push(key, ARC_T1);
+			break;
+		}
+	}
+	return hits;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : simulate_opt
+// Description  : Count the gets Belady's OPT would hit at a given size: on
+//                a miss with the cache full, evict the sector used furthest
+//                in the future, or skip caching the new sector if it is
+//                the one used furthest.  The heap of (next use, sector)
+//                pairs is pruned lazily; stale pairs are skipped when popped.
+//
+// Inputs       : c - the cache size in lines
+//                next_use - the time of the next reference after each one
+//                cur_next - scratch, FS3_CACHESIM_KEYS entries
+//                heap - scratch, nrefs pairs
+// Outputs      : the number of hits
+
+uint64_t simulate_opt(uint32_t c, uint32_t *next_use, uint32_t *cur_next, uint64_t *heap) {
+	uint64_t i, hits = 0, n = 0, top, tmp;
+	uint32_t key, size = 0, nu;
+	uint64_t pos, child;
+
+	// cur_next holds the next use of each cached sector, 0 if not cached
+	memset(cur_next, 0x0, sizeof(uint32_t) * FS3_CACHESIM_KEYS);
+
+	for (i = 0; i < nrefs; i++) {
+		key = refs[i] & ~FS3_CACHESIM_GET;
+		nu = next_use[i];
+		if (cur_next[key]) {
+			if (refs[i] & FS3_CACHESIM_GET) hits++;
+		} else if (size < c) {
+			size++;
+		} else {
+			// Pop stale pairs until the top is a cached sector's current next use
+			for (;;) {
+				top = heap[0];
+				if (cur_next[top & 0xffffffff] == (uint32_t) (top >> 32)) break;
+				heap[0] = heap[--n];
+				for (pos = 0; (child = 2 * pos + 1) < n; pos = child) {
+					if ((child + 1 < n) && (heap[child + 1] > heap[child])) child++;
+					if (heap[pos] >= heap[child]) break;
+					tmp = heap[pos]; heap[pos] = heap[child]; heap[child] = tmp;
+				}
+			}
+			if ((uint32_t) (top >> 32) <= nu) continue;
+			cur_next[top & 0xffffffff] = 0;
+		}
+
+		// The sector is cached until its next use
+		cur_next[key] = nu;
+		heap[n] = ((uint64_t) nu << 32) | key;
+		for (pos = n++; pos && (heap[(pos - 1) / 2] < heap[pos]); pos = (pos - 1) / 2) {
+			tmp = heap[pos]; heap[pos] = heap[(pos - 1) / 2]; heap[(pos - 1) / 2] = tmp;
+		}
+	}
+	return hits;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : report_working_set
+// Description  : Print the distinct sectors referenced in each window
+//
+// Inputs       : window - references per window
+// Outputs      : none
+
+void report_working_set(uint64_t window) {
+	uint32_t *seen, key;
+	uint64_t i, w, distinct = 0, min = UINT64_MAX, max = 0, total = 0, nwin = 0;
+
+	seen = calloc(FS3_CACHESIM_KEYS, sizeof(uint32_t));
+	CMPSC311_ASSERT0(seen != NULL, "fs3_cachesim out of memory for the working set");
+	printf("\nWorking set (distinct sectors per %lu references)\n", window);
+	printf("  %12s %12s %10s %10s\n", "from", "to", "sectors", "KB");
+	for (i = 0; i < nrefs; i++) {
+		w = i / window + 1;
+		key = refs[i] & ~FS3_CACHESIM_GET;
+		if (seen[key] != w) {
+			seen[key] = w;
+			distinct++;
+		}
+		if ((i + 1 == nrefs) || ((i + 1) % window == 0)) {
+			printf("  %12lu %12lu %10lu %10lu\n", (w - 1) * window, i + 1, distinct,
+				distinct * FS3_SECTOR_SIZE / 1024);
+			min = (distinct < min) ? distinct : min;
+			max = (distinct > max) ? distinct : max;
+			total += distinct;
+			nwin++;
+			distinct = 0;
+		}
+	}
+	if (nwin) {
+		printf("  windows %lu, sectors min %lu mean %lu max %lu\n", nwin, min, total / nwin, max);
+	}
+	free(seen);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_sizes
+// Description  : Parse a comma separated list of cache sizes
+//
+// Inputs       : arg - the list
+//                sizes - the sizes parsed
+// Outputs      : number of sizes, -1 if the list is bad
+
+int parse_sizes(char *arg, uint32_t *sizes) {
+	char *tok, *end;
+	long val;
+	int n = 0;
+
+	for (tok = strtok(arg, ","); tok; tok = strtok(NULL, ",")) {
+		val = strtol(tok, &end, 10);
+		if ((*end != '\0') || (val < 1) || (val > FS3_CACHESIM_KEYS) || (n == FS3_CACHESIM_MAX_SIZES)) {
+			return -1;
+		}
+		sizes[n++] = val;
+	}
+	return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the FS3 cache analyzer
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main( int argc, char *argv[] ) {
+
+	// Local variables
+	uint32_t sizes[FS3_CACHESIM_MAX_SIZES], *last, *next_use, *cur_next;
+	uint64_t *hist, *heap, cold, lru, lo, hi, b, cnt, window = FS3_CACHESIM_WINDOW;
+	uint64_t i, d;
+	int ch, nsizes = 0, s;
+
+	// Process the command line parameters
+	while ((ch = getopt(argc, argv, "hs:W:")) != -1) {
+		switch (ch) {
+		case 's': // Cache sizes
+			if ((nsizes = parse_sizes(optarg, sizes)) < 1) {
+				fprintf( stderr, "Bad cache sizes [%s], aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'W': // Working set window
+			if ( sscanf(optarg, "%lu", &window) != 1 || (window == 0) ) {
+				fprintf( stderr, "Bad working set window [%s], aborting.\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		default:  // Default (unknown)
+			fprintf( stderr, USAGE );
+			return( -1 );
+		}
+	}
+	if ( argc - optind != 1 ) {
+		fprintf( stderr, USAGE );
+		return( -1 );
+	}
+	if ( nsizes == 0 ) {
+		for (nsizes = 0; nsizes < 8; nsizes++) sizes[nsizes] = 128 << nsizes;
+	}
+	initializeLogWithFilehandle( CMPSC311_LOG_STDERR );
+
+	// Collect the references
+	if ( load_refs(argv[optind]) == -1 ) {
+		logMessage( LOG_ERROR_LEVEL, "fs3_cachesim could not read [%s], aborting.", argv[optind] );
+		return( -1 );
+	}
+	if ( (nrefs == 0) || (ngets == 0) ) {
+		printf("No cache gets in [%s].\n", argv[optind]);
+		return( 0 );
+	}
+	if ( nrefs >= FS3_CACHESIM_NEVER ) {
+		logMessage( LOG_ERROR_LEVEL, "fs3_cachesim cannot analyze %lu references.", nrefs );
+		return( -1 );
+	}
+	printf("References %lu (gets %lu, puts %lu)\n", nrefs, ngets, nputs);
+
+	// Reuse distance histogram in power of two buckets
+	hist = calloc(FS3_CACHESIM_KEYS, sizeof(uint64_t));
+	if ( (hist == NULL) || (reuse_distances(hist, &cold) == -1) ) {
+		logMessage( LOG_ERROR_LEVEL, "fs3_cachesim out of memory for reuse distances." );
+		return( -1 );
+	}
+	printf("\nReuse distance (distinct sectors since the last use, gets only)\n");
+	printf("  %18s %12s %8s %8s\n", "distance", "gets", "%", "cum %");
+	printf("  %18s %12lu %7.2f%% %7.2f%%\n", "cold", cold, 100.0 * cold / ngets, 100.0 * cold / ngets);
+	for (lo = 0, b = 0, cnt = cold; lo < FS3_CACHESIM_KEYS; lo = hi + 1, b++) {
+		hi = lo ? lo * 2 - 1 : 0;
+		for (d = lo, i = 0; d <= hi; d++) i += hist[d];
+		if (i == 0) continue;
+		cnt += i;
+		printf("  %8lu - %-7lu %12lu %7.2f%% %7.2f%%\n", lo, hi, i, 100.0 * i / ngets, 100.0 * cnt / ngets);
+	}
+
+	report_working_set(window);
+
+	// Next use of every reference, for OPT
+	last = malloc(sizeof(uint32_t) * FS3_CACHESIM_KEYS);
+	next_use = malloc(sizeof(uint32_t) * nrefs);
+	cur_next = malloc(sizeof(uint32_t) * FS3_CACHESIM_KEYS);
+	heap = malloc(sizeof(uint64_t) * nrefs);
+	arc_prev = malloc(sizeof(uint32_t) * FS3_CACHESIM_KEYS);
+	arc_next = malloc(sizeof(uint32_t) * FS3_CACHESIM_KEYS);
+	arc_where = malloc(FS3_CACHESIM_KEYS);
+	if ( !last || !next_use || !cur_next || !heap || !arc_prev || !arc_next || !arc_where ) {
+		logMessage( LOG_ERROR_LEVEL, "fs3_cachesim out of memory for the policy simulations." );
+		return( -1 );
+	}
+	memset(last, 0xff, sizeof(uint32_t) * FS3_CACHESIM_KEYS);
+	for (i = nrefs; i-- > 0; ) {
+		next_use[i] = last[refs[i] & ~FS3_CACHESIM_GET];
+		last[refs[i] & ~FS3_CACHESIM_GET] = i + 1;
+	}
+
+	// Hit ratios by policy; LRU falls out of the reuse distances
+	printf("\nHit ratio by cache size (gets hit / gets)\n");
+	printf("  %8s %10s %8s %8s %8s\n", "lines", "KB", "LRU", "ARC", "OPT");
+	for (s = 0; s < nsizes; s++) {
+		for (d = 0, lru = 0; (d < sizes[s]) && (d < FS3_CACHESIM_KEYS); d++) lru += hist[d];
+		printf("  %8u %10lu %7.2f%% %7.2f%% %7.2f%%\n", sizes[s], (uint64_t) sizes[s] * FS3_SECTOR_SIZE / 1024,
+			100.0 * lru / ngets, 100.0 * simulate_arc(sizes[s]) / ngets,
+			100.0 * simulate_opt(sizes[s], next_use, cur_next, heap) / ngets);
+	}
+
+	free(arc_where);
+	free(arc_next);
+	free(arc_prev);
+	free(heap);
+	free(cur_next);
+	free(next_use);
+	free(last);
+	free(hist);
+	free(refs);
+	return( 0 );
+}
@@ -0,0 +1,379 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_ctx.c
+//  Description    : This is the implementation of FS3 volume contexts.  The
+//                   driver and cache work on the context fs3_cur points at;
+//                   each fs3_*_ctx call points the calling thread at its
+//                   context for the length of the call.  Every thread starts
+//                   on the default context, which the plain calls use.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_ctx.h>
+#include <fs3_ctx_pi.h>
+#include <fs3_cache.h>
+#include <fs3_wal.h>
+#include <fs3_qos.h>
+#include <fs3_lease.h>
+
+//
+// Defines
+#define FS3_CTX_ALIGN 64               // Contexts start on their own cache line
+
+// Run call on ctx, then put the thread back on the context it was on
+#define CTX_CALL(ctx, type, call) \
+	struct fs3_ctx *prev = fs3_cur; \
+	type ret; \
+	fs3_cur = (ctx); \
+	ret = call; \
+	fs3_cur = prev; \
+	return ret
+
+//
+// Global Variables
+struct fs3_ctx fs3_default_ctx __attribute__((aligned(FS3_CTX_ALIGN))) = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.on_track = FS3_MAX_TRACKS,
+	.wal_last = -1,
+	.pf_cond = PTHREAD_COND_INITIALIZER,
+	.wal_cond = PTHREAD_COND_INITIALIZER,
+	.qos_lock = PTHREAD_MUTEX_INITIALIZER,
+	.qos_cond = PTHREAD_COND_INITIALIZER,
+	.wb_cond = PTHREAD_COND_INITIALIZER,
+	.map_lock = PTHREAD_MUTEX_INITIALIZER
+};
+__thread struct fs3_ctx *fs3_cur = &fs3_default_ctx;
+struct fs3_ctx *fs3_ctx_list = &fs3_default_ctx;
+pthread_mutex_t fs3_ctx_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// Implementation
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_ctx_create
+// Description  : Create an unmounted context with an empty cache
+//
+// Inputs       : none
+// Outputs      : the context if successful, NULL if failure
+
+fs3_ctx *fs3_ctx_create(void) {
+	struct fs3_ctx *ctx;
+
+	if (posix_memalign((void **) &ctx, FS3_CTX_ALIGN, sizeof(struct fs3_ctx)) != 0) {
+		logMessage(LOG_ERROR_LEVEL, "fs3_ctx_create failed allocating a context");
+		return NULL;
+	}
+	memset(ctx, 0x0, sizeof(struct fs3_ctx));
+	pthread_mutex_init(&ctx->lock, NULL);
+	pthread_cond_init(&ctx->pf_cond, NULL);
+	pthread_cond_init(&ctx->wal_cond, NULL);
+	pthread_mutex_init(&ctx->qos_lock, NULL);
+	pthread_cond_init(&ctx->qos_cond, NULL);
+	pthread_cond_init(&ctx->wb_cond, NULL);
+	pthread_mutex_init(&ctx->map_lock, NULL);
+	ctx->on_track = FS3_MAX_TRACKS;
+	ctx->wal_last = -1;
+
+	// Its metrics are merged with the others' when they are exported
+	pthread_mutex_lock(&fs3_ctx_list_lock);
+	ctx->ctx_next = fs3_ctx_list;
+	fs3_ctx_list = ctx;
+	pthread_mutex_unlock(&fs3_ctx_list_lock);
+	return ctx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_ctx_destroy
+// Description  : Unmount the context if it is mounted, then release its
+//                mappings, free its cache and the context itself
+//
+// Inputs       : ctx - the context, not the default one
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_ctx_destroy(fs3_ctx *ctx) {
+	struct fs3_ctx *prev = fs3_cur, **cptr;
+
+	if ((ctx == NULL) || (ctx == &fs3_default_ctx)) return -1;
+	fs3_cur = ctx;
+	if (ctx->mounted) {
+		fs3_unmount_disk();
+	}
+	fs3_mmap_close();
+	fs3_close_cache();
+	fs3_cur = prev;
+
+	pthread_mutex_lock(&fs3_ctx_list_lock);
+	for (cptr = &fs3_ctx_list; *cptr != ctx; cptr = &(*cptr)->ctx_next)
+		;
+	*cptr = ctx->ctx_next;
+	pthread_mutex_unlock(&fs3_ctx_list_lock);
+
+	free(ctx->pf_queue);
+	free(ctx->address);
+	free(ctx->shm_name);
+	free(ctx->lease_name);
+	free(ctx->l2_path);
+	pthread_cond_destroy(&ctx->pf_cond);
+	pthread_cond_destroy(&ctx->wal_cond);
+	pthread_cond_destroy(&ctx->qos_cond);
+	pthread_cond_destroy(&ctx->wb_cond);
+	pthread_mutex_destroy(&ctx->map_lock);
+	pthread_mutex_destroy(&ctx->qos_lock);
+	pthread_mutex_destroy(&ctx->lock);
+	free(ctx);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_ctx_default
+// Description  : Get the context used by the plain fs3_* calls
+//
+// Inputs       : none
+// Outputs      : the default context
+
+fs3_ctx *fs3_ctx_default(void) {
+	return &fs3_default_ctx;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_ctx_set_server
+// Description  : Set the controller a context connects to at its next mount
+//
+// Inputs       : ctx - the context
+//                address - server IP address, NULL for fs3_network_address
+//                port - server port, 0 for fs3_network_port
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_ctx_set_server(fs3_ctx *ctx, const char *address, uint16_t port) {
+	pthread_mutex_lock(&ctx->lock);
+	free(ctx->address);
+	ctx->address = address ? strdup(address) : NULL;
+	ctx->port = port;
+	pthread_mutex_unlock(&ctx->lock);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_*_ctx
+// Description  : The driver and cache interface on a given context, see
+//                fs3_driver.h and fs3_cache.h for each call
+//
+// Inputs       : ctx - the context, then the arguments of the plain call
+// Outputs      : what the plain call returns
+
+int32_t fs3_mount_disk_ctx(fs3_ctx *ctx) {
+	CTX_CALL(ctx, int32_t, fs3_mount_disk());
+}
+
+int32_t fs3_unmount_disk_ctx(fs3_ctx *ctx) {
+	CTX_CALL(ctx, int32_t, fs3_unmount_disk());
+}
+
+int16_t fs3_open_ctx(fs3_ctx *ctx, char *path) {
+	CTX_CALL(ctx, int16_t, fs3_open(path));
+}
+
+int16_t fs3_close_ctx(fs3_ctx *ctx, int16_t fd) {
+	CTX_CALL(ctx, int16_t, fs3_close(fd));
+}
+
+int32_t fs3_read_ctx(fs3_ctx *ctx, int16_t fd, void *buf, int32_t count) {
+	CTX_CALL(ctx, int32_t, fs3_read(fd, buf, count));
+}
+
+int32_t fs3_write_ctx(fs3_ctx *ctx, int16_t fd, void *buf, int32_t count) {
+	CTX_CALL(ctx, int32_t, fs3_write(fd, buf, count));
+}
+
+int32_t fs3_seek_ctx(fs3_ctx *ctx, int16_t fd, uint32_t loc) {
+	CTX_CALL(ctx, int32_t, fs3_seek(fd, loc));
+}
+
+int32_t fs3_lseek_ctx(fs3_ctx *ctx, int16_t fd, uint32_t loc, int whence) {
+	CTX_CALL(ctx, int32_t, fs3_lseek(fd, loc, whence));
+}
+
+int32_t fs3_pread_ctx(fs3_ctx *ctx, int16_t fd, void *buf, int32_t count, uint32_t offset) {
+	CTX_CALL(ctx, int32_t, fs3_pread(fd, buf, count, offset));
+}
+
+int32_t fs3_pwrite_ctx(fs3_ctx *ctx, int16_t fd, void *buf, int32_t count, uint32_t offset) {
+	CTX_CALL(ctx, int32_t, fs3_pwrite(fd, buf, count, offset));
+}
+
+int32_t fs3_readv_ctx(fs3_ctx *ctx, int16_t fd, const struct iovec *iov, int iovcnt) {
+	CTX_CALL(ctx, int32_t, fs3_readv(fd, iov, iovcnt));
+}
+
+int32_t fs3_writev_ctx(fs3_ctx *ctx, int16_t fd, const struct iovec *iov, int iovcnt) {
+	CTX_CALL(ctx, int32_t, fs3_writev(fd, iov, iovcnt));
+}
+
+int32_t fs3_mkdir_ctx(fs3_ctx *ctx, char *path) {
+	CTX_CALL(ctx, int32_t, fs3_mkdir(path));
+}
+
+int32_t fs3_readdir_ctx(fs3_ctx *ctx, char *path, uint32_t pos, FS3DirEntry *ents, int32_t count) {
+	CTX_CALL(ctx, int32_t, fs3_readdir(path, pos, ents, count));
+}
+
+int32_t fs3_stat_ctx(fs3_ctx *ctx, char *path, FS3Stat *st) {
+	CTX_CALL(ctx, int32_t, fs3_stat(path, st));
+}
+
+int32_t fs3_statfs_ctx(fs3_ctx *ctx, FS3StatFs *sf) {
+	CTX_CALL(ctx, int32_t, fs3_statfs(sf));
+}
+
+int32_t fs3_fsync_ctx(fs3_ctx *ctx, int16_t fd) {
+	CTX_CALL(ctx, int32_t, fs3_fsync(fd));
+}
+
+int32_t fs3_unlink_ctx(fs3_ctx *ctx, char *path) {
+	CTX_CALL(ctx, int32_t, fs3_unlink(path));
+}
+
+int32_t fs3_clone_ctx(fs3_ctx *ctx, char *src, char *dst) {
+	CTX_CALL(ctx, int32_t, fs3_clone(src, dst));
+}
+
+int32_t fs3_snapshot_ctx(fs3_ctx *ctx, char *name) {
+	CTX_CALL(ctx, int32_t, fs3_snapshot(name));
+}
+
+int32_t fs3_advise_ctx(fs3_ctx *ctx, int16_t fd, uint32_t offset, uint32_t len, int hint) {
+	CTX_CALL(ctx, int32_t, fs3_advise(fd, offset, len, hint));
+}
+
+void *fs3_mmap_ctx(fs3_ctx *ctx, int16_t fd, uint32_t offset, uint32_t length) {
+	CTX_CALL(ctx, void *, fs3_mmap(fd, offset, length));
+}
+
+int32_t fs3_munmap_ctx(fs3_ctx *ctx, void *addr) {
+	CTX_CALL(ctx, int32_t, fs3_munmap(addr));
+}
+
+int32_t fs3_defrag_ctx(fs3_ctx *ctx, uint32_t min_run, FS3DefragReport *report) {
+	CTX_CALL(ctx, int32_t, fs3_defrag(min_run, report));
+}
+
+int32_t fs3_defrag_at_unmount_ctx(fs3_ctx *ctx, uint32_t min_run) {
+	CTX_CALL(ctx, int32_t, fs3_defrag_at_unmount(min_run));
+}
+
+int32_t fs3_log_defrag_ctx(fs3_ctx *ctx, const FS3DefragReport *report) {
+	CTX_CALL(ctx, int32_t, fs3_log_defrag(report));
+}
+
+int fs3_wal_configure_ctx(fs3_ctx *ctx, int enable) {
+	CTX_CALL(ctx, int, fs3_wal_configure(enable));
+}
+
+int fs3_qos_configure_ctx(fs3_ctx *ctx, int cls, uint32_t weight, uint32_t iops, uint32_t kbps) {
+	CTX_CALL(ctx, int, fs3_qos_configure(cls, weight, iops, kbps));
+}
+
+int32_t fs3_qos_set_ctx(fs3_ctx *ctx, int16_t fd, int cls) {
+	CTX_CALL(ctx, int32_t, fs3_qos_set(fd, cls));
+}
+
+int fs3_log_qos_metrics_ctx(fs3_ctx *ctx) {
+	CTX_CALL(ctx, int, fs3_log_qos_metrics());
+}
+
+int fs3_lease_configure_ctx(fs3_ctx *ctx, const char *name, uint32_t lease_ms) {
+	CTX_CALL(ctx, int, fs3_lease_configure(name, lease_ms));
+}
+
+int fs3_log_lease_metrics_ctx(fs3_ctx *ctx) {
+	CTX_CALL(ctx, int, fs3_log_lease_metrics());
+}
+
+int fs3_init_cache_ctx(fs3_ctx *ctx, uint16_t cachelines) {
+	CTX_CALL(ctx, int, fs3_init_cache(cachelines));
+}
+
+int fs3_share_cache_ctx(fs3_ctx *ctx, const char *name) {
+	CTX_CALL(ctx, int, fs3_share_cache(name));
+}
+
+int fs3_cache_l2_ctx(fs3_ctx *ctx, const char *path, uint32_t cachelines) {
+	CTX_CALL(ctx, int, fs3_cache_l2(path, cachelines));
+}
+
+int fs3_compress_cache_ctx(fs3_ctx *ctx, uint8_t percent) {
+	CTX_CALL(ctx, int, fs3_compress_cache(percent));
+}
+
+int fs3_close_cache_ctx(fs3_ctx *ctx) {
+	CTX_CALL(ctx, int, fs3_close_cache());
+}
+
+int fs3_resize_cache_ctx(fs3_ctx *ctx, uint16_t cachelines) {
+	CTX_CALL(ctx, int, fs3_resize_cache(cachelines));
+}
+
+int fs3_put_cache_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct, void *buf) {
+	CTX_CALL(ctx, int, fs3_put_cache(trk, sct, buf));
+}
+
+int fs3_put_cache_cold_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct, void *buf) {
+	CTX_CALL(ctx, int, fs3_put_cache_cold(trk, sct, buf));
+}
+
+int fs3_fill_cache_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct, void *buf, int cold) {
+	CTX_CALL(ctx, int, fs3_fill_cache(trk, sct, buf, cold));
+}
+
+int fs3_drop_cache_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct) {
+	CTX_CALL(ctx, int, fs3_drop_cache(trk, sct));
+}
+
+int fs3_in_cache_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct) {
+	CTX_CALL(ctx, int, fs3_in_cache(trk, sct));
+}
+
+void *fs3_get_cache_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct) {
+	CTX_CALL(ctx, void *, fs3_get_cache(trk, sct));
+}
+
+int fs3_observe_cache_ctx(fs3_ctx *ctx, FS3CacheObserver fn) {
+	CTX_CALL(ctx, int, fs3_observe_cache(fn));
+}
+
+int fs3_log_cache_metrics_ctx(fs3_ctx *ctx) {
+	CTX_CALL(ctx, int, fs3_log_cache_metrics());
+}
+
+//
+// Metrics Functions
+
+uint64_t fs3_metrics_percentile_ctx(fs3_ctx *ctx, FS3MetricOps op, double pct) {
+	CTX_CALL(ctx, uint64_t, fs3_metrics_percentile(op, pct));
+}
+
+uint64_t fs3_metrics_count_ctx(fs3_ctx *ctx, FS3MetricOps op) {
+	CTX_CALL(ctx, uint64_t, fs3_metrics_count(op));
+}
+
+int fs3_metrics_reset_ctx(fs3_ctx *ctx) {
+	CTX_CALL(ctx, int, fs3_metrics_reset());
+}
+
+int fs3_log_metrics_ctx(fs3_ctx *ctx) {
+	CTX_CALL(ctx, int, fs3_log_metrics());
+}
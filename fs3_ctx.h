@@ -0,0 +1,117 @@
+#ifndef FS3_CTX_INCLUDED
+#define FS3_CTX_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_ctx.h
+//  Description    : This is the interface for FS3 volume contexts.  A context
+//                   owns everything one mounted disk needs (files, allocator,
+//                   cache, controller connection, metadata log), so one
+//                   process can mount several disks and drive them from
+//                   different threads at once.  Each fs3_* call of
+//                   fs3_driver.h, fs3_cache.h, fs3_qos.h and fs3_lease.h has
+//                   an fs3_*_ctx form taking the context first; the plain
+//                   calls use a default context.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include
+#include <stdint.h>
+#include <sys/uio.h>
+#include <fs3_driver.h>
+#include <fs3_cache.h>
+#include <fs3_qos.h>
+#include <fs3_lease.h>
+#include <fs3_metrics.h>
+
+// This is a volume, see fs3_ctx_pi.h
+typedef struct fs3_ctx fs3_ctx;
+
+//
+// Context Functions
+
+fs3_ctx *fs3_ctx_create(void);
+	// Create an unmounted context with an empty cache, NULL if failure
+
+int32_t fs3_ctx_destroy(fs3_ctx *ctx);
+	// Unmount if mounted, free the cache and the context
+
+fs3_ctx *fs3_ctx_default(void);
+	// The context used by the plain fs3_* calls
+
+int32_t fs3_ctx_set_server(fs3_ctx *ctx, const char *address, uint16_t port);
+	// Controller the context connects to at mount (NULL/0 for the defaults)
+
+//
+// Driver Functions, see fs3_driver.h
+
+int32_t fs3_mount_disk_ctx(fs3_ctx *ctx);
+int32_t fs3_unmount_disk_ctx(fs3_ctx *ctx);
+int16_t fs3_open_ctx(fs3_ctx *ctx, char *path);
+int16_t fs3_close_ctx(fs3_ctx *ctx, int16_t fd);
+int32_t fs3_read_ctx(fs3_ctx *ctx, int16_t fd, void *buf, int32_t count);
+int32_t fs3_write_ctx(fs3_ctx *ctx, int16_t fd, void *buf, int32_t count);
+int32_t fs3_seek_ctx(fs3_ctx *ctx, int16_t fd, uint32_t loc);
+int32_t fs3_lseek_ctx(fs3_ctx *ctx, int16_t fd, uint32_t loc, int whence);
+int32_t fs3_pread_ctx(fs3_ctx *ctx, int16_t fd, void *buf, int32_t count, uint32_t offset);
+int32_t fs3_pwrite_ctx(fs3_ctx *ctx, int16_t fd, void *buf, int32_t count, uint32_t offset);
+int32_t fs3_readv_ctx(fs3_ctx *ctx, int16_t fd, const struct iovec *iov, int iovcnt);
+int32_t fs3_writev_ctx(fs3_ctx *ctx, int16_t fd, const struct iovec *iov, int iovcnt);
+int32_t fs3_mkdir_ctx(fs3_ctx *ctx, char *path);
+int32_t fs3_readdir_ctx(fs3_ctx *ctx, char *path, uint32_t pos, FS3DirEntry *ents, int32_t count);
+int32_t fs3_stat_ctx(fs3_ctx *ctx, char *path, FS3Stat *st);
+int32_t fs3_statfs_ctx(fs3_ctx *ctx, FS3StatFs *sf);
+int32_t fs3_fsync_ctx(fs3_ctx *ctx, int16_t fd);
+int32_t fs3_unlink_ctx(fs3_ctx *ctx, char *path);
+int32_t fs3_clone_ctx(fs3_ctx *ctx, char *src, char *dst);
+int32_t fs3_snapshot_ctx(fs3_ctx *ctx, char *name);
+int32_t fs3_advise_ctx(fs3_ctx *ctx, int16_t fd, uint32_t offset, uint32_t len, int hint);
+void *fs3_mmap_ctx(fs3_ctx *ctx, int16_t fd, uint32_t offset, uint32_t length);
+int32_t fs3_munmap_ctx(fs3_ctx *ctx, void *addr);
+int32_t fs3_defrag_ctx(fs3_ctx *ctx, uint32_t min_run, FS3DefragReport *report);
+int32_t fs3_defrag_at_unmount_ctx(fs3_ctx *ctx, uint32_t min_run);
+int32_t fs3_log_defrag_ctx(fs3_ctx *ctx, const FS3DefragReport *report);
+int fs3_wal_configure_ctx(fs3_ctx *ctx, int enable);
+
+//
+// QoS Functions, see fs3_qos.h
+
+int fs3_qos_configure_ctx(fs3_ctx *ctx, int cls, uint32_t weight, uint32_t iops, uint32_t kbps);
+int32_t fs3_qos_set_ctx(fs3_ctx *ctx, int16_t fd, int cls);
+int fs3_log_qos_metrics_ctx(fs3_ctx *ctx);
+
+//
+// Lease Functions, see fs3_lease.h
+
+int fs3_lease_configure_ctx(fs3_ctx *ctx, const char *name, uint32_t lease_ms);
+int fs3_log_lease_metrics_ctx(fs3_ctx *ctx);
+
+//
+// Cache Functions, see fs3_cache.h
+
+int fs3_init_cache_ctx(fs3_ctx *ctx, uint16_t cachelines);
+int fs3_share_cache_ctx(fs3_ctx *ctx, const char *name);
+int fs3_cache_l2_ctx(fs3_ctx *ctx, const char *path, uint32_t cachelines);
+int fs3_compress_cache_ctx(fs3_ctx *ctx, uint8_t percent);
+int fs3_close_cache_ctx(fs3_ctx *ctx);
+int fs3_resize_cache_ctx(fs3_ctx *ctx, uint16_t cachelines);
+int fs3_put_cache_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct, void *buf);
+int fs3_put_cache_cold_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct, void *buf);
+int fs3_fill_cache_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct, void *buf, int cold);
+int fs3_drop_cache_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct);
+int fs3_in_cache_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct);
+void * fs3_get_cache_ctx(fs3_ctx *ctx, FS3TrackIndex trk, FS3SectorIndex sct);
+int fs3_observe_cache_ctx(fs3_ctx *ctx, FS3CacheObserver fn);
+int fs3_log_cache_metrics_ctx(fs3_ctx *ctx);
+
+//
+// Metrics Functions, see fs3_metrics.h
+
+uint64_t fs3_metrics_percentile_ctx(fs3_ctx *ctx, FS3MetricOps op, double pct);
+uint64_t fs3_metrics_count_ctx(fs3_ctx *ctx, FS3MetricOps op);
+int fs3_metrics_reset_ctx(fs3_ctx *ctx);
+int fs3_log_metrics_ctx(fs3_ctx *ctx);
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef FS3_CTX_PI_INCLUDED
+#define FS3_CTX_PI_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_ctx_pi.h
+//  Description    : This is the state of one FS3 volume: its file table,
+//                   allocator, sector cache, controller connection, metadata
+//                   log and prefetch queue.  The driver works on the volume
+//                   fs3_cur points at, which is the default volume unless
+//                   the thread is inside an fs3_*_ctx call.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <pthread.h>
+#include <netinet/in.h>
+
+// Project Includes
+#include <fs3_ctx.h>
+#include <fs3_driver_pi.h>
+#include <fs3_cache_pi.h>
+#include <fs3_mrc.h>
+#include <fs3_wal.h>
+#include <fs3_qos.h>
+#include <fs3_lease.h>
+#include <fs3_metrics.h>
+
+// This is a mounted (or mountable) volume
+struct fs3_ctx {
+
+	// One lock serializes the volume's driver, cache and controller
+	// connection so several threads may call the interface concurrently
+	pthread_mutex_t lock;
+	int lock_waiters;                           // Calls waiting in lock_volume
+
+	// Driver, files and allocation
+	int mounted;
+	int next_fd;
+	int fd_capacity;
+	int nfree_fds;
+	struct File **fd_table;
+	int16_t *free_fds;
+	struct File *root;
+	struct File **ino_table;
+	uint32_t ino_capacity;
+	uint32_t next_ino;
+	int track_used[FS3_MAX_TRACKS];
+	uint32_t sector_refs[FS3_MAX_TRACKS][FS3_TRACK_SIZE];
+	int dirty_sectors;
+	struct File *dirty_files;
+	int dalloc_full;    // a flush over the dirty limit found no room, not retried until sectors are freed
+	int nfiles;
+	int packed_sectors;
+	struct Slot *free_slots[FS3_PACK_CLASSES];
+	struct Slot *carved;
+	int on_track;
+	struct File *fhead;
+	struct File *snapshots;
+	struct File *ftail;
+	uint32_t defrag_min_run;                    // Defragment at unmount, 0 for not
+
+	// Sector cache
+	struct Cache *croot, *chead, *ctail;
+	int cache_size;
+	int cache_capacity;
+	int insert_count;
+	int get_count;
+	int hit_count;
+	int miss_count;
+	FS3CacheObserver observer;                  // Sees every get and put, if set
+	char *shm_name;                             // Shared-memory segment to use, if any
+	struct ShmCache *shm;                       // The segment, if attached
+	size_t shm_size;
+	char shm_line[FS3_SECTOR_SIZE];             // Copy of the last shared sector got
+	uint32_t *shm_seen;                         // Generation + 1 of each sector at our miss, 0 if none
+	char *l2_path;                              // Victim file to use, if any
+	uint32_t l2_lines;                          // Lines it holds
+	struct L2Cache *l2;                         // The file, if mapped
+	size_t l2_size;
+	uint32_t l2_warm;                           // Lines kept from the last run
+	uint64_t l2_hits, l2_stores;
+	uint8_t zc_percent;                         // Share of the cache kept compressed, 0 for none
+	uint32_t zc_pages, zc_max_pages;            // Slab pages allocated, allowed
+	struct ZPage *zc_free;                      // Pages not in a class
+	struct ZPage *zc_partial[FS3_ZC_CLASSES];   // Pages of each class with a free chunk
+	struct ZEntry **zc_buckets;                 // NULL if there is no compressed tier
+	struct ZEntry *zc_head, *zc_tail;
+	struct ZModel zc_model;
+	uint32_t zc_count, zc_peak;                 // Lines compressed, most lines cached at once
+	uint64_t zc_bytes, zc_raw, zc_hits, zc_stores; // Bytes and lines stored, lines stored raw
+
+	// Coherence with the other clients of the disk
+	char *lease_name;                           // Domain to join at mount, if any
+	uint64_t lease_ns;                          // Lease period
+	FS3LeaseTable *leases;                      // The domain, while mounted
+	int lease_slot;                             // Our client in it
+	uint64_t lease_until[FS3_MAX_TRACKS];       // When our lease on each track runs out
+	uint32_t lease_epoch[FS3_MAX_TRACKS];       // Bumped whenever a lease is taken
+	uint64_t lease_since[FS3_MAX_TRACKS];       // When the current epoch of each track began
+	uint64_t lease_grants, lease_renewals, lease_expired, lease_invals, lease_sent, lease_overflows;
+
+	// Miss-ratio curve estimate of the cache
+	uint32_t mrc_last[FS3_MRC_KEYS];            // Last timestamp per sector, 0 if unseen
+	uint32_t mrc_tree[FS3_MRC_TIMES + 1];       // Fenwick tree over timestamps
+	uint64_t mrc_hist[FS3_MRC_MAX_SAMPLED];     // Sampled gets by reuse distance
+	uint64_t mrc_cold, mrc_gets;                // Cold sampled gets, all sampled gets
+	uint32_t mrc_now;                           // Last timestamp handed out
+
+	// Controller connection
+	char *address;                              // Server address, NULL for fs3_network_address
+	unsigned short port;                        // Server port, 0 for fs3_network_port
+	int socket_fd;
+	struct sockaddr_in caddr;
+
+	// Metadata log
+	int wal_configured;                         // Log the next disk mounted
+	int wal_on;                                 // Logging the mounted disk
+	int wal_quiet;                              // Records are not being kept
+	uint32_t wal_area;                          // Checkpoint area of the epoch
+	uint64_t wal_volume;                        // Identity of the logged disk, 0 if none
+	uint32_t wal_mounts;                        // Mounts of it, this one included
+	WalStream wal_log, wal_ckpt;                // The log, a checkpoint being written
+	int wal_dirty;                              // The log sector has records not on disk
+	uint64_t wal_first;                         // When the oldest of them was appended
+	int wal_last;                               // Offset of the last record in the sector
+	uint64_t wal_records, wal_writes, wal_ckpts;
+	int wal_running, wal_stop;                  // Commit thread started, told to stop
+	pthread_t wal_thread;
+	pthread_cond_t wal_cond;                    // Signalled when the log sector turns dirty
+
+	// fs3_advise prefetch
+	struct SectorRead *pf_queue;                // Sectors waiting for the prefetch thread
+	int pf_count, pf_max;
+	int pf_running, pf_stop;
+	pthread_t pf_thread;
+	pthread_cond_t pf_cond;
+
+	// I/O classes, queued in front of the controller once configured
+	int qos_on;
+	FS3QosClass qos[FS3_QOS_CLASSES];
+	struct QosRequest *qos_queue;               // Requests waiting, in tag order
+	int qos_busy;                               // A request is admitted
+	uint64_t qos_vtime;                         // Tag of the last request admitted
+	pthread_mutex_t qos_lock;
+	pthread_cond_t qos_cond;
+	int wb_running, wb_stop;                    // Writeback thread started, told to stop
+	pthread_t wb_thread;
+	pthread_cond_t wb_cond;                     // Signalled when delayed writes pass the limit
+
+	// fs3_mmap mappings of the volume's files
+	struct Mapping *map_head;
+	pthread_mutex_t map_lock;                   // Guards map_head, taken before the driver lock
+
+	// Latency histograms and byte counters, written by this volume alone
+	FS3Metrics metrics;
+	struct fs3_ctx *ctx_next;                   // Next context, for merging metrics at export
+};
+
+// The volume the calling thread is working on
+extern __thread struct fs3_ctx *fs3_cur;
+
+// Every context, guarded by fs3_ctx_list_lock
+extern struct fs3_ctx *fs3_ctx_list;
+extern pthread_mutex_t fs3_ctx_list_lock;
+
+#endif
@@ -0,0 +1,494 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_defrag.c
+//  Description    : This is the FS3 defragmenter.  Files written together
+//                   have their runs of sectors interleaved across tracks, so
+//                   reading one through costs a track seek every few
+//                   sectors.  A pass measures each file's runs and the
+//                   seeks a read of it takes, and moves every file whose
+//                   runs are short on average to fresh runs taken as one
+//                   piece from the allocator.  Sectors are read in track
+//                   order and written to their new places, the new
+//                   placement is logged and only then is the block map
+//                   switched, with cached lines following their sectors.
+//                   Sectors left unused at the ends of tracks are given
+//                   back to the allocator; when files could not be moved
+//                   for want of room, each track's sectors are slid down
+//                   over the unused ones between them and the files are
+//                   tried again.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_driver.h>
+#include <fs3_driver_pi.h>
+#include <fs3_ctx_pi.h>
+#include <fs3_cache.h>
+#include <fs3_wal.h>
+
+//
+// Defines
+#define FS3_DEFRAG_BATCH FS3_TRACK_SIZE  // Sectors copied per batch
+#define FS3_DEFRAG_ROUNDS 16             // Most times tracks are slid for room
+#define DEFRAG_KEY(t, s) ((size_t) (t) * FS3_TRACK_SIZE + (s))
+
+//
+// Implementation
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : defrag_tracks
+// Description  : The tracks file data may be on
+//
+// Inputs       : none
+// Outputs      : tracks below the metadata log's
+
+int defrag_tracks(void) {
+	return fs3_wal_enabled() ? FS3_MAX_TRACKS - FS3_WAL_RESERVED_TRACKS : FS3_MAX_TRACKS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : defrag_measure
+// Description  : Count a file's data sectors, its runs of consecutive
+//                sectors and the track seeks a read of it through takes
+//                (holes neither end a run nor cost a seek)
+//
+// Inputs       : fptr - the file
+//                sectors - set to the data sectors
+//                extents - set to the runs
+//                seeks - set to the seeks
+// Outputs      : 1 if it has sectors shared with a clone or snapshot
+
+int defrag_measure(struct File *fptr, uint32_t *sectors, uint32_t *extents, uint32_t *seeks) {
+	struct Block *bptr;
+	int track = FS3_NO_TRACK, sector = 0, shared = 0;
+
+	*sectors = *extents = *seeks = 0;
+	for (bptr = fptr->bhead; bptr; bptr = bptr->next) {
+		if (bptr->track == FS3_NO_TRACK) continue;
+		(*sectors)++;
+		if (bptr->track != track) {
+			(*seeks)++;
+			(*extents)++;
+		} else if (bptr->sector != sector + 1) {
+			(*extents)++;
+		}
+		track = bptr->track;
+		sector = bptr->sector;
+		shared |= (fs3_cur->sector_refs[track][sector] > 1);
+	}
+	return shared;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : defrag_copy
+// Description  : Copy a batch of sectors to their new places, reading the
+//                old ones in track order.  Cached lines move with their
+//                sectors.
+//
+// Inputs       : moves - the blocks, still at their old places
+//                n - how many
+//                buf - room for n sectors
+// Outputs      : none
+
+void defrag_copy(struct DefragMove *moves, int n, char *buf) {
+	struct SectorRead *reads = malloc(sizeof(struct SectorRead) * n);
+	char *cached, *kept = calloc(n, 1);
+	struct Block *bptr;
+	int i, nreads = 0;
+
+	for (i = 0; i < n; i++) {
+		bptr = moves[i].bptr;
+		if (fs3_in_cache(bptr->track, bptr->sector) && (cached = fs3_get_cache(bptr->track, bptr->sector))) {
+			memcpy(buf + i * FS3_SECTOR_SIZE, cached, FS3_SECTOR_SIZE);
+			kept[i] = 1;
+			continue;
+		}
+		reads[nreads].track = bptr->track;
+		reads[nreads].sector = bptr->sector;
+		reads[nreads].dst = buf + i * FS3_SECTOR_SIZE;
+		reads[nreads].off = 0;
+		reads[nreads++].len = FS3_SECTOR_SIZE;
+	}
+	qsort(reads, nreads, sizeof(struct SectorRead), compare_reads);
+	for (i = 0; i < nreads; i++) {
+		fix_track(reads[i].track);
+		fs3_syscall(FS3_OP_RDSECT, reads[i].sector, 0, 0, reads[i].dst);
+	}
+
+	// no tier may keep an old place, the allocator can hand it out again,
+	// nor a line left at a new place by whatever was there before
+	for (i = 0; i < n; i++) {
+		bptr = moves[i].bptr;
+		fs3_drop_cache(moves[i].track, moves[i].sector);
+		write_to_sector(moves[i].track, moves[i].sector, buf + i * FS3_SECTOR_SIZE);
+		fs3_drop_cache(bptr->track, bptr->sector);
+		if (kept[i]) {
+			fs3_put_cache(moves[i].track, moves[i].sector, buf + i * FS3_SECTOR_SIZE);
+		}
+	}
+	free(reads);
+	free(kept);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : defrag_switch
+// Description  : Log the new places of a batch of copied sectors and point
+//                their blocks at them
+//
+// Inputs       : moves - the blocks, still at their old places
+//                n - how many
+// Outputs      : none
+
+void defrag_switch(struct DefragMove *moves, int n) {
+	int i, len;
+
+	// an extent is one file's consecutive blocks in consecutive sectors
+	for (i = 0; i < n; i += len) {
+		for (len = 1; (i + len < n) && (moves[i + len].ino == moves[i].ino) &&
+			(moves[i + len].blk == moves[i].blk + len) && (moves[i + len].track == moves[i].track) &&
+			(moves[i + len].sector == moves[i].sector + len); len++)
+			;
+		fs3_wal_extent(moves[i].ino, moves[i].blk, moves[i].track, moves[i].sector, len);
+	}
+
+	// an old place may be the new place of a later block
+	for (i = 0; i < n; i++) {
+		fs3_cur->sector_refs[moves[i].bptr->track][moves[i].bptr->sector]--;
+	}
+	for (i = 0; i < n; i++) {
+		moves[i].bptr->track = moves[i].track;
+		moves[i].bptr->sector = moves[i].sector;
+		fs3_cur->sector_refs[moves[i].track][moves[i].sector] = 1;
+	}
+	fs3_wal_commit();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : defrag_file
+// Description  : Move a file's data to as few runs as the allocator gives,
+//                if that is fewer than it has now
+//
+// Inputs       : fptr - the file, with every block placed
+//                sectors - its data sectors
+//                extents - its runs now
+// Outputs      : 1 if moved, 0 if left alone
+
+int defrag_file(struct File *fptr, uint32_t sectors, uint32_t extents) {
+	struct DefragMove *moves = malloc(sizeof(struct DefragMove) * sectors);
+	char *buf = malloc((size_t) FS3_DEFRAG_BATCH * FS3_SECTOR_SIZE);
+	int saved[FS3_MAX_TRACKS], track, sector, len, i;
+	uint32_t k, blk, done, runs = 0;
+	struct Block *bptr;
+
+	for (k = 0, blk = 0, bptr = fptr->bhead; bptr; bptr = bptr->next, blk++) {
+		if (bptr->track == FS3_NO_TRACK) continue;
+		moves[k].bptr = bptr;
+		moves[k].ino = fptr->ino;
+		moves[k++].blk = blk;
+	}
+
+	// take the new runs, putting them back if they are no better
+	memcpy(saved, fs3_cur->track_used, sizeof(saved));
+	for (done = 0; done < sectors; done += len) {
+		if (((len = alloc_run(sectors - done, &track, &sector)) == 0) || (++runs >= extents)) {
+			memcpy(fs3_cur->track_used, saved, sizeof(saved));
+			free(moves);
+			free(buf);
+			return 0;
+		}
+		for (i = 0; i < len; i++) {
+			moves[done + i].track = track;
+			moves[done + i].sector = sector + i;
+		}
+	}
+
+	// the new runs were unused, so one switch at the end is safe
+	for (done = 0; done < sectors; done += len) {
+		len = (sectors - done < FS3_DEFRAG_BATCH) ? sectors - done : FS3_DEFRAG_BATCH;
+		defrag_copy(moves + done, len, buf);
+	}
+	defrag_switch(moves, sectors);
+	free(moves);
+	free(buf);
+	return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : defrag_trim
+// Description  : Give the allocator back the unused sectors at the end of
+//                each track
+//
+// Inputs       : none
+// Outputs      : sectors given back
+
+uint32_t defrag_trim(void) {
+	int top[FS3_MAX_TRACKS] = {0}, t, s, i;
+	uint32_t trimmed = 0;
+
+	// sectors carved into slots stay, whatever the slots hold
+	for (i = 0; i < fs3_cur->packed_sectors; i++) {
+		if (top[fs3_cur->carved[i].track] <= fs3_cur->carved[i].sector) {
+			top[fs3_cur->carved[i].track] = fs3_cur->carved[i].sector + 1;
+		}
+	}
+	for (t = 0; t < defrag_tracks(); t++) {
+		for (s = fs3_cur->track_used[t]; (s > top[t]) && !fs3_cur->sector_refs[t][s - 1]; s--)
+			;
+		trimmed += fs3_cur->track_used[t] - s;
+		fs3_cur->track_used[t] = s;
+	}
+	if (trimmed) {
+		fs3_cur->dalloc_full = 0;
+	}
+	return trimmed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : defrag_slide
+// Description  : Copy a batch of sectors down their track and switch them
+//
+// Inputs       : moves - the blocks, still at their old places
+//                n - how many
+//                buf - room for n sectors
+// Outputs      : n
+
+uint32_t defrag_slide(struct DefragMove *moves, int n, char *buf) {
+	defrag_copy(moves, n, buf);
+	defrag_switch(moves, n);
+	return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : defrag_compact
+// Description  : Slide each track's sectors down over the unused ones
+//                between them, keeping their order, so the unused sectors
+//                end up at the end of the track where they can be trimmed.
+//                Shared and carved sectors stay where they are, and a run
+//                of a file's blocks only moves below one if it fits there.
+//
+// Inputs       : none
+// Outputs      : sectors moved
+
+uint32_t defrag_compact(void) {
+	size_t total = DEFRAG_KEY(FS3_MAX_TRACKS, 0);
+	struct DefragMove *owner = calloc(total, sizeof(struct DefragMove));
+	struct DefragMove *moves = malloc(sizeof(struct DefragMove) * FS3_DEFRAG_BATCH);
+	char *pinned = calloc(total, 1), *buf = malloc((size_t) FS3_DEFRAG_BATCH * FS3_SECTOR_SIZE);
+	uint32_t blk, slid = 0;
+	struct File *fptr;
+	struct Block *bptr;
+	int t, s, w, n, i, len;
+
+	// every sector a single block owns may move
+	for (i = 0; i < fs3_cur->packed_sectors; i++) {
+		pinned[DEFRAG_KEY(fs3_cur->carved[i].track, fs3_cur->carved[i].sector)] = 1;
+	}
+	for (fptr = fs3_cur->fhead; fptr; fptr = fptr->next) {
+		if (fptr->is_dir || fptr->slot) continue;
+		for (blk = 0, bptr = fptr->bhead; bptr; bptr = bptr->next, blk++) {
+			if ((bptr->track == FS3_NO_TRACK) || (fs3_cur->sector_refs[bptr->track][bptr->sector] != 1) ||
+				pinned[DEFRAG_KEY(bptr->track, bptr->sector)]) continue;
+			owner[DEFRAG_KEY(bptr->track, bptr->sector)] = (struct DefragMove) { bptr, fptr->ino, blk, 0, 0 };
+		}
+	}
+
+	for (t = 0; t < defrag_tracks(); t++) {
+		for (s = w = n = 0; s < fs3_cur->track_used[t]; s += len) {
+			if (!owner[DEFRAG_KEY(t, s)].bptr) {
+				len = 1;
+				continue;
+			}
+
+			// a run of one file's blocks moves whole, past sectors that stay
+			for (len = 1; (s + len < fs3_cur->track_used[t]) && owner[DEFRAG_KEY(t, s + len)].bptr &&
+				(owner[DEFRAG_KEY(t, s + len)].ino == owner[DEFRAG_KEY(t, s)].ino) &&
+				(owner[DEFRAG_KEY(t, s + len)].blk == owner[DEFRAG_KEY(t, s)].blk + len); len++)
+				;
+			for (i = w; (i < s) && (i < w + len); i++) {
+				if (pinned[DEFRAG_KEY(t, i)] || (fs3_cur->sector_refs[t][i] && !owner[DEFRAG_KEY(t, i)].bptr)) {
+					w = i + 1;
+				}
+			}
+			for (i = 0; (w != s) && (i < len); i++) {
+
+				// a batch is switched before its writes reach its own reads,
+				// so the places the log still has are intact until then
+				if (n && ((w + i >= moves[0].bptr->sector) || (n == FS3_DEFRAG_BATCH))) {
+					slid += defrag_slide(moves, n, buf);
+					n = 0;
+				}
+				moves[n] = owner[DEFRAG_KEY(t, s + i)];
+				moves[n].track = t;
+				moves[n++].sector = w + i;
+			}
+			w += len;
+		}
+		if (n) {
+			slid += defrag_slide(moves, n, buf);
+		}
+	}
+	free(owner);
+	free(moves);
+	free(pinned);
+	free(buf);
+	return slid;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : defrag_volume
+// Description  : Defragment every file of the mounted disk (called with the
+//                driver lock)
+//
+// Inputs       : min_run - move files whose runs average fewer sectors
+//                report - filled in
+// Outputs      : 0 if successful, -1 if failure
+
+int defrag_volume(uint32_t min_run, FS3DefragReport *report) {
+	struct File *fptr, **retry = NULL;
+	uint32_t sectors, extents, seeks;
+	int shared, nretry = 0, left, round, i;
+
+	memset(report, 0x0, sizeof(FS3DefragReport));
+
+	// other clients of the disk would go on reading the old places
+	if (fs3_cur->leases) {
+		logMessage(LOG_ERROR_LEVEL, "Defrag : disk is shared with other clients, not defragmenting");
+		return -1;
+	}
+
+	// pending writes are placed first so every block can be measured, and
+	// logged so no sector freed before now is still in use after a crash
+	flush_all();
+	fs3_wal_commit();
+	report->sectors_freed = defrag_trim();
+	for (fptr = fs3_cur->fhead; fptr; fptr = fptr->next) {
+		if (fptr->is_dir || fptr->slot || !fptr->bhead) continue;
+		shared = defrag_measure(fptr, &sectors, &extents, &seeks);
+		if (sectors == 0) continue;
+		report->files++;
+		report->extents_before += extents;
+		report->seeks_before += seeks;
+		if ((extents < 2) || (sectors >= (uint64_t) extents * min_run)) continue;
+		report->fragmented++;
+		logMessage(LOG_INFO_LEVEL, "Defrag [%s] : %u sectors in %u runs, %u seeks%s", fptr->name, sectors,
+			extents, seeks, (shared || fptr->is_readonly) ? ", shared, left alone" : "");
+		if (shared || fptr->is_readonly) {
+			report->skipped++;
+		} else if (defrag_file(fptr, sectors, extents)) {
+			report->moved++;
+			report->sectors_moved += sectors;
+			report->sectors_freed += defrag_trim();
+		} else {
+			if ((nretry & (nretry - 1)) == 0) {
+				retry = realloc(retry, sizeof(struct File *) * (nretry ? nretry * 2 : 1));
+			}
+			retry[nretry++] = fptr;
+		}
+	}
+
+	// files with no room for fewer runs get the room sliding tracks frees,
+	// for as long as that moves some of them
+	for (round = 0; nretry && (round < FS3_DEFRAG_ROUNDS); round++) {
+		report->sectors_slid += defrag_compact();
+		report->sectors_freed += defrag_trim();
+		for (i = left = 0; i < nretry; i++) {
+			defrag_measure(retry[i], &sectors, &extents, &seeks);
+			if ((extents < 2) || (sectors >= (uint64_t) extents * min_run)) {
+				report->compacted++;
+			} else if (defrag_file(retry[i], sectors, extents)) {
+				report->moved++;
+				report->sectors_moved += sectors;
+				report->sectors_freed += defrag_trim();
+			} else {
+				retry[left++] = retry[i];
+			}
+		}
+		if (left == nretry) break;
+		nretry = left;
+	}
+	report->skipped += nretry;
+	free(retry);
+
+	for (fptr = fs3_cur->fhead; fptr; fptr = fptr->next) {
+		if (fptr->is_dir || fptr->slot || !fptr->bhead) continue;
+		defrag_measure(fptr, &sectors, &extents, &seeks);
+		report->extents_after += extents;
+		report->seeks_after += seeks;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_defrag
+// Description  : Defragment the mounted disk now, moving every file whose
+//                runs of sectors average fewer than min_run sectors
+//
+// Inputs       : min_run - the threshold, in sectors
+//                report - filled in, if not NULL
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_defrag(uint32_t min_run, FS3DefragReport *report) {
+	FS3DefragReport local;
+	int32_t ret = -1;
+
+	lock_volume();
+	if (fs3_cur->mounted) {
+		ret = defrag_volume(min_run, report ? report : &local);
+	}
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_defrag_at_unmount
+// Description  : Defragment the disk at each unmount, logging the report
+//
+// Inputs       : min_run - the threshold, in sectors, 0 not to
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_defrag_at_unmount(uint32_t min_run) {
+	lock_volume();
+	fs3_cur->defrag_min_run = min_run;
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_log_defrag
+// Description  : Log a defragmentation report
+//
+// Inputs       : report - the report
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_log_defrag(const FS3DefragReport *report) {
+	logMessage(LOG_OUTPUT_LEVEL, "** FS3 defragmentation **");
+	logMessage(LOG_OUTPUT_LEVEL, "Files examined   [%9u]", report->files);
+	logMessage(LOG_OUTPUT_LEVEL, "Fragmented       [%9u]", report->fragmented);
+	logMessage(LOG_OUTPUT_LEVEL, "Moved            [%9u] (%u sectors)", report->moved, report->sectors_moved);
+	logMessage(LOG_OUTPUT_LEVEL, "Compacted        [%9u]", report->compacted);
+	logMessage(LOG_OUTPUT_LEVEL, "Left alone       [%9u]", report->skipped);
+	logMessage(LOG_OUTPUT_LEVEL, "Sectors slid     [%9u]", report->sectors_slid);
+	logMessage(LOG_OUTPUT_LEVEL, "Runs             [%9u] -> [%9u]", report->extents_before, report->extents_after);
+	logMessage(LOG_OUTPUT_LEVEL, "Read seeks       [%9u] -> [%9u]", report->seeks_before, report->seeks_after);
+	logMessage(LOG_OUTPUT_LEVEL, "Sectors freed    [%9u]", report->sectors_freed);
+	return 0;
+}
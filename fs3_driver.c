@@ -11,35 +11,34 @@
 // Includes
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <cmpsc311_log.h>
 
 // Project Includes
 #include <fs3_driver.h>
 #include <fs3_driver_pi.h>
+#include <fs3_ctx_pi.h>
 #include <fs3_cache.h>
+#include <fs3_metrics.h>
+#include <fs3_trace.h>
+#include <fs3_wal.h>
+#include <fs3_qos.h>
+#include <fs3_lease.h>
 
 //
 // Defines
 #define SECTOR_INDEX_NUMBER(x) ((int)(x/FS3_SECTOR_SIZE))
 
-//
-// Static Global Variables
-int mounted = 0;
-int next_fd = 0;
-int next_track = 0;
-int next_sector = 0;
-int on_track = FS3_MAX_TRACKS;
-struct File *fhead = NULL;
-struct File *ftail = NULL;
-
 //
 // Implementation
 
-int syscall(int opcode, int sector, int track, int ret, char *buf) {
+int fs3_syscall(int opcode, int sector, int track, int ret, char *buf) {
 	FS3CmdBlk cmd = construct_cmdBlock(opcode, sector, track, ret);
 	FS3CmdBlk retBlk;
-	network_fs3_syscall(cmd, &ret, buf);
+	if (fs3_cur->leases) fs3_lease_request(opcode);
+	if (network_fs3_syscall(cmd, &retBlk, buf) == -1) return 0;
 	deconstruct_cmdBlock(retBlk, NULL, NULL, NULL, &ret);
+	if (fs3_cur->leases && (ret == 0)) fs3_lease_reply(opcode, sector);
 	return ret == 0;
 }
 
@@ -50,60 +49,444 @@ FS3CmdBlk construct_cmdBlock(int opcode, int sector, int track, int ret) {
 
 void deconstruct_cmdBlock(FS3CmdBlk cmdBlock, int *opcode, int *sector, int *track, int *ret) {
 	if (opcode) *opcode = cmdBlock >> 60 & 0xF;
-	if (sector) *sector = cmdBlock >> 44 & 0xFF;
+	if (sector) *sector = cmdBlock >> 44 & 0xFFFF;
 	if (track) *track = cmdBlock >> 12 & 0xFFFF;
 	if (ret) *ret = cmdBlock >> 11 & 1;
 }
 
-struct File * get_file_by_path(char *path) {
-	struct File *fptr = fhead;
+static uint32_t hash_name(const char *name, int len) {
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < len; ++i) {
+		hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+	}
+	return hash;
+}
+
+struct File * find_entry(struct File *dir, const char *name, int len) {
+	struct File *fptr = dir->buckets[hash_name(name, len) & (dir->nbuckets - 1)];
 	while (fptr) {
-		if (!strcmp(fptr->path, path)) break;
-		fptr = fptr->next;
+		if (!strncmp(fptr->name, name, len) && fptr->name[len] == '\0') break;
+		fptr = fptr->hnext;
+	}
+	return fptr;
+}
+
+struct File * resolve_path(const char *path, struct File **parent, const char **leaf) {
+	struct File *dir, *fptr = fs3_cur->root;
+	const char *name = path;
+	int len;
+
+	// walk the path one component at a time, "" and "/" are the root
+	if (parent) *parent = NULL;
+	if (!fs3_cur->root) return NULL;
+	while (*name == '/') name++;
+	while (*name) {
+		for (len = 0; name[len] && name[len] != '/'; ++len)
+			;
+		if (!fptr->is_dir || len >= FS3_MAX_NAME_LENGTH) {
+			if (parent) *parent = NULL;
+			return NULL;
+		}
+		dir = fptr;
+		fptr = find_entry(dir, name, len);
+		if (parent) *parent = dir;
+		if (leaf) *leaf = name;
+		name += len;
+		while (*name == '/') name++;
+		if (!fptr) {
+			// only the last component may be missing
+			if (*name && parent) *parent = NULL;
+			return NULL;
+		}
 	}
 	return fptr;
 }
 
+struct File * get_file_by_path(char *path) {
+	return resolve_path(path, NULL, NULL);
+}
+
+struct File * get_file_by_ino(uint32_t ino) {
+	return ino < fs3_cur->next_ino ? fs3_cur->ino_table[ino] : NULL;
+}
+
+void set_next_ino(uint32_t ino) {
+	while (fs3_cur->next_ino < ino) {
+		if (fs3_cur->next_ino == fs3_cur->ino_capacity) {
+			fs3_cur->ino_capacity = fs3_cur->ino_capacity ? fs3_cur->ino_capacity * 2 : 256;
+			fs3_cur->ino_table = realloc(fs3_cur->ino_table, sizeof(struct File *) * fs3_cur->ino_capacity);
+		}
+		fs3_cur->ino_table[fs3_cur->next_ino++] = NULL;
+	}
+}
+
 struct File * get_file_by_fd(int16_t fd) {
-	struct File *fptr = fhead;
-	while (fptr) {
-		if (fptr->fd == fd) break;
-		fptr = fptr->next;
+	if (fd < 0 || fd >= fs3_cur->fd_capacity) return NULL;
+	return fs3_cur->fd_table[fd];
+}
+
+int16_t alloc_fd(struct File *fptr) {
+	int16_t fd;
+	if (fs3_cur->nfree_fds) {
+		fd = fs3_cur->free_fds[--fs3_cur->nfree_fds];
+	} else if (fs3_cur->next_fd == INT16_MAX) {
+		return -1;
+	} else {
+		fd = fs3_cur->next_fd++;
+		if (fd >= fs3_cur->fd_capacity) {
+			fs3_cur->fd_capacity = fs3_cur->fd_capacity ? fs3_cur->fd_capacity * 2 : 256;
+			fs3_cur->fd_table = realloc(fs3_cur->fd_table, sizeof(struct File *) * fs3_cur->fd_capacity);
+			fs3_cur->free_fds = realloc(fs3_cur->free_fds, sizeof(int16_t) * fs3_cur->fd_capacity);
+		}
 	}
+	fs3_cur->fd_table[fd] = fptr;
+	return fptr->fd = fd;
+}
+
+void release_fd(struct File *fptr) {
+	fs3_cur->fd_table[fptr->fd] = NULL;
+	fs3_cur->free_fds[fs3_cur->nfree_fds++] = fptr->fd;
+	fptr->fd = -1;
+}
+
+void add_entry(struct File *dir, struct File *fptr) {
+	struct File *eptr, *next;
+	uint32_t i, h;
+
+	// double the buckets once the directory averages one entry per bucket
+	if (dir->nentries == dir->nbuckets) {
+		struct File **buckets = calloc(dir->nbuckets * 2, sizeof(struct File *));
+		for (i = 0; i < dir->nbuckets; ++i) {
+			for (eptr = dir->buckets[i]; eptr; eptr = next) {
+				next = eptr->hnext;
+				h = hash_name(eptr->name, strlen(eptr->name)) & (dir->nbuckets * 2 - 1);
+				eptr->hnext = buckets[h];
+				buckets[h] = eptr;
+			}
+		}
+		free(dir->buckets);
+		dir->buckets = buckets;
+		dir->nbuckets *= 2;
+		dir->entries = realloc(dir->entries, sizeof(struct File *) * dir->nbuckets);
+	}
+
+	h = hash_name(fptr->name, strlen(fptr->name)) & (dir->nbuckets - 1);
+	fptr->hnext = dir->buckets[h];
+	dir->buckets[h] = fptr;
+	dir->entries[dir->nentries++] = fptr;
+}
+
+void remove_entry(struct File *dir, struct File *fptr) {
+	struct File **eptr = &dir->buckets[hash_name(fptr->name, strlen(fptr->name)) & (dir->nbuckets - 1)];
+	uint32_t i;
+
+	while (*eptr != fptr) eptr = &(*eptr)->hnext;
+	*eptr = fptr->hnext;
+	for (i = 0; dir->entries[i] != fptr; ++i)
+		;
+	memmove(&dir->entries[i], &dir->entries[i + 1], sizeof(struct File *) * (dir->nentries - i - 1));
+	dir->nentries--;
+}
+
+void delete_file(struct File *fptr) {
+	fs3_wal_unlink(fptr->ino);
+	fs3_cur->ino_table[fptr->ino] = NULL;
+
+	// dirty blocks that were never placed are simply dropped
+	unlink_dirty(fptr);
+	free_blocks(fptr, 1);
+	if (fptr->slot) free_slot(fptr->slot);
+	remove_entry(fptr->parent, fptr);
+
+	if (fptr->prev) fptr->prev->next = fptr->next;
+	else fs3_cur->fhead = fptr->next;
+	if (fptr->next) fptr->next->prev = fptr->prev;
+	else fs3_cur->ftail = fptr->prev;
+	fs3_cur->nfiles--;
+	free(fptr->name);
+	free(fptr);
+}
+
+struct File * clone_file(struct File *src, struct File *dir, const char *name) {
+	struct File *fptr;
+
+	// place the source's pending writes so every block can be shared, one
+	// left unplaced would be shared as a hole
+	if (flush_file(src) == -1) {
+		return NULL;
+	}
+	fptr = create_file(dir, name, 0);
+	fptr->is_readonly = dir->is_readonly;
+	share_blocks(src, fptr);
+	fs3_wal_clone(fptr->ino, src->ino);
 	return fptr;
 }
 
-struct File * create_file(char *path) {
-	struct File *fptr = (struct File *) malloc(sizeof(struct File));
-	fptr->path = (char *) malloc(strlen(path) + 1);
-	strcpy(fptr->path, path);
-	fptr->fd = next_fd++;
-	fptr->is_open = 1;
-	fptr->size = 0;
-	fptr->loc = 0;
-	fptr->bhead = create_blk();
-	fptr->next = NULL;
+void share_blocks(struct File *src, struct File *fptr) {
+	struct Block *bptr, **tail = &fptr->bhead;
 
-	if (!fhead) {
-		fhead = fptr;
+	fptr->size = src->size;
+	if ((fptr->slot = src->slot)) {
+		fptr->slot->refs++;
+	}
+	for (bptr = src->bhead; bptr; bptr = bptr->next, tail = &(*tail)->next) {
+		*tail = create_blk();
+		if (bptr->track != FS3_NO_TRACK) {
+			(*tail)->track = bptr->track;
+			(*tail)->sector = bptr->sector;
+			fs3_cur->sector_refs[bptr->track][bptr->sector]++;
+		}
+	}
+}
+
+int take_snapshot(const char *name) {
+	struct File *snap;
+
+	if (!fs3_cur->snapshots) {
+		// a name the user took first cannot hold snapshots
+		if (find_entry(fs3_cur->root, FS3_SNAPSHOT_DIR, strlen(FS3_SNAPSHOT_DIR))) return -1;
+		fs3_cur->snapshots = create_file(fs3_cur->root, FS3_SNAPSHOT_DIR, 1);
+		fs3_cur->snapshots->is_readonly = 1;
+	}
+	if (find_entry(fs3_cur->snapshots, name, strlen(name))) return -1;
+	snap = create_file(fs3_cur->snapshots, name, 1);
+	snap->is_readonly = 1;
+	clone_tree(fs3_cur->root, snap);
+	return 0;
+}
+
+void clone_tree(struct File *src, struct File *dir) {
+	for (uint32_t i = 0; i < src->nentries; ++i) {
+		struct File *eptr = src->entries[i];
+		if (eptr == fs3_cur->snapshots) continue;
+		if (eptr->is_dir) {
+			struct File *sub = create_file(dir, eptr->name, 1);
+			sub->is_readonly = dir->is_readonly;
+			clone_tree(eptr, sub);
+		} else {
+			// the caller flushed everything, so no file is left to fail here
+			clone_file(eptr, dir, eptr->name);
+		}
+	}
+}
+
+struct File * create_file(struct File *dir, const char *name, int is_dir) {
+	struct File *fptr = (struct File *) calloc(1, sizeof(struct File));
+	int len = strcspn(name, "/");
+	fptr->name = (char *) malloc(len + 1);
+	memcpy(fptr->name, name, len);
+	fptr->name[len] = '\0';
+	fptr->fd = -1;
+	fptr->is_dir = is_dir;
+	fptr->parent = dir;
+	fptr->ino = fs3_cur->next_ino;
+	set_next_ino(fs3_cur->next_ino + 1);
+	fs3_cur->ino_table[fptr->ino] = fptr;
+	if (is_dir) {
+		fptr->nbuckets = FS3_DIR_MIN_BUCKETS;
+		fptr->buckets = calloc(fptr->nbuckets, sizeof(struct File *));
+		fptr->entries = malloc(sizeof(struct File *) * fptr->nbuckets);
+	}
+	if (dir) {
+		add_entry(dir, fptr);
+		fs3_wal_create(fptr->ino, dir->ino, is_dir, fptr->name);
+	}
+	fs3_cur->nfiles += !is_dir;
+
+	if (!fs3_cur->fhead) {
+		fs3_cur->fhead = fptr;
 	} else {
-		ftail->next = fptr;
+		fs3_cur->ftail->next = fptr;
+		fptr->prev = fs3_cur->ftail;
 	}
-	return ftail = fptr;
+	return fs3_cur->ftail = fptr;
+}
+
+int alloc_run(int want, int *track, int *sector) {
+	int t, best = -1;
+
+	// first track with room for the whole run, else the emptiest track
+	for (t = 0; t < FS3_MAX_TRACKS; ++t) {
+		if (FS3_TRACK_SIZE - fs3_cur->track_used[t] >= want) {
+			best = t;
+			break;
+		}
+		if (best == -1 || fs3_cur->track_used[t] < fs3_cur->track_used[best]) best = t;
+	}
+	if (fs3_cur->track_used[best] == FS3_TRACK_SIZE) return 0;
+	if (want > FS3_TRACK_SIZE - fs3_cur->track_used[best]) want = FS3_TRACK_SIZE - fs3_cur->track_used[best];
+	*track = best;
+	*sector = fs3_cur->track_used[best];
+	fs3_cur->track_used[best] += want;
+	return want;
 }
 
 struct Block *create_blk() {
 	struct Block *bptr = (struct Block *) malloc(sizeof(struct Block));
-	bptr->track = next_track;
-	bptr->sector = next_sector;
+	bptr->track = FS3_NO_TRACK;
+	bptr->sector = 0;
+	bptr->data = NULL;
 	bptr->next = NULL;
+	return bptr;
+}
 
-	if (++next_sector == FS3_TRACK_SIZE) {
-		next_track++;
-		next_sector = 0;
+void release_sector(int track, int sector) {
+	// a sector no file holds may be handed out again, so nothing may stay cached for it
+	if (--fs3_cur->sector_refs[track][sector] == 0) {
+		fs3_drop_cache(track, sector);
 	}
+}
 
-	return bptr;
+void free_blocks(struct File *fptr, int release) {
+	// at unmount the sectors keep their data, and their cached lines
+	while (fptr->bhead) {
+		struct Block *bptr = fptr->bhead->next;
+		if (fptr->bhead->data) {
+			free(fptr->bhead->data);
+			fs3_cur->dirty_sectors--;
+		} else if (release && (fptr->bhead->track != FS3_NO_TRACK)) {
+			release_sector(fptr->bhead->track, fptr->bhead->sector);
+		}
+		free(fptr->bhead);
+		fptr->bhead = bptr;
+	}
+}
+
+void load_block(struct Block *bptr, char *buf) {
+	if (bptr->data) {
+		memcpy(buf, bptr->data, FS3_SECTOR_SIZE);
+	} else if (bptr->track != FS3_NO_TRACK) {
+		read_from_sector(bptr->track, bptr->sector, buf);
+	} else {
+		// a hole, never written
+		memset(buf, 0x0, FS3_SECTOR_SIZE);
+	}
+}
+
+void write_block(struct File *fptr, struct Block *bptr, char *buf) {
+	if (bptr->track != FS3_NO_TRACK) {
+		if (fs3_cur->sector_refs[bptr->track][bptr->sector] == 1) {
+			write_to_sector(bptr->track, bptr->sector, buf);
+			cache_sector(fptr, bptr->track, bptr->sector, buf);
+			return;
+		}
+
+		// shared with a clone or snapshot, copy on write into a new sector
+		release_sector(bptr->track, bptr->sector);
+		bptr->track = FS3_NO_TRACK;
+		bptr->sector = 0;
+	}
+
+	// not placed yet, keep it dirty in memory until the file is flushed
+	if (!bptr->data) {
+		bptr->data = (char *) malloc(FS3_SECTOR_SIZE);
+		fs3_cur->dirty_sectors++;
+		if (!fptr->is_dirty) {
+			fptr->is_dirty = 1;
+			fptr->dnext = fs3_cur->dirty_files;
+			fs3_cur->dirty_files = fptr;
+		}
+	}
+	memcpy(bptr->data, buf, FS3_SECTOR_SIZE);
+
+	// over the limit the dirty files are placed; what finds no room stays in
+	// memory for fsync or close to report, and the flush is not tried again
+	// until defragmenting gives sectors back.  With I/O classes the
+	// writeback thread places them as requests of the classes they belong
+	// to, and a writer only places its own file if the thread falls behind.
+	if ((fs3_cur->dirty_sectors > FS3_DALLOC_MAX_DIRTY) && !fs3_cur->dalloc_full) {
+		if (!fs3_cur->qos_on) {
+			if (flush_all() == -1) fs3_cur->dalloc_full = 1;
+		} else if (fs3_cur->dirty_sectors <= 2 * FS3_DALLOC_MAX_DIRTY) {
+			qos_writeback();
+		} else if (flush_file(fptr) == -1) {
+			fs3_cur->dalloc_full = 1;
+		}
+	}
+}
+
+int flush_file(struct File *fptr) {
+	return flush_part(fptr, -1);
+}
+
+int flush_part(struct File *fptr, int max) {
+	struct Block *bptr = fptr->bhead, *run;
+	int n = 0, len, track, sector, blk = 0, placed = 0, more = 0;
+
+	// give each stretch of dirty blocks one contiguous run where possible,
+	// stopping at the first that does not fit or once max are placed
+	while (bptr && (n == 0)) {
+		if (!bptr->data) {
+			bptr = bptr->next;
+			blk++;
+			continue;
+		}
+		if (max == 0) {
+			more = 1;
+			break;
+		}
+		for (n = 0, run = bptr; run && run->data && (n != max); run = run->next) n++;
+		if (max > 0) max -= n;
+		while (n > 0) {
+			if ((len = alloc_run(n, &track, &sector)) == 0) {
+				logMessage(LOG_ERROR_LEVEL, "FS3 disk full flushing [%s]", fptr->name);
+				break;
+			}
+			fs3_wal_extent(fptr->ino, blk, track, sector, len);
+			placed = 1;
+			for (n -= len, blk += len; len > 0; --len, ++sector, bptr = bptr->next) {
+				bptr->track = track;
+				bptr->sector = sector;
+				fs3_cur->sector_refs[track][sector] = 1;
+				write_to_sector(track, sector, bptr->data);
+				cache_sector(fptr, track, sector, bptr->data);
+				free(bptr->data);
+				bptr->data = NULL;
+				fs3_cur->dirty_sectors--;
+			}
+		}
+	}
+	if (placed) {
+		fs3_wal_size(fptr->ino, fptr->size);
+	}
+
+	// blocks left unplaced keep the file on the list for the next flush
+	unlink_dirty(fptr);
+	if ((n > 0) || more) {
+		fptr->is_dirty = 1;
+		fptr->dnext = fs3_cur->dirty_files;
+		fs3_cur->dirty_files = fptr;
+	}
+	if (n > 0) {
+		fptr->nospace = 1;
+		return -1;
+	}
+	fptr->nospace = 0;
+	return 0;
+}
+
+void unlink_dirty(struct File *fptr) {
+	struct File **dptr;
+	if (fptr->is_dirty) {
+		for (dptr = &fs3_cur->dirty_files; *dptr != fptr; dptr = &(*dptr)->dnext)
+			;
+		*dptr = fptr->dnext;
+		fptr->is_dirty = 0;
+	}
+}
+
+int flush_all() {
+	struct File *fptr, *next = fs3_cur->dirty_files;
+	int ret = 0;
+
+	// files that still do not fit are put back on the (emptied) list
+	fs3_cur->dirty_files = NULL;
+	while ((fptr = next)) {
+		next = fptr->dnext;
+		fptr->is_dirty = 0;
+		if (flush_file(fptr) == -1) ret = -1;
+	}
+	return ret;
 }
 
 struct Block * next_blk(struct Block *bptr) {
@@ -114,25 +497,46 @@ struct Block * next_blk(struct Block *bptr) {
 }
 
 void delete_files() {
-	while (fhead) {
-		while (fhead->bhead) {
-			struct Block *bptr = fhead->bhead->next;
-			free(fhead->bhead);
-			fhead->bhead = bptr;
+	while (fs3_cur->fhead) {
+		free_blocks(fs3_cur->fhead, 0);
+		struct File *next = fs3_cur->fhead->next;
+		if (fs3_cur->fhead->slot && --fs3_cur->fhead->slot->refs == 0) free(fs3_cur->fhead->slot);
+		free(fs3_cur->fhead->name);
+		free(fs3_cur->fhead->buckets);
+		free(fs3_cur->fhead->entries);
+		free(fs3_cur->fhead);
+		fs3_cur->fhead = next;
+	}
+	free(fs3_cur->ino_table);
+	free(fs3_cur->carved);
+	fs3_cur->ino_table = NULL;
+	fs3_cur->carved = NULL;
+	fs3_cur->ino_capacity = fs3_cur->next_ino = 0;
+	fs3_cur->root = fs3_cur->ftail = fs3_cur->snapshots = NULL;
+	fs3_cur->dirty_files = NULL;
+	for (int cls = 0; cls < FS3_PACK_CLASSES; ++cls) {
+		while (fs3_cur->free_slots[cls]) {
+			struct Slot *slot = fs3_cur->free_slots[cls]->next;
+			free(fs3_cur->free_slots[cls]);
+			fs3_cur->free_slots[cls] = slot;
 		}
-		struct File *next = fhead->next;
-		free(fhead->path);
-		free(fhead);
-		fhead = next;
 	}
+	fs3_cur->nfiles = fs3_cur->packed_sectors = 0;
+	free(fs3_cur->fd_table);
+	free(fs3_cur->free_fds);
+	fs3_cur->fd_table = NULL;
+	fs3_cur->free_fds = NULL;
+	fs3_cur->fd_capacity = fs3_cur->nfree_fds = 0;
 }
 
 void fix_track(int track) {
-	if (track != on_track) {
+	if (track != fs3_cur->on_track) {
+		uint64_t start = fs3_metrics_now();
 		char *buf = (char *) malloc(FS3_SECTOR_SIZE);
-		syscall(FS3_OP_TSEEK, 0, track, 0, buf);
+		fs3_syscall(FS3_OP_TSEEK, 0, track, 0, buf);
 		free(buf);
-		on_track = track;
+		fs3_cur->on_track = track;
+		fs3_metrics_record(FS3_MET_DRIVER_TRACK, start);
 	}
 }
 
@@ -142,13 +546,385 @@ void read_from_sector(int track, int sector, char *buf) {
 		memcpy(buf, read_cache, FS3_SECTOR_SIZE);
 	} else {
 		fix_track(track);
-		syscall(FS3_OP_RDSECT, sector, 0, 0, buf);
+		fs3_syscall(FS3_OP_RDSECT, sector, 0, 0, buf);
 	}
 }
 
 void write_to_sector(int track, int sector, char *buf) {
 	fix_track(track);
-	syscall(FS3_OP_WRSECT, sector, 0, 0, buf);
+	fs3_syscall(FS3_OP_WRSECT, sector, 0, 0, buf);
+}
+
+int slot_class(int size) {
+	int cls = 0;
+	while ((FS3_PACK_MIN_SLOT << cls) < size) cls++;
+	return cls;
+}
+
+void carve_slots(int cls, int track, int sector) {
+	struct Slot *slot;
+	int slot_size = FS3_PACK_MIN_SLOT << cls;
+
+	for (int off = FS3_SECTOR_SIZE - slot_size; off >= 0; off -= slot_size) {
+		slot = (struct Slot *) malloc(sizeof(struct Slot));
+		slot->track = track;
+		slot->sector = sector;
+		slot->off = off;
+		slot->cls = cls;
+		slot->next = fs3_cur->free_slots[cls];
+		fs3_cur->free_slots[cls] = slot;
+	}
+
+	// remember every carved sector so a checkpoint can list them
+	if ((fs3_cur->packed_sectors & (fs3_cur->packed_sectors - 1)) == 0) {
+		fs3_cur->carved = realloc(fs3_cur->carved, sizeof(struct Slot) * (fs3_cur->packed_sectors ? fs3_cur->packed_sectors * 2 : 1));
+	}
+	fs3_cur->carved[fs3_cur->packed_sectors].track = track;
+	fs3_cur->carved[fs3_cur->packed_sectors].sector = sector;
+	fs3_cur->carved[fs3_cur->packed_sectors++].cls = cls;
+}
+
+struct Slot * find_slot(int track, int sector, int off, int cls) {
+	struct Slot **sptr, *slot;
+	struct File *fptr;
+
+	// a free slot is taken off its list, a slot in use is shared
+	for (sptr = &fs3_cur->free_slots[cls]; *sptr; sptr = &(*sptr)->next) {
+		slot = *sptr;
+		if (slot->track == track && slot->sector == sector && slot->off == off) {
+			*sptr = slot->next;
+			slot->refs = 1;
+			return slot;
+		}
+	}
+	for (fptr = fs3_cur->fhead; fptr; fptr = fptr->next) {
+		slot = fptr->slot;
+		if (slot && slot->cls == cls && slot->track == track && slot->sector == sector && slot->off == off) {
+			slot->refs++;
+			return slot;
+		}
+	}
+	return NULL;
+}
+
+struct Slot * alloc_slot(int cls) {
+	struct Slot *slot;
+
+	// carve a fresh sector into slots of this class when none are free
+	if (!fs3_cur->free_slots[cls]) {
+		char zero[FS3_SECTOR_SIZE] = {0};
+		int track, sector;
+		if (alloc_run(1, &track, &sector) == 0) {
+			return NULL;
+		}
+		carve_slots(cls, track, sector);
+		fs3_wal_carve(track, sector, cls);
+		fs3_put_cache(track, sector, zero);
+	}
+
+	slot = fs3_cur->free_slots[cls];
+	fs3_cur->free_slots[cls] = slot->next;
+	slot->refs = 1;
+	return slot;
+}
+
+void free_slot(struct Slot *slot) {
+	if (--slot->refs > 0) return;
+	slot->next = fs3_cur->free_slots[slot->cls];
+	fs3_cur->free_slots[slot->cls] = slot;
+}
+
+void read_slot(struct File *fptr, char *buf, int off, int count) {
+	struct Slot *slot = fptr->slot;
+	char sect_buf[FS3_SECTOR_SIZE];
+	read_from_sector(slot->track, slot->sector, sect_buf);
+	fs3_fill_cache(slot->track, slot->sector, sect_buf, fptr->noreuse);
+	memcpy(buf, sect_buf + slot->off + off, count);
+}
+
+void write_slot(struct File *fptr, char *buf, int count) {
+	struct Slot *slot = fptr->slot;
+	char sect_buf[FS3_SECTOR_SIZE];
+	read_from_sector(slot->track, slot->sector, sect_buf);
+	memcpy(sect_buf + slot->off, buf, count);
+	write_to_sector(slot->track, slot->sector, sect_buf);
+	cache_sector(fptr, slot->track, slot->sector, sect_buf);
+}
+
+int32_t read_file(struct File *fptr, char *buf, int32_t count) {
+	if (count == 0 || fptr->loc >= fptr->size) return 0;
+	if (count > fptr->size - fptr->loc) {
+		count = fptr->size - fptr->loc;
+	}
+	if (fptr->slot) {
+		read_slot(fptr, buf, fptr->loc, count);
+		fptr->loc += count;
+		return count;
+	}
+	return read_blocks(fptr, buf, count);
+}
+
+int32_t write_file(struct File *fptr, char *buf, int32_t count) {
+	char data[FS3_PACK_MAX + 1];
+	int end = fptr->loc + count;
+	int size = end > fptr->size ? end : fptr->size;
+	int old_size = fptr->size;
+
+	if (fptr->is_readonly) return -1;
+	if (count == 0) return 0;
+	if ((int64_t) fptr->loc + count > FS3_MAX_FILE_SIZE) return -1;
+
+	// small files live in a slot of a shared sector, rewritten whole
+	if (!fptr->bhead && size <= FS3_PACK_MAX) {
+		if (fptr->slot) {
+			read_slot(fptr, data, 0, fptr->size);
+		}
+		if (fptr->loc > fptr->size) {
+			memset(data + fptr->size, 0x0, fptr->loc - fptr->size);
+		}
+		memcpy(data + fptr->loc, buf, count);
+		if (!fptr->slot || fptr->slot->refs > 1 || (FS3_PACK_MIN_SLOT << fptr->slot->cls) < size) {
+			struct Slot *slot = alloc_slot(slot_class(size));
+			if (!slot) return -1;
+			if (fptr->slot) free_slot(fptr->slot);
+			fptr->slot = slot;
+			write_slot(fptr, data, size);
+			fs3_wal_slot(fptr->ino, slot->track, slot->sector, slot->off, slot->cls);
+		} else {
+			write_slot(fptr, data, size);
+		}
+		fptr->loc = end;
+		fptr->size = size;
+		if (size != old_size) {
+			fs3_wal_size(fptr->ino, size);
+		}
+		return count;
+	}
+
+	// grown past the packing threshold, move the data to its own sectors
+	if (fptr->slot) {
+		int loc = fptr->loc;
+		read_slot(fptr, data, 0, fptr->size);
+		free_slot(fptr->slot);
+		fptr->slot = NULL;
+		fptr->loc = 0;
+		write_blocks(fptr, data, fptr->size);
+		fptr->loc = loc;
+	}
+	count = write_blocks(fptr, buf, count);
+
+	// sizes of files with unplaced blocks are logged when they are flushed
+	if (fptr->size != old_size && !fptr->is_dirty) {
+		fs3_wal_size(fptr->ino, fptr->size);
+	}
+	return count;
+}
+
+int compare_reads(const void *a, const void *b) {
+	const struct SectorRead *x = a, *y = b;
+
+	// the track the disk is already on goes first, then track/sector order
+	if ((x->track == fs3_cur->on_track) != (y->track == fs3_cur->on_track)) return x->track == fs3_cur->on_track ? -1 : 1;
+	if (x->track != y->track) return x->track < y->track ? -1 : 1;
+	return x->sector - y->sector;
+}
+
+void cache_sector(struct File *fptr, int track, int sector, char *buf) {
+	if (fptr->noreuse) {
+		fs3_put_cache_cold(track, sector, buf);
+	} else {
+		fs3_put_cache(track, sector, buf);
+	}
+}
+
+int32_t read_blocks(struct File *fptr, char *buf, int32_t count) {
+	int i, done, len, nreads = 0, off = fptr->loc % FS3_SECTOR_SIZE;
+	struct SectorRead *reads = malloc(sizeof(struct SectorRead) * ((off + count + FS3_SECTOR_SIZE - 1) / FS3_SECTOR_SIZE));
+	char read_buf[FS3_SECTOR_SIZE];
+	char *cached;
+
+	// find current block
+	struct Block *bptr = fptr->bhead;
+	for (i = 0; i < fptr->loc / FS3_SECTOR_SIZE; ++i) {
+		bptr = bptr->next;
+	}
+
+	// copy what is in memory now, plan a disk read for the rest
+	for (done = 0; done < count; done += len, off = 0, bptr = bptr->next) {
+		len = count - done < FS3_SECTOR_SIZE - off ? count - done : FS3_SECTOR_SIZE - off;
+		if (bptr->data) {
+			memcpy(buf + done, bptr->data + off, len);
+		} else if (bptr->track == FS3_NO_TRACK) {
+			memset(buf + done, 0x0, len);
+		} else if ((cached = fs3_get_cache(bptr->track, bptr->sector))) {
+			memcpy(buf + done, cached + off, len);
+		} else {
+			reads[nreads].track = bptr->track;
+			reads[nreads].sector = bptr->sector;
+			reads[nreads].dst = buf + done;
+			reads[nreads].off = off;
+			reads[nreads++].len = len;
+		}
+	}
+
+	// each missing sector is read once, ordered to need the fewest seeks
+	qsort(reads, nreads, sizeof(struct SectorRead), compare_reads);
+	for (i = 0; i < nreads; ++i) {
+		fix_track(reads[i].track);
+		fs3_syscall(FS3_OP_RDSECT, reads[i].sector, 0, 0, read_buf);
+		fs3_fill_cache(reads[i].track, reads[i].sector, read_buf, fptr->noreuse);
+		memcpy(reads[i].dst, read_buf + reads[i].off, reads[i].len);
+	}
+	free(reads);
+
+	fptr->loc += count;
+	if (fptr->advice == FS3_ADVICE_SEQUENTIAL) {
+		advise_readahead(fptr);
+	}
+	return count;
+}
+
+int32_t write_blocks(struct File *fptr, char *buf, int32_t count) {
+
+	// find current block, files get their first block on first write
+	if (!fptr->bhead) {
+		fptr->bhead = create_blk();
+	}
+	struct Block *bptr = fptr->bhead;
+	for (int i = 0; i < fptr->loc / FS3_SECTOR_SIZE; ++i) {
+		bptr = next_blk(bptr);
+	}
+
+	int written = 0;
+	char write_buf[FS3_SECTOR_SIZE] = {0};
+	if (fptr->loc % FS3_SECTOR_SIZE != 0) {
+		// initially partial read
+		load_block(bptr, write_buf);
+		written = count < FS3_SECTOR_SIZE - fptr->loc % FS3_SECTOR_SIZE? 
+				  count : FS3_SECTOR_SIZE - fptr->loc % FS3_SECTOR_SIZE;
+		memcpy(write_buf + fptr->loc % FS3_SECTOR_SIZE, buf, written);
+		write_block(fptr, bptr, write_buf);
+		bptr = next_blk(bptr);
+	}
+
+	for (; written + FS3_SECTOR_SIZE <= count; written += FS3_SECTOR_SIZE) {
+		memcpy(write_buf, buf + written, FS3_SECTOR_SIZE);
+		write_block(fptr, bptr, write_buf);
+		bptr = next_blk(bptr);
+	}
+
+	if (written != count) {
+		if (fptr->loc + count < fptr->size) {
+			load_block(bptr, write_buf);
+		} else {
+			// past the end stays zero, read back if a later write leaves a hole
+			memset(write_buf, 0x0, FS3_SECTOR_SIZE);
+		}
+		memcpy(write_buf, buf + written, count - written);
+		write_block(fptr, bptr, write_buf);
+	}
+
+	// what did not fit on the disk is still written, fsync and close tell
+	fptr->loc += count;
+	if (fptr->size < fptr->loc) {
+		fptr->size = fptr->loc;
+	}
+	return count;
+}
+
+int32_t seek_sparse(struct File *fptr, uint32_t loc, int whence) {
+	struct Block *bptr = fptr->bhead;
+	uint32_t blk, pos;
+
+	if (loc >= fptr->size) return -1;
+	if (fptr->slot) return (whence == FS3_SEEK_DATA) ? (int32_t) loc : fptr->size;
+
+	// blocks run to the last one written, so any hole ends before the end
+	for (blk = 0; blk < loc / FS3_SECTOR_SIZE; ++blk) {
+		bptr = bptr->next;
+	}
+	for (; bptr; bptr = bptr->next, ++blk) {
+		if ((bptr->data || bptr->track != FS3_NO_TRACK) == (whence == FS3_SEEK_DATA)) {
+			pos = blk * FS3_SECTOR_SIZE;
+			return pos > loc ? pos : loc;
+		}
+	}
+	return (whence == FS3_SEEK_HOLE) ? fptr->size : -1;
+}
+
+int32_t iov_length(const struct iovec *iov, int iovcnt) {
+	int64_t len = 0;
+	if (iovcnt < 0) return -1;
+	for (int i = 0; i < iovcnt; ++i) {
+		len += iov[i].iov_len;
+	}
+	return len > INT32_MAX ? -1 : (int32_t) len;
+}
+
+char * iov_gather(const struct iovec *iov, int iovcnt, int32_t len) {
+	char *buf = (char *) malloc(len ? len : 1), *pos = buf;
+	if (!buf) {
+		logMessage(LOG_ERROR_LEVEL, "FS3 out of memory gathering a %d byte write", len);
+		return NULL;
+	}
+	for (int i = 0; i < iovcnt; ++i) {
+		memcpy(pos, iov[i].iov_base, iov[i].iov_len);
+		pos += iov[i].iov_len;
+	}
+	return buf;
+}
+
+void iov_scatter(const struct iovec *iov, int iovcnt, char *buf, int32_t len) {
+	for (int i = 0; i < iovcnt && len > 0; ++i) {
+		size_t n = iov[i].iov_len < (size_t) len ? iov[i].iov_len : (size_t) len;
+		memcpy(iov[i].iov_base, buf, n);
+		buf += n;
+		len -= n;
+	}
+}
+
+// Take the volume lock for a call; the prefetch thread hands the lock over
+// after its batch while any call is waiting here, and is woken once the
+// last of them has it
+void lock_volume(void) {
+	__atomic_fetch_add(&fs3_cur->lock_waiters, 1, __ATOMIC_RELAXED);
+	pthread_mutex_lock(&fs3_cur->lock);
+	if ((__atomic_sub_fetch(&fs3_cur->lock_waiters, 1, __ATOMIC_RELAXED) == 0) && fs3_cur->pf_running) {
+		pthread_cond_signal(&fs3_cur->pf_cond);
+	}
+}
+
+// fs3_read and fs3_write under the volume lock, called a chunk at a time
+// when the volume has I/O classes
+int32_t read_fd(int16_t fd, void *buf, int32_t count) {
+	lock_volume();
+	uint64_t start = fs3_metrics_now();
+	struct File * fptr = get_file_by_fd(fd);
+	if (!fptr || !fptr->is_open) {
+		count = -1;
+	} else {
+		count = read_file(fptr, buf, count);
+		fs3_metrics_add(FS3_CNT_DRIVER_READ, count);
+	}
+	fs3_metrics_record(FS3_MET_DRIVER_READ, start);
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return count;
+}
+
+int32_t write_fd(int16_t fd, void *buf, int32_t count) {
+	lock_volume();
+	uint64_t start = fs3_metrics_now();
+	struct File * fptr = get_file_by_fd(fd);
+	if (!fptr || !fptr->is_open) {
+		count = -1;
+	} else {
+		count = write_file(fptr, buf, count);
+		if (count > 0) fs3_metrics_add(FS3_CNT_DRIVER_WRITE, count);
+	}
+	fs3_metrics_record(FS3_MET_DRIVER_WRITE, start);
+	fs3_wal_poll();
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return count;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -160,13 +936,33 @@ void write_to_sector(int track, int sector, char *buf) {
 // Outputs      : 0 if successful, -1 if failure
 
 int32_t fs3_mount_disk(void) {
-	syscall(FS3_OP_MOUNT, 0, 0, 0, NULL);
-	mounted = 1;
-	next_fd = 0;
-	next_track = 0;
-	next_sector = 0;
-	on_track = FS3_MAX_TRACKS;
-	return 0;
+	int32_t ret = 0;
+	lock_volume();
+	fs3_syscall(FS3_OP_MOUNT, 0, 0, 0, NULL);
+	fs3_cur->mounted = 1;
+	fs3_cur->next_fd = 0;
+	fs3_cur->root = create_file(NULL, "", 1);
+	memset(fs3_cur->track_used, 0x0, sizeof(fs3_cur->track_used));
+	memset(fs3_cur->sector_refs, 0x0, sizeof(fs3_cur->sector_refs));
+	fs3_cur->dalloc_full = 0;
+	fs3_cur->wb_stop = 0;
+	fs3_cur->on_track = FS3_MAX_TRACKS;
+	if (fs3_lease_attach() == -1) {
+		ret = -1;
+	} else if (fs3_wal_recover() == -1) {
+		fs3_lease_detach();
+		ret = -1;
+	}
+
+	// a disk that cannot be joined or recovered is not left half mounted
+	if (ret == -1) {
+		logMessage(LOG_ERROR_LEVEL, "FS3 mount failed, disk left unmounted");
+		fs3_syscall(FS3_OP_UMOUNT, 0, 0, 0, NULL);
+		delete_files();
+		fs3_cur->mounted = 0;
+	}
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return ret;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -178,10 +974,31 @@ int32_t fs3_mount_disk(void) {
 // Outputs      : 0 if successful, -1 if failure
 
 int32_t fs3_unmount_disk(void) {
-	if (!mounted) return -1;
-	syscall(FS3_OP_UMOUNT, 0, 0, 0, NULL);
+	int32_t ret;
+	if (!fs3_cur->mounted) return -1;
+	fs3_mmap_shutdown();
+	fs3_advise_shutdown();
+	fs3_qos_shutdown();
+	fs3_wal_shutdown();
+	lock_volume();
+
+	// defragmenting may make room for blocks that did not fit before
+	if (fs3_cur->defrag_min_run) {
+		FS3DefragReport report;
+		if (defrag_volume(fs3_cur->defrag_min_run, &report) == 0) {
+			fs3_log_defrag(&report);
+		}
+	}
+	ret = flush_all();
+	fs3_wal_close();
+	fs3_syscall(FS3_OP_UMOUNT, 0, 0, 0, NULL);
+	fs3_lease_detach();
+	fs3_cur->mounted = 0;
 	delete_files();
-	return 0;
+	fs3_metrics_dump();
+	fs3_trace_dump();
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return ret;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -193,13 +1010,34 @@ int32_t fs3_unmount_disk(void) {
 // Outputs      : file handle if successful, -1 if failure
 
 int16_t fs3_open(char *path) {
-	struct File * fptr = get_file_by_path(path);
-	if (fptr) {
-		fptr->is_open = 1;
-		return fptr->fd;
-	} else {
-		return create_file(path)->fd;
+	FS3_TRACE(FS3_TR_DRIVER_OPEN, FS3_TR_BEGIN, 0, 0, 0);
+	lock_volume();
+	uint64_t start = fs3_metrics_now();
+	int16_t fd = -1;
+	struct File *dir;
+	const char *name;
+	struct File * fptr = resolve_path(path, &dir, &name);
+	if (!fptr && dir && !dir->is_readonly) {
+		fptr = create_file(dir, name, 0);
+	}
+	if (fptr && !fptr->is_dir) {
+		if (!fptr->is_open) {
+			// a fresh handle starts at the beginning of the file
+			fptr->loc = 0;
+			fptr->advice = FS3_ADVICE_NORMAL;
+			fptr->noreuse = 0;
+			fptr->ra_next = 0;
+			fptr->qos_class = 0;
+			alloc_fd(fptr);
+		}
+		fd = fptr->fd;
+		fptr->is_open = (fd != -1);
 	}
+	fs3_metrics_record(FS3_MET_DRIVER_OPEN, start);
+	fs3_wal_poll();
+	pthread_mutex_unlock(&fs3_cur->lock);
+	FS3_TRACE(FS3_TR_DRIVER_OPEN, FS3_TR_END, 0, 0, fd);
+	return fd;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -211,10 +1049,25 @@ int16_t fs3_open(char *path) {
 // Outputs      : 0 if successful, -1 if failure
 
 int16_t fs3_close(int16_t fd) {
+	int16_t ret = 0;
+	FS3_TRACE(FS3_TR_DRIVER_CLOSE, FS3_TR_BEGIN, fd, 0, 0);
+	lock_volume();
 	struct File * fptr = get_file_by_fd(fd);
-	if (!fptr || !fptr->is_open) return -1;
-	fptr->is_open = 0;
-	return 0;
+	if (!fptr || !fptr->is_open) {
+		ret = -1;
+	} else {
+		// blocks a flush found no room for get one more try, and the
+		// caller hears about it if they still do not fit
+		if (fptr->nospace && (flush_file(fptr) == -1)) {
+			ret = -1;
+		}
+		fptr->is_open = 0;
+		release_fd(fptr);
+	}
+	fs3_wal_poll();
+	pthread_mutex_unlock(&fs3_cur->lock);
+	FS3_TRACE(FS3_TR_DRIVER_CLOSE, FS3_TR_END, fd, 0, ret);
+	return ret;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -229,45 +1082,13 @@ int16_t fs3_close(int16_t fd) {
 // Outputs      : bytes read if successful, -1 if failure
 
 int32_t fs3_read(int16_t fd, void *buf, int32_t count) {
-	struct File * fptr = get_file_by_fd(fd);
-	if (!fptr || !fptr->is_open) return -1;
-	if (count == 0 || fptr->loc == fptr->size) return 0;
-	if (count > fptr->size - fptr->loc) {
-		count = fptr->size - fptr->loc;
-	}
-
-	// find current block
-	struct Block *bptr = fptr->bhead;
-	for (int i = 0; i < fptr->loc / FS3_SECTOR_SIZE; ++i) {
-		bptr = bptr->next;
-	}
-
-	int read = 0;
-	char read_buf[FS3_SECTOR_SIZE] = {0};
-	if (fptr->loc % FS3_SECTOR_SIZE != 0) {
-		// initially partial read
-		read_from_sector(bptr->track, bptr->sector, read_buf);
-		fs3_put_cache(bptr->track, bptr->sector, read_buf);
-		read = count < FS3_SECTOR_SIZE - fptr->loc % FS3_SECTOR_SIZE? 
-			   count : FS3_SECTOR_SIZE - fptr->loc % FS3_SECTOR_SIZE;
-		memcpy(buf, read_buf + fptr->loc % FS3_SECTOR_SIZE, read);
-		bptr = bptr->next;
-	}
-
-	for (; read + FS3_SECTOR_SIZE <= count; read += FS3_SECTOR_SIZE) {
-		read_from_sector(bptr->track, bptr->sector, read_buf);
-		fs3_put_cache(bptr->track, bptr->sector, read_buf);
-		memcpy(buf + read, read_buf, FS3_SECTOR_SIZE);
-		bptr = bptr->next;
-	}
-
-	if (read != count) {
-		read_from_sector(bptr->track, bptr->sector, read_buf);
-		fs3_put_cache(bptr->track, bptr->sector, read_buf);
-		memcpy(buf + read, read_buf, count - read);
+	FS3_TRACE(FS3_TR_DRIVER_READ, FS3_TR_BEGIN, fd, count, 0);
+	if (fs3_cur->qos_on) {
+		count = fs3_qos_transfer(fd, buf, count, read_fd);
+	} else {
+		count = read_fd(fd, buf, count);
 	}
-
-	fptr->loc += count;
+	FS3_TRACE(FS3_TR_DRIVER_READ, FS3_TR_END, fd, 0, count);
 	return count;
 }
 
@@ -283,63 +1104,410 @@ int32_t fs3_read(int16_t fd, void *buf, int32_t count) {
 // Outputs      : bytes written if successful, -1 if failure
 
 int32_t fs3_write(int16_t fd, void *buf, int32_t count) {
-	struct File * fptr = get_file_by_fd(fd);
-	if (!fptr || !fptr->is_open) return -1;
-
-	// find current block
-	struct Block *bptr = fptr->bhead;
-	for (int i = 0; i < fptr->loc / FS3_SECTOR_SIZE; ++i) {
-		bptr = next_blk(bptr);
+	FS3_TRACE(FS3_TR_DRIVER_WRITE, FS3_TR_BEGIN, fd, count, 0);
+	if (fs3_cur->qos_on) {
+		count = fs3_qos_transfer(fd, buf, count, write_fd);
+	} else {
+		count = write_fd(fd, buf, count);
 	}
+	FS3_TRACE(FS3_TR_DRIVER_WRITE, FS3_TR_END, fd, 0, count);
+	return count;
+}
 
-	int written = 0;
-	char write_buf[FS3_SECTOR_SIZE] = {0};
-	if (fptr->loc % FS3_SECTOR_SIZE != 0) {
-		// initially partial read
-		read_from_sector(bptr->track, bptr->sector, write_buf);
-		written = count < FS3_SECTOR_SIZE - fptr->loc % FS3_SECTOR_SIZE? 
-				  count : FS3_SECTOR_SIZE - fptr->loc % FS3_SECTOR_SIZE;
-		memcpy(write_buf + fptr->loc % FS3_SECTOR_SIZE, buf, written);
-		fs3_put_cache(bptr->track, bptr->sector, write_buf);
-		write_to_sector(bptr->track, bptr->sector, write_buf);
-		bptr = next_blk(bptr);
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_pread
+// Description  : Reads "count" bytes at "offset" without moving the file
+//                position
+//
+// Inputs       : fd - the file handle
+//                buf - pointer to buffer to read into
+//                count - number of bytes to read
+//                offset - position in the file to read from
+// Outputs      : bytes read if successful, -1 if failure
+
+int32_t fs3_pread(int16_t fd, void *buf, int32_t count, uint32_t offset) {
+	FS3_TRACE(FS3_TR_DRIVER_READ, FS3_TR_BEGIN, fd, count, 0);
+	int queued = fs3_qos_admit(fd, count);
+	lock_volume();
+	uint64_t start = fs3_metrics_now();
+	struct File * fptr = get_file_by_fd(fd);
+	if (!fptr || !fptr->is_open || offset > FS3_MAX_FILE_SIZE) {
+		count = -1;
+	} else {
+		uint32_t loc = fptr->loc;
+		fptr->loc = offset;
+		count = read_file(fptr, buf, count);
+		fptr->loc = loc;
+		fs3_metrics_add(FS3_CNT_DRIVER_READ, count);
 	}
+	fs3_metrics_record(FS3_MET_DRIVER_READ, start);
+	pthread_mutex_unlock(&fs3_cur->lock);
+	if (queued) fs3_qos_done();
+	FS3_TRACE(FS3_TR_DRIVER_READ, FS3_TR_END, fd, 0, count);
+	return count;
+}
 
-	for (; written + FS3_SECTOR_SIZE <= count; written += FS3_SECTOR_SIZE) {
-		memcpy(write_buf, buf + written, FS3_SECTOR_SIZE);
-		fs3_put_cache(bptr->track, bptr->sector, write_buf);
-		write_to_sector(bptr->track, bptr->sector, write_buf);
-		bptr = next_blk(bptr);
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_pwrite
+// Description  : Writes "count" bytes at "offset" without moving the file
+//                position
+//
+// Inputs       : fd - the file handle
+//                buf - pointer to buffer to write from
+//                count - number of bytes to write
+//                offset - position in the file to write to
+// Outputs      : bytes written if successful, -1 if failure
+
+int32_t fs3_pwrite(int16_t fd, void *buf, int32_t count, uint32_t offset) {
+	FS3_TRACE(FS3_TR_DRIVER_WRITE, FS3_TR_BEGIN, fd, count, 0);
+	int queued = fs3_qos_admit(fd, count);
+	lock_volume();
+	uint64_t start = fs3_metrics_now();
+	struct File * fptr = get_file_by_fd(fd);
+	if (!fptr || !fptr->is_open || offset > FS3_MAX_FILE_SIZE) {
+		count = -1;
+	} else {
+		uint32_t loc = fptr->loc;
+		fptr->loc = offset;
+		count = write_file(fptr, buf, count);
+		fptr->loc = loc;
+		if (count > 0) fs3_metrics_add(FS3_CNT_DRIVER_WRITE, count);
 	}
+	fs3_metrics_record(FS3_MET_DRIVER_WRITE, start);
+	fs3_wal_poll();
+	pthread_mutex_unlock(&fs3_cur->lock);
+	if (queued) fs3_qos_done();
+	FS3_TRACE(FS3_TR_DRIVER_WRITE, FS3_TR_END, fd, 0, count);
+	return count;
+}
 
-	if (written != count) {
-		if (fptr->loc + count < fptr->size) {
-			read_from_sector(bptr->track, bptr->sector, write_buf);
-		}
-		memcpy(write_buf, buf + written, count - written);
-		fs3_put_cache(bptr->track, bptr->sector, write_buf);
-		write_to_sector(bptr->track, bptr->sector, write_buf);
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_readv
+// Description  : Reads into several buffers in turn.  The buffers are filled
+//                from one read of the whole range, so a sector split between
+//                two buffers is still read only once.
+//
+// Inputs       : fd - the file handle
+//                iov - the buffers to read into
+//                iovcnt - number of buffers
+// Outputs      : bytes read if successful, -1 if failure
+
+int32_t fs3_readv(int16_t fd, const struct iovec *iov, int iovcnt) {
+	int32_t count = iov_length(iov, iovcnt);
+	FS3_TRACE(FS3_TR_DRIVER_READ, FS3_TR_BEGIN, fd, count, 0);
+	int queued = fs3_qos_admit(fd, count);
+	lock_volume();
+	uint64_t start = fs3_metrics_now();
+	struct File * fptr = get_file_by_fd(fd);
+	char *buf = NULL;
+	if (!fptr || !fptr->is_open || count < 0) {
+		count = -1;
+	} else if (!(buf = (char *) malloc(count ? count : 1))) {
+		logMessage(LOG_ERROR_LEVEL, "FS3 out of memory scattering a %d byte read", count);
+		count = -1;
+	} else {
+		count = read_file(fptr, buf, count);
+		iov_scatter(iov, iovcnt, buf, count);
+		free(buf);
+		fs3_metrics_add(FS3_CNT_DRIVER_READ, count);
 	}
+	fs3_metrics_record(FS3_MET_DRIVER_READ, start);
+	pthread_mutex_unlock(&fs3_cur->lock);
+	if (queued) fs3_qos_done();
+	FS3_TRACE(FS3_TR_DRIVER_READ, FS3_TR_END, fd, 0, count);
+	return count;
+}
 
-	fptr->loc += count;
-	if (fptr->size < fptr->loc) {
-		fptr->size = fptr->loc;
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_writev
+// Description  : Writes several buffers in turn as one write, so each sector
+//                of the range is written once
+//
+// Inputs       : fd - the file handle
+//                iov - the buffers to write from
+//                iovcnt - number of buffers
+// Outputs      : bytes written if successful, -1 if failure
+
+int32_t fs3_writev(int16_t fd, const struct iovec *iov, int iovcnt) {
+	int32_t count = iov_length(iov, iovcnt);
+	FS3_TRACE(FS3_TR_DRIVER_WRITE, FS3_TR_BEGIN, fd, count, 0);
+	int queued = fs3_qos_admit(fd, count);
+	lock_volume();
+	uint64_t start = fs3_metrics_now();
+	struct File * fptr = get_file_by_fd(fd);
+	char *buf = NULL;
+	if (!fptr || !fptr->is_open || count < 0) {
+		count = -1;
+	} else if (!(buf = iov_gather(iov, iovcnt, count))) {
+		count = -1;
+	} else {
+		count = write_file(fptr, buf, count);
+		free(buf);
+		if (count > 0) fs3_metrics_add(FS3_CNT_DRIVER_WRITE, count);
 	}
+	fs3_metrics_record(FS3_MET_DRIVER_WRITE, start);
+	fs3_wal_poll();
+	pthread_mutex_unlock(&fs3_cur->lock);
+	if (queued) fs3_qos_done();
+	FS3_TRACE(FS3_TR_DRIVER_WRITE, FS3_TR_END, fd, 0, count);
 	return count;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Function     : fs3_seek
-// Description  : Seek to specific point in the file
+// Description  : Seek to specific point in the file.  Seeking past the end
+//                is allowed; a write there leaves a hole that takes no
+//                sectors and reads back as zeros.
 //
 // Inputs       : fd - filename of the file to write to
 //                loc - offset of file in relation to beginning of file
 // Outputs      : 0 if successful, -1 if failure
 
 int32_t fs3_seek(int16_t fd, uint32_t loc) {
+	return (fs3_lseek(fd, loc, FS3_SEEK_SET) == -1) ? -1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_lseek
+// Description  : Seek to a point in the file, or to the next data or hole
+//                at or after it.  The end of the file counts as a hole.
+//
+// Inputs       : fd - the file handle
+//                loc - offset from the beginning of the file
+//                whence - FS3_SEEK_SET, FS3_SEEK_DATA or FS3_SEEK_HOLE
+// Outputs      : the new position, -1 if failure or, for FS3_SEEK_DATA and
+//                FS3_SEEK_HOLE, if loc is at or past the end or there is no
+//                data after it
+
+int32_t fs3_lseek(int16_t fd, uint32_t loc, int whence) {
+	int32_t ret = -1;
+	FS3_TRACE(FS3_TR_DRIVER_SEEK, FS3_TR_BEGIN, fd, loc, 0);
+	lock_volume();
+	uint64_t start = fs3_metrics_now();
 	struct File * fptr = get_file_by_fd(fd);
-	if (!fptr || !fptr->is_open || loc < 0 || loc > fptr->size) return -1;
-	fptr->loc = loc;
+	if (fptr && fptr->is_open) {
+		if (whence == FS3_SEEK_SET) {
+			ret = (loc > FS3_MAX_FILE_SIZE) ? -1 : (int32_t) loc;
+		} else if ((whence == FS3_SEEK_DATA) || (whence == FS3_SEEK_HOLE)) {
+			ret = seek_sparse(fptr, loc, whence);
+		}
+		if (ret != -1) {
+			fptr->loc = ret;
+		}
+	}
+	fs3_metrics_record(FS3_MET_DRIVER_SEEK, start);
+	pthread_mutex_unlock(&fs3_cur->lock);
+	FS3_TRACE(FS3_TR_DRIVER_SEEK, FS3_TR_END, fd, 0, ret);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_mkdir
+// Description  : Create a directory, its parent must already exist
+//
+// Inputs       : path - path of the directory to create
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_mkdir(char *path) {
+	int32_t ret = -1;
+	struct File *dir;
+	const char *name;
+	lock_volume();
+	if (!resolve_path(path, &dir, &name) && dir && !dir->is_readonly) {
+		create_file(dir, name, 1);
+		ret = 0;
+	}
+	fs3_wal_poll();
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_readdir
+// Description  : List a directory, in the order its entries were created
+//
+// Inputs       : path - path of the directory
+//                pos - index of the first entry to return
+//                ents - array to fill
+//                count - size of the array
+// Outputs      : number of entries filled (0 past the end), -1 if failure
+
+int32_t fs3_readdir(char *path, uint32_t pos, FS3DirEntry *ents, int32_t count) {
+	int32_t n = -1;
+	lock_volume();
+	struct File *dir = resolve_path(path, NULL, NULL);
+	if (dir && dir->is_dir && count >= 0) {
+		for (n = 0; n < count && pos + n < dir->nentries; ++n) {
+			struct File *fptr = dir->entries[pos + n];
+			strcpy(ents[n].name, fptr->name);
+			ents[n].is_dir = fptr->is_dir;
+		}
+	}
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_stat
+// Description  : Get the attributes of a file or directory
+//
+// Inputs       : path - path of the file or directory
+//                st - the attributes, filled in
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_stat(char *path, FS3Stat *st) {
+	int32_t ret = -1;
+	lock_volume();
+	struct File *fptr = resolve_path(path, NULL, NULL);
+	if (fptr) {
+		st->size = fptr->size;
+		st->is_dir = fptr->is_dir;
+		st->is_open = fptr->is_open;
+		st->nentries = fptr->nentries;
+		st->is_readonly = fptr->is_readonly;
+		st->sectors = 0;
+		for (struct Block *bptr = fptr->bhead; bptr; bptr = bptr->next) {
+			st->sectors += (bptr->data || bptr->track != FS3_NO_TRACK);
+		}
+		ret = 0;
+	}
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_statfs
+// Description  : Get the space used on the mounted disk
+//
+// Inputs       : sf - the usage, filled in
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_statfs(FS3StatFs *sf) {
+	lock_volume();
+	sf->total_sectors = FS3_MAX_TRACKS * FS3_TRACK_SIZE;
+	sf->used_sectors = 0;
+	sf->shared_sectors = 0;
+	for (int t = 0; t < FS3_MAX_TRACKS; ++t) {
+		sf->used_sectors += fs3_cur->track_used[t];
+		for (int sct = 0; sct < fs3_cur->track_used[t]; ++sct) {
+			sf->shared_sectors += fs3_cur->sector_refs[t][sct] > 1;
+		}
+	}
+	sf->packed_sectors = fs3_cur->packed_sectors;
+	sf->files = fs3_cur->nfiles;
+	pthread_mutex_unlock(&fs3_cur->lock);
 	return 0;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_fsync
+// Description  : Place and write out any data of the file still held in
+//                memory
+//
+// Inputs       : fd - the file handle
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_fsync(int16_t fd) {
+	int32_t ret = 0;
+	lock_volume();
+	struct File *fptr = get_file_by_fd(fd);
+	if (!fptr || !fptr->is_open) {
+		ret = -1;
+	} else {
+		ret = flush_file(fptr);
+		fs3_wal_commit();
+	}
+	fs3_wal_poll();
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_unlink
+// Description  : Delete a closed file, unless fs3_mmap still maps it
+//
+// Inputs       : path - path of the file
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_unlink(char *path) {
+	int32_t ret = -1;
+	lock_volume();
+	struct File *fptr = resolve_path(path, NULL, NULL);
+	if (fptr && !fptr->is_dir && !fptr->is_open && !fptr->is_readonly && !fptr->maps) {
+		delete_file(fptr);
+		ret = 0;
+	}
+	fs3_wal_poll();
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_clone
+// Description  : Make a copy of a file that shares all of its sectors with
+//                the original.  No data moves; the first write to a shared
+//                sector by either file gives that file its own copy.
+//
+// Inputs       : src - path of the file to copy
+//                dst - path of the new file, must not exist
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_clone(char *src, char *dst) {
+	int32_t ret = -1;
+	struct File *dir;
+	const char *name;
+	lock_volume();
+	struct File *fptr = resolve_path(src, NULL, NULL);
+	if (fptr && !fptr->is_dir && !resolve_path(dst, &dir, &name) && dir && !dir->is_readonly &&
+	    clone_file(fptr, dir, name)) {
+		ret = 0;
+	}
+	fs3_wal_poll();
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_snapshot
+// Description  : Take a read-only snapshot of the whole volume, which
+//                appears as FS3_SNAPSHOT_DIR/name and shares every sector
+//                with the live files
+//
+// Inputs       : name - name of the snapshot
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_snapshot(char *name) {
+	int32_t ret = -1;
+	int len = strlen(name);
+	lock_volume();
+	if (fs3_cur->root && len > 0 && len < FS3_MAX_NAME_LENGTH && !strchr(name, '/')) {
+		// with nothing left to place, the snapshot is logged as one record
+		// and with the disk too full to place it, there is no snapshot
+		uint32_t first = fs3_cur->next_ino;
+		if (flush_all() == 0) {
+			fs3_wal_suppress(1);
+			ret = take_snapshot(name);
+			fs3_wal_suppress(0);
+			if (ret == 0) {
+				fs3_wal_snapshot(first, name);
+			}
+		}
+	}
+	fs3_wal_poll();
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return ret;
+}
@@ -13,11 +13,72 @@
 
 // Include files
 #include <stdint.h>
+#include <sys/uio.h>
 #include "fs3_controller.h"
 
 // Defines
-#define FS3_MAX_TOTAL_FILES 1024 // Maximum number of files ever
-#define FS3_MAX_PATH_LENGTH 128 // Maximum length of filename length
+#define FS3_MAX_PATH_LENGTH 128 // Maximum length of a workload filename
+#define FS3_MAX_NAME_LENGTH 256 // Maximum length of one path component
+#define FS3_MMAP_PAGE_SECTORS 4 // Sectors per fs3_mmap page
+#define FS3_SNAPSHOT_DIR ".snapshots" // Directory in the root holding snapshots
+
+// These are the hints taken by fs3_advise
+typedef enum {
+	FS3_ADVICE_NORMAL     = 0,   // No special treatment
+	FS3_ADVICE_SEQUENTIAL = 1,   // Read in order, prefetch ahead of reads
+	FS3_ADVICE_RANDOM     = 2,   // Read in no order, no readahead
+	FS3_ADVICE_NOREUSE    = 3,   // Data used once, cache it as the next to evict
+	FS3_ADVICE_WILLNEED   = 4,   // Prefetch the range in the background
+	FS3_ADVICE_DONTNEED   = 5    // Drop the range from the cache
+} FS3AdviceTypes;
+
+// These are the positions taken by fs3_lseek
+typedef enum {
+	FS3_SEEK_SET  = 0,   // To loc, past the end too
+	FS3_SEEK_DATA = 3,   // To the first data at or after loc
+	FS3_SEEK_HOLE = 4    // To the first hole at or after loc, the end if none
+} FS3SeekTypes;
+
+// This is a directory entry returned by fs3_readdir
+typedef struct {
+	char    name[FS3_MAX_NAME_LENGTH];  // Entry name, without the directory
+	uint8_t is_dir;                     // 1 if the entry is a directory
+} FS3DirEntry;
+
+// These are the attributes returned by fs3_stat
+typedef struct {
+	uint32_t size;       // File size in bytes (0 for directories)
+	uint8_t  is_dir;     // 1 if a directory
+	uint8_t  is_open;    // 1 if the file has an open handle
+	uint32_t nentries;   // Number of entries in a directory
+	uint8_t  is_readonly; // 1 if part of a snapshot
+	uint32_t sectors;    // Sectors of its own holding data (holes take none)
+} FS3Stat;
+
+// This is the disk usage returned by fs3_statfs
+typedef struct {
+	uint32_t total_sectors;   // Sectors on the disk
+	uint32_t used_sectors;    // Sectors allocated to files
+	uint32_t packed_sectors;  // Of those, sectors shared by small files
+	uint32_t shared_sectors;  // Of those, sectors shared by clones and snapshots
+	uint32_t files;           // Number of files
+} FS3StatFs;
+
+// This is the report filled in by fs3_defrag
+typedef struct {
+	uint32_t files;           // Files with data on the disk
+	uint32_t fragmented;      // Of those, files with runs below the threshold
+	uint32_t moved;           // Of those, files moved to fewer runs
+	uint32_t compacted;       // Of those, files sliding tracks alone left in fewer runs
+	uint32_t skipped;         // Of those, files sharing sectors or left as they were
+	uint32_t sectors_moved;   // Sectors copied to move files
+	uint32_t sectors_slid;    // Sectors slid down their track to make room
+	uint32_t extents_before;  // Runs of consecutive sectors, all files
+	uint32_t extents_after;
+	uint32_t seeks_before;    // Track seeks reading every file through
+	uint32_t seeks_after;
+	uint32_t sectors_freed;   // Sectors given back to the allocator
+} FS3DefragReport;
 
 //
 // Interface functions
@@ -45,6 +106,68 @@ int32_t fs3_write(int16_t fd, void *buf, int32_t count);
 	// Writes "count" bytes to the file handle "fh" from the buffer  "buf"
 
 int32_t fs3_seek(int16_t fd, uint32_t loc);
-	// Seek to specific point in the file
+	// Seek to specific point in the file, past the end leaves a hole when written
+
+int32_t fs3_lseek(int16_t fd, uint32_t loc, int whence);
+	// Seek to loc, or to the next data or hole at or after it, returning the position
+
+int32_t fs3_pread(int16_t fd, void *buf, int32_t count, uint32_t offset);
+	// Reads "count" bytes at "offset", leaving the file position alone
+
+int32_t fs3_pwrite(int16_t fd, void *buf, int32_t count, uint32_t offset);
+	// Writes "count" bytes at "offset", leaving the file position alone
+
+int32_t fs3_readv(int16_t fd, const struct iovec *iov, int iovcnt);
+	// Reads into each buffer in turn from the file position
+
+int32_t fs3_writev(int16_t fd, const struct iovec *iov, int iovcnt);
+	// Writes each buffer in turn at the file position
+
+int32_t fs3_mkdir(char *path);
+	// Create a directory, its parent must already exist
+
+int32_t fs3_readdir(char *path, uint32_t pos, FS3DirEntry *ents, int32_t count);
+	// List up to count entries of a directory starting at entry pos
+
+int32_t fs3_stat(char *path, FS3Stat *st);
+	// Get the attributes of a file or directory
+
+int32_t fs3_statfs(FS3StatFs *sf);
+	// Get the space used on the mounted disk
+
+int32_t fs3_fsync(int16_t fd);
+	// Place and write out data of the file still held in memory
+
+int32_t fs3_unlink(char *path);
+	// Delete a closed file that is not mapped
+
+int32_t fs3_clone(char *src, char *dst);
+	// Copy a file by sharing its sectors, copy on write
+
+int32_t fs3_snapshot(char *name);
+	// Take a read-only snapshot of the volume as FS3_SNAPSHOT_DIR/name
+
+int32_t fs3_advise(int16_t fd, uint32_t offset, uint32_t len, int hint);
+	// Hint how len bytes at offset (0 for the rest of the file) will be used
+
+void *fs3_mmap(int16_t fd, uint32_t offset, uint32_t length);
+	// Map part of a file into memory, pages are read on first touch
+	// (do not pass mapped memory to fs3_read/fs3_write, the fault would
+	// wait on the driver lock the caller already holds)
+
+int32_t fs3_munmap(void *addr);
+	// Write dirty pages of a mapping made on the same volume back to the
+	// file and unmap it
+	// (unmounting the disk writes its mappings back first, a later
+	// fs3_munmap only releases the mapping and returns -1)
+
+int32_t fs3_defrag(uint32_t min_run, FS3DefragReport *report);
+	// Move files whose runs of sectors average fewer than min_run to fewer runs
+
+int32_t fs3_defrag_at_unmount(uint32_t min_run);
+	// Defragment (logging the report) at each unmount, 0 to stop
+
+int32_t fs3_log_defrag(const FS3DefragReport *report);
+	// Log a defragmentation report
 
 #endif
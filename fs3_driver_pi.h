@@ -1,43 +1,237 @@
 #ifndef FS3_DRIVER_PI_INCLUDED
 #define FS3_DRIVER_PI_INCLUDED
 
+#include <pthread.h>
 #include "fs3_network.h"
 #include "fs3_driver.h"
 
+#define FS3_DIR_MIN_BUCKETS 8
+
+// files up to FS3_PACK_MAX bytes share sectors, in power of two slots
+#ifndef FS3_PACK_MAX
+#define FS3_PACK_MAX 512
+#endif
+#define FS3_PACK_MIN_SLOT 64
+#define FS3_PACK_CLASSES 5
+
+// written sectors wait in memory for a place on disk until this many pile up
+#ifndef FS3_DALLOC_MAX_DIRTY
+#define FS3_DALLOC_MAX_DIRTY 4096
+#endif
+
+// the largest file, holes and all, is the size of the disk
+#define FS3_MAX_FILE_SIZE (FS3_MAX_TRACKS * FS3_TRACK_SIZE * FS3_SECTOR_SIZE)
+
+// sectors kept queued ahead of a file read with FS3_ADVICE_SEQUENTIAL
+#define FS3_ADVISE_READAHEAD 16
+
+struct Slot {
+    int track;
+    int sector;
+    int off;
+    int cls;
+    int refs;           // files sharing the slot after fs3_clone
+    struct Slot *next;
+};
+
+// a sector read planned by read_blocks, into dst from off for len bytes
+struct SectorRead {
+    int track;
+    int sector;
+    char *dst;
+    int off;
+    int len;
+    int cold;           // queued for prefetch by a NOREUSE file
+    int cls;            // I/O class of the file it is prefetched for
+};
+
+// a block fs3_defrag moves, in file ino at block blk, to track and sector
+struct DefragMove {
+    struct Block *bptr;
+    uint32_t ino;
+    uint32_t blk;
+    int track;
+    int sector;
+};
+
 struct File {
-    char *path;
+    char *name;
+    uint32_t ino;       // names the file in the metadata log
     int16_t fd;
     int is_open;
+    int is_dir;
+    int is_readonly;    // snapshot contents
+    int maps;           // live fs3_mmap mappings, it is not unlinked while any remain
     int size;
     int loc;
+    struct Slot *slot;
     struct Block *bhead;
     struct File *next;
+    struct File *prev;
+
+    // delayed allocation, files holding unplaced sectors are on a list
+    int is_dirty;       // on the dirty list
+    int nospace;        // the last flush found no room for every block
+    struct File *dnext;
+
+    // fs3_advise hints and fs3_qos_set class, cleared when the file is opened
+    int advice;
+    int noreuse;        // cache its sectors at the cold end
+    uint32_t ra_next;   // first block not yet queued for readahead
+    int qos_class;      // fs3_qos_set I/O class
+
+    // namespace, every file is an entry in its parent's hash table
+    struct File *parent;
+    struct File *hnext;
+    struct File **buckets;
+    struct File **entries;
+    uint32_t nbuckets;
+    uint32_t nentries;
 };
 
 struct Block {
-    int track;
+    int track;          // FS3_NO_TRACK until the block is placed
     int sector;
+    char *data;         // contents of a block not yet placed
     struct Block *next;
 };
 
-int syscall(int opcode, int sector, int track, int ret, char *buf);
+int fs3_syscall(int opcode, int sector, int track, int ret, char *buf);
+
+struct File * find_entry(struct File *dir, const char *name, int len);
+
+struct File * resolve_path(const char *path, struct File **parent, const char **leaf);
 
 struct File * get_file_by_path(char *path);
 
+struct File * get_file_by_ino(uint32_t ino);
+
+void set_next_ino(uint32_t ino);
+
 struct File * get_file_by_fd(int16_t fd);
 
-struct File * create_file(char *path);
+int16_t alloc_fd(struct File *fptr);
+
+void release_fd(struct File *fptr);
+
+void add_entry(struct File *dir, struct File *fptr);
+
+void remove_entry(struct File *dir, struct File *fptr);
+
+void delete_file(struct File *fptr);
+
+struct File * clone_file(struct File *src, struct File *dir, const char *name);
+
+void share_blocks(struct File *src, struct File *fptr);
+
+int take_snapshot(const char *name);
+
+void clone_tree(struct File *src, struct File *dir);
+
+struct File * create_file(struct File *dir, const char *name, int is_dir);
+
+int alloc_run(int want, int *track, int *sector);
 
 struct Block * create_blk();
 
+void release_sector(int track, int sector);
+
 struct Block * next_blk(struct Block *bptr);
 
+void free_blocks(struct File *fptr, int release);
+
+void load_block(struct Block *bptr, char *buf);
+
+void write_block(struct File *fptr, struct Block *bptr, char *buf);
+
+int flush_file(struct File *fptr);
+
+int flush_part(struct File *fptr, int max);
+
+void unlink_dirty(struct File *fptr);
+
+int flush_all();
+
 void delete_files();
 
+int32_t iov_length(const struct iovec *iov, int iovcnt);
+
+char * iov_gather(const struct iovec *iov, int iovcnt, int32_t len);
+
+void iov_scatter(const struct iovec *iov, int iovcnt, char *buf, int32_t len);
+
+int32_t read_fd(int16_t fd, void *buf, int32_t count);
+
+int32_t write_fd(int16_t fd, void *buf, int32_t count);
+
 void fix_track(int track);
 
+void lock_volume(void);
+
 void read_from_sector(int track, int sector, char *buf);
 
 void write_to_sector(int track, int sector, char *buf);
 
+int slot_class(int size);
+
+void carve_slots(int cls, int track, int sector);
+
+struct Slot * find_slot(int track, int sector, int off, int cls);
+
+struct Slot * alloc_slot(int cls);
+
+void free_slot(struct Slot *slot);
+
+void read_slot(struct File *fptr, char *buf, int off, int count);
+
+void write_slot(struct File *fptr, char *buf, int count);
+
+int32_t read_file(struct File *fptr, char *buf, int32_t count);
+
+int32_t write_file(struct File *fptr, char *buf, int32_t count);
+
+int compare_reads(const void *a, const void *b);
+
+int32_t read_blocks(struct File *fptr, char *buf, int32_t count);
+
+int32_t write_blocks(struct File *fptr, char *buf, int32_t count);
+
+int32_t seek_sparse(struct File *fptr, uint32_t loc, int whence);
+
+void cache_sector(struct File *fptr, int track, int sector, char *buf);
+
+int prefetch_range(struct File *fptr, uint32_t first, uint32_t last);
+
+void advise_readahead(struct File *fptr);
+
+void fs3_advise_shutdown(void);
+
+void admit_class(int cls, int32_t len);
+
+void qos_writeback(void);
+
+void fs3_qos_shutdown(void);
+
+void fs3_mmap_shutdown(void);
+
+void fs3_mmap_close(void);
+
+int defrag_tracks(void);
+
+int defrag_measure(struct File *fptr, uint32_t *sectors, uint32_t *extents, uint32_t *seeks);
+
+void defrag_copy(struct DefragMove *moves, int n, char *buf);
+
+void defrag_switch(struct DefragMove *moves, int n);
+
+int defrag_file(struct File *fptr, uint32_t sectors, uint32_t extents);
+
+uint32_t defrag_trim(void);
+
+uint32_t defrag_slide(struct DefragMove *moves, int n, char *buf);
+
+uint32_t defrag_compact(void);
+
+int defrag_volume(uint32_t min_run, FS3DefragReport *report);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,234 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_l2cache.c
+//  Description    : This is the victim file of the FS3 cache.  Lines evicted
+//                   from the cache are written to a memory-mapped file,
+//                   FS3_L2_WAYS-way set associative by sector, which is
+//                   checked on a miss before the controller is asked.  The
+//                   file is kept when the cache is closed, stamped with the
+//                   logged disk it belongs to, so the next run on the same
+//                   disk starts warm; it is emptied at open if it was not
+//                   closed properly or the disk has changed.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_cache.h>
+#include <fs3_cache_pi.h>
+#include <fs3_ctx_pi.h>
+#include <fs3_wal.h>
+
+//
+// Defines
+#define FS3_L2_PAGE 4096
+#define L2_ENTRIES(c) ((struct L2Entry *) ((c) + 1))
+#define L2_DATA_OFFSET(lines) ((sizeof(struct L2Cache) + sizeof(struct L2Entry) * (lines) + FS3_L2_PAGE - 1) & \
+	~((size_t) FS3_L2_PAGE - 1))
+#define L2_DATA(c) ((char *) (c) + L2_DATA_OFFSET((c)->lines))
+
+//
+// Implementation
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : l2_find
+// Description  : Find the entry of a sector in its set
+//
+// Inputs       : c - the victim file
+//                key - the sector's key
+//                victim - set to the entry to replace if it is not there,
+//                         if not NULL
+// Outputs      : the entry index, -1 if not stored
+
+int64_t l2_find(struct L2Cache *c, uint32_t key, int64_t *victim) {
+	struct L2Entry *e = L2_ENTRIES(c);
+	uint32_t set = (key * 2654435761u) % (c->lines / FS3_L2_WAYS), way;
+	int64_t first = (int64_t) set * FS3_L2_WAYS, old = first;
+	uint64_t age, oldest = UINT64_MAX;
+
+	// an empty entry is the oldest there is
+	for (way = 0; way < FS3_L2_WAYS; way++) {
+		if (e[first + way].key == key) return first + way;
+		age = e[first + way].key ? e[first + way].used : 0;
+		if (age < oldest) {
+			oldest = age;
+			old = first + way;
+		}
+	}
+	if (victim) *victim = old;
+	return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : l2_cache_attach
+// Description  : Map the victim file, keeping its lines only if it was
+//                closed properly by the last client to mount the disk
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int l2_cache_attach(void) {
+	uint32_t lines = (fs3_cur->l2_lines + FS3_L2_WAYS - 1) / FS3_L2_WAYS * FS3_L2_WAYS;
+	size_t size = L2_DATA_OFFSET(lines) + (size_t) lines * FS3_SECTOR_SIZE;
+	uint64_t stamp = fs3_wal_stamp(1);
+	struct L2Cache *c;
+	struct stat st;
+	int fd, keep;
+	uint32_t i;
+
+	if ((fd = open(fs3_cur->l2_path, O_RDWR | O_CREAT, 0600)) == -1) {
+		logMessage(LOG_ERROR_LEVEL, "Victim file [%s] could not be opened: %s", fs3_cur->l2_path, strerror(errno));
+		return -1;
+	}
+	if ((fstat(fd, &st) == -1) || ((st.st_size != size) && (ftruncate(fd, size) == -1))) {
+		logMessage(LOG_ERROR_LEVEL, "Victim file [%s] could not be sized: %s", fs3_cur->l2_path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+	c = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (c == MAP_FAILED) {
+		logMessage(LOG_ERROR_LEVEL, "Victim file [%s] could not be mapped: %s", fs3_cur->l2_path, strerror(errno));
+		return -1;
+	}
+
+	// leases start every line in a new epoch, so nothing stored is covered
+	keep = (st.st_size == size) && (c->magic == FS3_L2_MAGIC) && (c->lines == lines) && c->clean &&
+		stamp && (c->stamp == stamp) && !fs3_cur->lease_name;
+	fs3_cur->l2_warm = 0;
+	if (!keep) {
+		memset(c, 0x0, L2_DATA_OFFSET(lines));
+		c->magic = FS3_L2_MAGIC;
+		c->lines = lines;
+	} else {
+		for (i = 0; i < lines; i++) {
+			fs3_cur->l2_warm += (L2_ENTRIES(c)[i].key != 0);
+		}
+	}
+
+	// a crash from here on leaves the file to be emptied at the next open
+	c->clean = 0;
+	msync(c, FS3_L2_PAGE, MS_SYNC);
+	fs3_cur->l2 = c;
+	fs3_cur->l2_size = size;
+	fs3_cur->l2_hits = fs3_cur->l2_stores = 0;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : l2_cache_detach
+// Description  : Store what is still cached, write the file out and mark it
+//                clean for the next run
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int l2_cache_detach(void) {
+	struct L2Cache *c = fs3_cur->l2;
+	struct Cache *cptr;
+
+	// least recently used first, so the most recent lines win their sets
+	for (cptr = fs3_cur->chead; cptr; cptr = cptr->next) {
+		l2_cache_put(cptr->track, cptr->sector, cptr->data, cptr->epoch);
+	}
+	msync(c, fs3_cur->l2_size, MS_SYNC);
+	c->stamp = fs3_wal_stamp(0);
+	c->clean = 1;
+	msync(c, FS3_L2_PAGE, MS_SYNC);
+	munmap(c, fs3_cur->l2_size);
+	fs3_cur->l2 = NULL;
+	fs3_cur->l2_size = 0;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : l2_cache_get
+// Description  : Look for a sector in the victim file
+//
+// Inputs       : track - the track
+//                sector - the sector
+//                epoch - set to the lease epoch it was stored in
+// Outputs      : the sector in the file, NULL if not stored
+
+char * l2_cache_get(int track, int sector, uint32_t *epoch) {
+	struct L2Cache *c = fs3_cur->l2;
+	int64_t i = l2_find(c, track * FS3_TRACK_SIZE + sector + 1, NULL);
+
+	if (i < 0) return NULL;
+	L2_ENTRIES(c)[i].used = ++c->clock;
+	*epoch = L2_ENTRIES(c)[i].epoch;
+	return L2_DATA(c) + i * FS3_SECTOR_SIZE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : l2_cache_put
+// Description  : Store a sector evicted from the cache, replacing the least
+//                recently used line of its set
+//
+// Inputs       : track - the track
+//                sector - the sector
+//                buf - the data
+//                epoch - the lease epoch it was cached in
+// Outputs      : none
+
+void l2_cache_put(int track, int sector, char *buf, uint32_t epoch) {
+	struct L2Cache *c = fs3_cur->l2;
+	uint32_t key = track * FS3_TRACK_SIZE + sector + 1;
+	int64_t victim, i = l2_find(c, key, &victim);
+
+	i = (i < 0) ? victim : i;
+	memcpy(L2_DATA(c) + i * FS3_SECTOR_SIZE, buf, FS3_SECTOR_SIZE);
+	L2_ENTRIES(c)[i].key = key;
+	L2_ENTRIES(c)[i].epoch = epoch;
+	L2_ENTRIES(c)[i].used = ++c->clock;
+	fs3_cur->l2_stores++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : l2_cache_drop
+// Description  : Forget a sector whose stored copy is out of date
+//
+// Inputs       : track - the track
+//                sector - the sector
+// Outputs      : none
+
+void l2_cache_drop(int track, int sector) {
+	struct L2Cache *c = fs3_cur->l2;
+	int64_t i = l2_find(c, track * FS3_TRACK_SIZE + sector + 1, NULL);
+
+	if (i >= 0) {
+		L2_ENTRIES(c)[i].key = 0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : l2_cache_log
+// Description  : Log how the victim file was used this run
+//
+// Inputs       : none
+// Outputs      : none
+
+void l2_cache_log(void) {
+	logMessage(LOG_OUTPUT_LEVEL, "Victim file [%s] : %u lines, %u kept from the last run", fs3_cur->l2_path,
+		fs3_cur->l2->lines, fs3_cur->l2_warm);
+	logMessage(LOG_OUTPUT_LEVEL, "Victim stores    [%9lu]", fs3_cur->l2_stores);
+	logMessage(LOG_OUTPUT_LEVEL, "Victim hits      [%9lu]", fs3_cur->l2_hits);
+}
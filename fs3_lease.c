@@ -0,0 +1,362 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_lease.c
+//  Description    : This is the implementation of FS3 cache coherence.  A
+//                   client keeps its own copy of its lease times and an
+//                   epoch per track, bumped whenever it takes a lease it did
+//                   not hold; cached sectors carry the epoch they were put
+//                   in, so those cached before a lease ran out (when
+//                   invalidations may have been missed) are never used.
+//                   Invalidations are posted under the domain lock and
+//                   drained by their client without it.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_driver.h>
+#include <fs3_cache.h>
+#include <fs3_ctx_pi.h>
+#include <fs3_metrics.h>
+#include <fs3_lease.h>
+
+//
+// Defines
+#define FS3_LEASE_ATTACH_TRIES 1000         // Waits of 1 ms for the creator to finish
+
+//
+// Implementation
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : lease_lock
+// Description  : Take the domain lock, carrying on if its holder died (a
+//                half posted invalidation is simply not seen)
+//
+// Inputs       : t - the domain
+// Outputs      : none
+
+void lease_lock(FS3LeaseTable *t) {
+	if (pthread_mutex_lock(&t->lock) == EOWNERDEAD) {
+		pthread_mutex_consistent(&t->lock);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : lease_open
+// Description  : Map a domain's segment, creating it if no client has
+//
+// Inputs       : name - the segment name
+// Outputs      : the domain, NULL if failure
+
+FS3LeaseTable * lease_open(const char *name) {
+	pthread_mutexattr_t attr;
+	FS3LeaseTable *t;
+	struct stat st;
+	int fd, created = 1, i;
+
+	if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) == -1) {
+		created = 0;
+		if ((errno != EEXIST) || ((fd = shm_open(name, O_RDWR, 0600)) == -1)) {
+			logMessage(LOG_ERROR_LEVEL, "Lease domain [%s] could not be opened: %s", name, strerror(errno));
+			return NULL;
+		}
+		for (i = 0; (fstat(fd, &st) == 0) && (st.st_size < sizeof(FS3LeaseTable)) &&
+			(i < FS3_LEASE_ATTACH_TRIES); i++) {
+			usleep(1000);
+		}
+	} else if (ftruncate(fd, sizeof(FS3LeaseTable)) == -1) {
+		logMessage(LOG_ERROR_LEVEL, "Lease domain [%s] could not be sized: %s", name, strerror(errno));
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+	t = mmap(NULL, sizeof(FS3LeaseTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (t == MAP_FAILED) {
+		logMessage(LOG_ERROR_LEVEL, "Lease domain [%s] could not be mapped: %s", name, strerror(errno));
+		if (created) shm_unlink(name);
+		return NULL;
+	}
+
+	if (created) {
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+		pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+		pthread_mutex_init(&t->lock, &attr);
+		pthread_mutexattr_destroy(&attr);
+		__atomic_store_n(&t->magic, FS3_LEASE_MAGIC, __ATOMIC_RELEASE);
+	} else {
+		for (i = 0; (__atomic_load_n(&t->magic, __ATOMIC_ACQUIRE) != FS3_LEASE_MAGIC) &&
+			(i < FS3_LEASE_ATTACH_TRIES); i++) {
+			usleep(1000);
+		}
+		if (t->magic != FS3_LEASE_MAGIC) {
+			logMessage(LOG_ERROR_LEVEL, "Lease domain [%s] is not an FS3 lease table", name);
+			munmap(t, sizeof(FS3LeaseTable));
+			return NULL;
+		}
+	}
+	return t;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_lease_configure
+// Description  : Set the coherence domain the next mount joins
+//
+// Inputs       : name - the segment name ("/name"), NULL for none
+//                lease_ms - the lease period
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_lease_configure(const char *name, uint32_t lease_ms) {
+	if (name && ((name[0] != '/') || strchr(name + 1, '/') || (lease_ms == 0))) {
+		logMessage(LOG_ERROR_LEVEL, "Lease domain [%s] must be /name with a lease period", name);
+		return -1;
+	}
+	free(fs3_cur->lease_name);
+	fs3_cur->lease_name = name ? strdup(name) : NULL;
+	fs3_cur->lease_ns = (uint64_t) lease_ms * 1000000ULL;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_lease_attach
+// Description  : Join the configured domain, taking a free client slot or
+//                one left by a process that died
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_lease_attach(void) {
+	FS3LeaseTable *t;
+	FS3LeaseClient *c;
+	int slot, track;
+
+	if (!fs3_cur->lease_name) return 0;
+	if ((t = lease_open(fs3_cur->lease_name)) == NULL) return -1;
+
+	lease_lock(t);
+	for (slot = 0; slot < FS3_LEASE_CLIENTS; slot++) {
+		c = &t->clients[slot];
+		if (c->pid && (kill(c->pid, 0) == -1) && (errno == ESRCH)) {
+			c->pid = 0;
+			t->users--;
+		}
+		if (c->pid == 0) break;
+	}
+	if (slot == FS3_LEASE_CLIENTS) {
+		pthread_mutex_unlock(&t->lock);
+		logMessage(LOG_ERROR_LEVEL, "Lease domain [%s] has no free client slot", fs3_cur->lease_name);
+		munmap(t, sizeof(FS3LeaseTable));
+		return -1;
+	}
+	memset(c, 0x0, sizeof(FS3LeaseClient));
+	c->pid = getpid();
+	t->users++;
+	pthread_mutex_unlock(&t->lock);
+
+	// whatever was cached before joining is unprotected
+	for (track = 0; track < FS3_MAX_TRACKS; track++) {
+		fs3_cur->lease_epoch[track]++;
+		fs3_cur->lease_since[track] = fs3_metrics_now();
+		fs3_cur->lease_until[track] = 0;
+	}
+	fs3_cur->leases = t;
+	fs3_cur->lease_slot = slot;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_lease_detach
+// Description  : Give up the client slot and unmap the domain, removing it
+//                when the last client leaves
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_lease_detach(void) {
+	FS3LeaseTable *t = fs3_cur->leases;
+	uint32_t users;
+
+	if (!t) return 0;
+	lease_lock(t);
+	memset(t->clients[fs3_cur->lease_slot].expiry, 0x0, sizeof(t->clients[0].expiry));
+	t->clients[fs3_cur->lease_slot].pid = 0;
+	users = --t->users;
+	pthread_mutex_unlock(&t->lock);
+	if (users == 0) {
+		shm_unlink(fs3_cur->lease_name);
+	}
+	munmap(t, sizeof(FS3LeaseTable));
+	fs3_cur->leases = NULL;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_lease_request
+// Description  : Take or renew the lease on the current track as a read or
+//                write is sent.  The lease must be visible before the
+//                controller answers, so a write that lands after this read
+//                is sure to invalidate what it returns.
+//
+// Inputs       : opcode - the request
+// Outputs      : none
+
+void fs3_lease_request(int opcode) {
+	int track = fs3_cur->on_track;
+	uint64_t now;
+
+	if (((opcode != FS3_OP_RDSECT) && (opcode != FS3_OP_WRSECT)) || (track >= FS3_MAX_TRACKS)) return;
+	now = fs3_metrics_now();
+	if (fs3_cur->lease_until[track] <= now) {
+		fs3_cur->lease_epoch[track]++;
+		fs3_cur->lease_since[track] = now;
+		fs3_cur->lease_grants++;
+	} else {
+		fs3_cur->lease_renewals++;
+	}
+	fs3_cur->lease_until[track] = now + fs3_cur->lease_ns;
+	__atomic_store_n(&fs3_cur->leases->clients[fs3_cur->lease_slot].expiry[track],
+		fs3_cur->lease_until[track], __ATOMIC_SEQ_CST);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_lease_reply
+// Description  : Post an invalidation of a sector just written to every
+//                other client holding a lease on its track; a client whose
+//                inbox is full is told to drop everything instead
+//
+// Inputs       : opcode - the request answered
+//                sector - the sector it was for
+// Outputs      : none
+
+void fs3_lease_reply(int opcode, int sector) {
+	FS3LeaseTable *t = fs3_cur->leases;
+	int track = fs3_cur->on_track, slot;
+	uint64_t now;
+	FS3LeaseClient *c;
+
+	if ((opcode != FS3_OP_WRSECT) || (track >= FS3_MAX_TRACKS)) return;
+	now = fs3_metrics_now();
+	lease_lock(t);
+	for (slot = 0; slot < FS3_LEASE_CLIENTS; slot++) {
+		c = &t->clients[slot];
+		if ((slot == fs3_cur->lease_slot) || !c->pid ||
+			(__atomic_load_n(&c->expiry[track], __ATOMIC_SEQ_CST) <= now)) {
+			continue;
+		}
+		if (c->head - __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE) >= FS3_LEASE_INBOX) {
+			__atomic_store_n(&c->overflowed, 1, __ATOMIC_RELEASE);
+		} else {
+			c->inbox[c->head % FS3_LEASE_INBOX] = track * FS3_TRACK_SIZE + sector;
+			__atomic_store_n(&c->head, c->head + 1, __ATOMIC_RELEASE);
+		}
+		fs3_cur->lease_sent++;
+	}
+	pthread_mutex_unlock(&t->lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_lease_valid
+// Description  : Check if a cached sector is still covered by a lease
+//
+// Inputs       : track - the track it is on
+//                epoch - the epoch it was cached in
+// Outputs      : 1 if it may be used, 0 if not
+
+int fs3_lease_valid(int track, uint32_t epoch) {
+	if ((epoch == fs3_cur->lease_epoch[track]) && (fs3_cur->lease_until[track] > fs3_metrics_now())) {
+		return 1;
+	}
+	fs3_cur->lease_expired++;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_lease_covers
+// Description  : Check if a sector in the shared cache is covered by a
+//                lease.  Any process may have stored it, so it carries the
+//                time it was stored rather than one of our epochs, and may be
+//                used if that is within the current epoch of the track.
+//
+// Inputs       : track - the track it is on
+//                stored - the fs3_metrics_now() time it was stored
+// Outputs      : 1 if it may be used, 0 if not
+
+int fs3_lease_covers(int track, uint64_t stored) {
+	if ((stored >= fs3_cur->lease_since[track]) && (fs3_cur->lease_until[track] > fs3_metrics_now())) {
+		return 1;
+	}
+	fs3_cur->lease_expired++;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_lease_drain
+// Description  : Drop every sector invalidated since the last drain
+//
+// Inputs       : none
+// Outputs      : none
+
+void fs3_lease_drain(void) {
+	FS3LeaseClient *c = &fs3_cur->leases->clients[fs3_cur->lease_slot];
+	uint64_t head = __atomic_load_n(&c->head, __ATOMIC_ACQUIRE), tail;
+	uint32_t key;
+	int track;
+
+	if (__atomic_exchange_n(&c->overflowed, 0, __ATOMIC_ACQ_REL)) {
+		for (track = 0; track < FS3_MAX_TRACKS; track++) {
+			fs3_cur->lease_epoch[track]++;
+			fs3_cur->lease_since[track] = fs3_metrics_now();
+		}
+		fs3_cur->lease_overflows++;
+	} else {
+		for (tail = c->tail; tail != head; tail++) {
+			key = c->inbox[tail % FS3_LEASE_INBOX];
+			fs3_drop_cache(key / FS3_TRACK_SIZE, key % FS3_TRACK_SIZE);
+			fs3_cur->lease_invals++;
+		}
+	}
+	__atomic_store_n(&c->tail, head, __ATOMIC_RELEASE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_log_lease_metrics
+// Description  : Log the leases taken and invalidations sent and received
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_log_lease_metrics(void) {
+	if (!fs3_cur->lease_name) return 0;
+	logMessage(LOG_OUTPUT_LEVEL, "** FS3 Lease Metrics [%s] **", fs3_cur->lease_name);
+	logMessage(LOG_OUTPUT_LEVEL, "Leases taken     [%9lu]", fs3_cur->lease_grants);
+	logMessage(LOG_OUTPUT_LEVEL, "Leases renewed   [%9lu]", fs3_cur->lease_renewals);
+	logMessage(LOG_OUTPUT_LEVEL, "Lines expired    [%9lu]", fs3_cur->lease_expired);
+	logMessage(LOG_OUTPUT_LEVEL, "Invalidated in   [%9lu]", fs3_cur->lease_invals);
+	logMessage(LOG_OUTPUT_LEVEL, "Invalidated out  [%9lu]", fs3_cur->lease_sent);
+	logMessage(LOG_OUTPUT_LEVEL, "Inbox overflows  [%9lu]", fs3_cur->lease_overflows);
+	return 0;
+}
@@ -0,0 +1,84 @@
+#ifndef FS3_LEASE_INCLUDED
+#define FS3_LEASE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_lease.h
+//  Description    : This is the interface for FS3 cache coherence between
+//                   clients of one disk.  A client in a coherence domain
+//                   caches a track's sectors only while it holds a read
+//                   lease on the track; the lease is taken or renewed by
+//                   every read or write request sent for the track and runs
+//                   out after the lease period.  A client that writes a
+//                   sector posts an invalidation to every other client
+//                   holding a lease on its track, which drops the sector
+//                   from its cache at its next cache call.  The controller
+//                   protocol has no room for leases, so the domain's lease
+//                   table and invalidation inboxes are kept in a POSIX
+//                   shared-memory segment standing in for the controller.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <fs3_controller.h>
+
+// Defines
+#define FS3_LEASE_MAGIC 0x53454c33          // "3LES"
+#define FS3_LEASE_CLIENTS 32                // Clients per domain
+#define FS3_LEASE_INBOX 1024                // Invalidations a client may have waiting
+
+// This is one client's lease and invalidation state in the domain
+typedef struct {
+	pid_t pid;                              // Process of the client, 0 if the slot is free
+	uint32_t overflowed;                    // Invalidations were lost, drop the whole cache
+	uint64_t expiry[FS3_MAX_TRACKS];        // When its lease on each track runs out (ns), 0 none
+	uint64_t head;                          // Invalidations posted, under the domain lock
+	uint64_t tail;                          // Invalidations handled, by the client only
+	uint32_t inbox[FS3_LEASE_INBOX];        // track * FS3_TRACK_SIZE + sector
+} FS3LeaseClient;
+
+// This is the segment of a domain
+typedef struct {
+	uint32_t magic;                         // Set last by the creator
+	uint32_t users;                         // Clients attached, under lock
+	pthread_mutex_t lock;                   // Robust, process shared
+	FS3LeaseClient clients[FS3_LEASE_CLIENTS];
+} FS3LeaseTable;
+
+//
+// Lease Functions
+
+int fs3_lease_configure(const char *name, uint32_t lease_ms);
+	// Join coherence domain name ("/name") at the next mount, with leases
+	// of lease_ms; NULL to cache without leases
+
+int fs3_log_lease_metrics(void);
+	// Log the leases taken and invalidations sent and received
+
+int fs3_lease_attach(void);
+	// Join the configured domain at mount
+
+int fs3_lease_detach(void);
+	// Leave the domain at unmount, removing it if no client is left
+
+void fs3_lease_request(int opcode);
+	// Take or renew the lease on the current track before a request
+
+void fs3_lease_reply(int opcode, int sector);
+	// Invalidate a written sector in the other clients after the reply
+
+int fs3_lease_valid(int track, uint32_t epoch);
+	// Nonzero if a sector cached in epoch may still be used
+
+int fs3_lease_covers(int track, uint64_t stored);
+	// Nonzero if a sector stored in the shared cache at this time may still be used
+
+void fs3_lease_drain(void);
+	// Drop the sectors other clients have invalidated
+
+#endif
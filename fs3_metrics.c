@@ -0,0 +1,318 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_metrics.c
+//  Description    : This is the implementation of the latency histograms and
+//                   byte counters for the FS3 filesystem.  Histograms are
+//                   log-linear: exact below 16ns, then 16 buckets for every
+//                   power of two, so any percentile is within ~6%.  Each
+//                   volume keeps its own in its context, so volumes running
+//                   side by side never write the same lines; the export
+//                   merges them.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_metrics.h>
+#include <fs3_ctx_pi.h>
+
+//
+// Support Macros/Data
+char *metrics_path = NULL;
+FS3MetricFormats metrics_format = FS3_METRICS_JSON;
+
+static const char *hist_layer[FS3_MET_MAXVAL] = {
+	"driver", "driver", "driver", "driver", "driver",
+	"cache", "cache",
+	"network", "network", "network", "network", "network"
+};
+static const char *hist_op[FS3_MET_MAXVAL] = {
+	"open", "read", "write", "seek", "track_seek",
+	"get", "put",
+	"mount", "tseek", "rdsect", "wrsect", "umount"
+};
+static const char *cnt_layer[FS3_CNT_MAXVAL] = { "driver", "driver", "network", "network", "wal", "advise" };
+static const char *cnt_op[FS3_CNT_MAXVAL] = { "read", "write", "sent", "received", "write", "prefetch" };
+
+//
+// Implementation
+
+static inline int bucket_index(uint64_t v) {
+	int e;
+	if (v < FS3_HIST_SUB_COUNT) return (int) v;
+	e = 63 - __builtin_clzll(v);
+	return (e - FS3_HIST_SUB_BITS + 1) * FS3_HIST_SUB_COUNT +
+		   (int) ((v >> (e - FS3_HIST_SUB_BITS)) & (FS3_HIST_SUB_COUNT - 1));
+}
+
+static uint64_t bucket_value(int idx) {
+	int e, m;
+	uint64_t width;
+	if (idx < FS3_HIST_SUB_COUNT) return idx;
+	e = idx / FS3_HIST_SUB_COUNT + FS3_HIST_SUB_BITS - 1;
+	m = idx % FS3_HIST_SUB_COUNT;
+	width = 1ULL << (e - FS3_HIST_SUB_BITS);
+	return ((FS3_HIST_SUB_COUNT + m) * width) + width / 2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_metrics_record
+// Description  : Record the latency of an operation that began at start on
+//                the volume; a volume may run on several threads at once
+//                (and is read by the export), so the histogram is updated
+//                with relaxed atomics
+//
+// Inputs       : op - the operation
+//                start - the fs3_metrics_now() value when it began
+// Outputs      : none
+
+void fs3_metrics_record(FS3MetricOps op, uint64_t start) {
+	FS3Histogram *hist = &fs3_cur->metrics.hist[op];
+	uint64_t ns = fs3_metrics_now() - start;
+	uint64_t max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&hist->sum, ns, __ATOMIC_RELAXED);
+	while ((ns > max) && !__atomic_compare_exchange_n(&hist->max, &max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+	__atomic_fetch_add(&hist->buckets[bucket_index(ns)], 1, __ATOMIC_RELAXED);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_metrics_add
+// Description  : Add to a byte counter of the volume
+//
+// Inputs       : cnt - the counter
+//                bytes - the amount to add
+// Outputs      : none
+
+void fs3_metrics_add(FS3MetricCounters cnt, uint64_t bytes) {
+	__atomic_fetch_add(&fs3_cur->metrics.counters[cnt], bytes, __ATOMIC_RELAXED);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : hist_percentile
+// Description  : Get the latency at a percentile of a histogram
+//
+// Inputs       : hist - the histogram
+//                pct - the percentile, 0-100
+// Outputs      : latency in nanoseconds (0 if no samples)
+
+static uint64_t hist_percentile(const FS3Histogram *hist, double pct) {
+	uint64_t rank, seen = 0, val;
+	int idx;
+
+	if (hist->count == 0) return 0;
+	rank = (uint64_t) (pct / 100.0 * hist->count);
+	rank = rank ? rank : 1;
+	for (idx = 0; idx < FS3_HIST_BUCKETS; idx++) {
+		seen += hist->buckets[idx];
+		if (seen >= rank) {
+			val = bucket_value(idx);
+			return val < hist->max ? val : hist->max;
+		}
+	}
+	return hist->max;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_metrics_percentile
+// Description  : Get the latency at a percentile of an operation on the volume
+//
+// Inputs       : op - the operation
+//                pct - the percentile, 0-100
+// Outputs      : latency in nanoseconds (0 if no samples)
+
+uint64_t fs3_metrics_percentile(FS3MetricOps op, double pct) {
+	return hist_percentile(&fs3_cur->metrics.hist[op], pct);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_metrics_count
+// Description  : Get the number of times an operation was recorded on the
+//                volume
+//
+// Inputs       : op - the operation
+// Outputs      : the count
+
+uint64_t fs3_metrics_count(FS3MetricOps op) {
+	return __atomic_load_n(&fs3_cur->metrics.hist[op].count, __ATOMIC_RELAXED);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_metrics_reset
+// Description  : Clear the histograms and counters of the volume
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_metrics_reset(void) {
+	memset(&fs3_cur->metrics, 0x0, sizeof(FS3Metrics));
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : merge_metrics
+// Description  : Add the metrics of one volume into a total; the volume may
+//                still be running, so its lines are read atomically
+//
+// Inputs       : total - the merged metrics
+//                met - the volume's metrics
+// Outputs      : none
+
+static void merge_metrics(FS3Metrics *total, FS3Metrics *met) {
+	uint64_t max;
+	int i, b;
+
+	for (i = 0; i < FS3_MET_MAXVAL; i++) {
+		total->hist[i].count += __atomic_load_n(&met->hist[i].count, __ATOMIC_RELAXED);
+		total->hist[i].sum += __atomic_load_n(&met->hist[i].sum, __ATOMIC_RELAXED);
+		max = __atomic_load_n(&met->hist[i].max, __ATOMIC_RELAXED);
+		if (max > total->hist[i].max) total->hist[i].max = max;
+		for (b = 0; b < FS3_HIST_BUCKETS; b++) {
+			total->hist[i].buckets[b] += __atomic_load_n(&met->hist[i].buckets[b], __ATOMIC_RELAXED);
+		}
+	}
+	for (i = 0; i < FS3_CNT_MAXVAL; i++) {
+		total->counters[i] += __atomic_load_n(&met->counters[i], __ATOMIC_RELAXED);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_metrics_configure
+// Description  : Set the file metrics are exported to
+//
+// Inputs       : path - the export file, NULL to disable export
+//                format - JSON or Prometheus text
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_metrics_configure(const char *path, FS3MetricFormats format) {
+	free(metrics_path);
+	metrics_path = path ? strdup(path) : NULL;
+	metrics_format = format;
+	return 0;
+}
+
+static void export_json(FILE *fh, const FS3Metrics *met) {
+	int i;
+	fprintf(fh, "{\n  \"latency_ns\": {\n");
+	for (i = 0; i < FS3_MET_MAXVAL; i++) {
+		fprintf(fh, "    \"%s_%s\": {\"count\": %lu, \"sum\": %lu, \"p50\": %lu, "
+			"\"p90\": %lu, \"p99\": %lu, \"p999\": %lu, \"max\": %lu}%s\n",
+			hist_layer[i], hist_op[i], met->hist[i].count, met->hist[i].sum,
+			hist_percentile(&met->hist[i], 50), hist_percentile(&met->hist[i], 90),
+			hist_percentile(&met->hist[i], 99), hist_percentile(&met->hist[i], 99.9),
+			met->hist[i].max, (i < FS3_MET_MAXVAL - 1) ? "," : "");
+	}
+	fprintf(fh, "  },\n  \"bytes\": {\n");
+	for (i = 0; i < FS3_CNT_MAXVAL; i++) {
+		fprintf(fh, "    \"%s_%s\": %lu%s\n", cnt_layer[i], cnt_op[i], met->counters[i],
+			(i < FS3_CNT_MAXVAL - 1) ? "," : "");
+	}
+	fprintf(fh, "  }\n}\n");
+}
+
+static void export_prom(FILE *fh, const FS3Metrics *met) {
+	static const double quantiles[] = { 50, 90, 99, 99.9 };
+	int i, q;
+	fprintf(fh, "# HELP fs3_latency_seconds Latency of FS3 operations.\n");
+	fprintf(fh, "# TYPE fs3_latency_seconds summary\n");
+	for (i = 0; i < FS3_MET_MAXVAL; i++) {
+		for (q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+			fprintf(fh, "fs3_latency_seconds{layer=\"%s\",op=\"%s\",quantile=\"%g\"} %.9f\n",
+				hist_layer[i], hist_op[i], quantiles[q] / 100,
+				hist_percentile(&met->hist[i], quantiles[q]) / 1e9);
+		}
+		fprintf(fh, "fs3_latency_seconds_sum{layer=\"%s\",op=\"%s\"} %.9f\n",
+			hist_layer[i], hist_op[i], met->hist[i].sum / 1e9);
+		fprintf(fh, "fs3_latency_seconds_count{layer=\"%s\",op=\"%s\"} %lu\n",
+			hist_layer[i], hist_op[i], met->hist[i].count);
+	}
+	fprintf(fh, "# HELP fs3_bytes_total Bytes moved by each FS3 layer.\n");
+	fprintf(fh, "# TYPE fs3_bytes_total counter\n");
+	for (i = 0; i < FS3_CNT_MAXVAL; i++) {
+		fprintf(fh, "fs3_bytes_total{layer=\"%s\",op=\"%s\"} %lu\n",
+			cnt_layer[i], cnt_op[i], met->counters[i]);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_metrics_dump
+// Description  : Export the metrics of all volumes, merged, to the
+//                configured file.  The file is replaced atomically so a
+//                scraper never sees a partial dump.
+//
+// Inputs       : none
+// Outputs      : 0 if successful (or nothing configured), -1 if failure
+
+int fs3_metrics_dump(void) {
+	struct fs3_ctx *ctx;
+	FS3Metrics *total;
+	char tmp[256];
+	FILE *fh;
+
+	if (metrics_path == NULL) return 0;
+	if ((total = calloc(1, sizeof(FS3Metrics))) == NULL) {
+		logMessage(LOG_ERROR_LEVEL, "Failed allocating metrics for export");
+		return -1;
+	}
+	pthread_mutex_lock(&fs3_ctx_list_lock);
+	for (ctx = fs3_ctx_list; ctx; ctx = ctx->ctx_next) {
+		merge_metrics(total, &ctx->metrics);
+	}
+	pthread_mutex_unlock(&fs3_ctx_list_lock);
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", metrics_path);
+	if ((fh = fopen(tmp, "w")) == NULL) {
+		logMessage(LOG_ERROR_LEVEL, "Failed opening metrics file [%s]", tmp);
+		free(total);
+		return -1;
+	}
+	if (metrics_format == FS3_METRICS_PROM) {
+		export_prom(fh, total);
+	} else {
+		export_json(fh, total);
+	}
+	fclose(fh);
+	free(total);
+	return rename(tmp, metrics_path);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_log_metrics
+// Description  : Log the latency percentiles and byte counters of the volume
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_log_metrics(void) {
+	FS3Metrics *met = &fs3_cur->metrics;
+	int i;
+	logMessage(LOG_OUTPUT_LEVEL, "** FS3 latency Metrics (ns) **");
+	for (i = 0; i < FS3_MET_MAXVAL; i++) {
+		if (met->hist[i].count == 0) continue;
+		logMessage(LOG_OUTPUT_LEVEL, "%-7s %-10s [%9lu] p50 %9lu p99 %9lu p999 %9lu",
+			hist_layer[i], hist_op[i], met->hist[i].count, fs3_metrics_percentile(i, 50),
+			fs3_metrics_percentile(i, 99), fs3_metrics_percentile(i, 99.9));
+	}
+	for (i = 0; i < FS3_CNT_MAXVAL; i++) {
+		logMessage(LOG_OUTPUT_LEVEL, "%-7s %-10s bytes [%12lu]", cnt_layer[i], cnt_op[i], met->counters[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,112 @@
+#ifndef FS3_METRICS_INCLUDED
+#define FS3_METRICS_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_metrics.h
+//  Description    : This is the interface for the latency histograms and
+//                   byte counters kept by the FS3 driver, cache and network
+//                   layers.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include
+#include <stdint.h>
+#include <time.h>
+
+// Defines
+#define FS3_HIST_SUB_BITS 4                             // 16 sub-buckets per power of two
+#define FS3_HIST_SUB_COUNT (1 << FS3_HIST_SUB_BITS)
+#define FS3_HIST_BUCKETS ((64 - FS3_HIST_SUB_BITS + 1) * FS3_HIST_SUB_COUNT)
+
+// These are the timed operations, by layer
+typedef enum {
+
+	FS3_MET_DRIVER_OPEN   = 0,   // fs3_open
+	FS3_MET_DRIVER_READ   = 1,   // fs3_read
+	FS3_MET_DRIVER_WRITE  = 2,   // fs3_write
+	FS3_MET_DRIVER_SEEK   = 3,   // fs3_seek
+	FS3_MET_DRIVER_TRACK  = 4,   // fix_track head movement
+	FS3_MET_CACHE_GET     = 5,   // fs3_get_cache
+	FS3_MET_CACHE_PUT     = 6,   // fs3_put_cache
+	FS3_MET_NET_MOUNT     = 7,   // MOUNT round trip
+	FS3_MET_NET_TSEEK     = 8,   // TSEEK round trip
+	FS3_MET_NET_RDSECT    = 9,   // RDSECT round trip
+	FS3_MET_NET_WRSECT    = 10,  // WRSECT round trip
+	FS3_MET_NET_UMOUNT    = 11,  // UMOUNT round trip
+	FS3_MET_MAXVAL        = 12   // Number of histograms
+
+} FS3MetricOps;
+
+// These are the byte counters
+typedef enum {
+
+	FS3_CNT_DRIVER_READ   = 0,   // Bytes returned by fs3_read
+	FS3_CNT_DRIVER_WRITE  = 1,   // Bytes accepted by fs3_write
+	FS3_CNT_NET_SENT      = 2,   // Bytes sent to the controller
+	FS3_CNT_NET_RECV      = 3,   // Bytes received from the controller
+	FS3_CNT_WAL_WRITE     = 4,   // Bytes written to the metadata log and checkpoints
+	FS3_CNT_PREFETCH      = 5,   // Bytes read ahead by fs3_advise prefetch
+	FS3_CNT_MAXVAL        = 6    // Number of counters
+
+} FS3MetricCounters;
+
+// These are the export formats
+typedef enum {
+
+	FS3_METRICS_JSON = 0,        // One JSON document
+	FS3_METRICS_PROM = 1         // Prometheus text exposition format
+
+} FS3MetricFormats;
+
+// This is a log-linear (HDR-style) latency histogram in nanoseconds
+typedef struct {
+	uint64_t count;                       // Number of samples
+	uint64_t sum;                         // Sum of all samples
+	uint64_t max;                         // Largest sample
+	uint64_t buckets[FS3_HIST_BUCKETS];   // Sample counts per bucket
+} FS3Histogram;
+
+// These are the metrics of one volume, kept in its context
+typedef struct {
+	FS3Histogram hist[FS3_MET_MAXVAL];    // Latency per operation
+	uint64_t counters[FS3_CNT_MAXVAL];    // Bytes per counter
+} FS3Metrics;
+
+//
+// Metrics Functions
+
+static inline uint64_t fs3_metrics_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+	// Monotonic timestamp in nanoseconds
+
+void fs3_metrics_record(FS3MetricOps op, uint64_t start);
+	// Record the latency of an operation that began at start
+
+void fs3_metrics_add(FS3MetricCounters cnt, uint64_t bytes);
+	// Add to a byte counter
+
+uint64_t fs3_metrics_percentile(FS3MetricOps op, double pct);
+	// Get the latency (ns) at a percentile (0-100) of an operation on the volume
+
+uint64_t fs3_metrics_count(FS3MetricOps op);
+	// Get the number of times an operation was recorded on the volume
+
+int fs3_metrics_reset(void);
+	// Clear the histograms and counters of the volume
+
+int fs3_metrics_configure(const char *path, FS3MetricFormats format);
+	// Set the file (and format) metrics are exported to
+
+int fs3_metrics_dump(void);
+	// Export the metrics of all volumes, merged, to the configured file, if any
+
+int fs3_log_metrics(void);
+	// Log the latency percentiles and byte counters of the volume
+
+#endif
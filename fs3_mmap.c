@@ -0,0 +1,444 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_mmap.c
+//  Description    : This is the implementation of memory-mapped access to
+//                   FS3 files.  A mapping reserves anonymous address space
+//                   registered with userfaultfd; a handler thread per mapping
+//                   fills missing pages through the driver (so from the
+//                   sector cache or the controller) in 4-sector pages, with
+//                   a readahead window that doubles on sequential faults.
+//                   When the kernel supports write-protect faults, pages are
+//                   filled read-only and only pages actually written are
+//                   written back at unmap; otherwise every filled page is.
+//                   Unmounting the disk writes its mappings back and
+//                   detaches them from the files.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/userfaultfd.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_driver.h>
+#include <fs3_driver_pi.h>
+#include <fs3_ctx_pi.h>
+
+//
+// Defines
+#define FS3_MMAP_PAGE_SIZE (FS3_MMAP_PAGE_SECTORS * FS3_SECTOR_SIZE)
+#define FS3_MMAP_MAX_READAHEAD 16     // Pages filled by one fault, at most
+
+// This is a live mapping
+struct Mapping {
+	char *addr;                   // Start of the reserved address space
+	struct fs3_ctx *ctx;          // The volume of the file
+	struct File *file;            // The mapped file, NULL once its disk is unmounted
+	uint32_t offset;              // File offset of addr
+	uint32_t length;              // Bytes mapped
+	uint32_t npages;              // Pages reserved
+	int uffd;                     // The userfaultfd
+	int stop[2];                  // Pipe used to stop the handler
+	int wp;                       // Dirty pages are tracked by write-protect faults
+	int failed;                   // A fill could not read the file, nothing is written back
+	uint8_t *filled;              // Per page, filled by the handler
+	uint8_t *dirty;               // Per page, written since it was filled
+	char *buf;                    // Readahead buffer
+	uint32_t last_fault;          // Page of the last missing fault
+	uint32_t window;              // Current readahead window in pages
+	pthread_t handler;            // The fault handler thread
+	struct Mapping *next;
+};
+
+//
+// Implementation
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fill_pages
+// Description  : Read pages of a mapping through the driver and install them
+//
+// Inputs       : map - the mapping
+//                page - first page to fill
+//                count - number of pages to fill
+//                writable - install writable (the fault was a write)
+// Outputs      : 0 if successful, -1 if failure
+
+int fill_pages(struct Mapping *map, uint32_t page, uint32_t count, int writable) {
+	char *buf = map->buf;
+	struct uffdio_copy copy;
+	struct File *fptr = map->file;
+	uint32_t i, len;
+	int loc;
+
+	// Read the pages at their file offset, leaving the file position alone
+	len = count * FS3_MMAP_PAGE_SIZE;
+	if (page * FS3_MMAP_PAGE_SIZE + len > map->length) {
+		len = map->length - page * FS3_MMAP_PAGE_SIZE;
+	}
+	memset(buf, 0x0, count * FS3_MMAP_PAGE_SIZE);
+	lock_volume();
+	loc = fptr->loc;
+	fptr->loc = map->offset + page * FS3_MMAP_PAGE_SIZE;
+	if (read_file(fptr, buf, len) == -1) {
+		// the pages go in as zeros so the fault does not wait forever,
+		// and must not overwrite the file at unmap
+		logMessage(LOG_ERROR_LEVEL, "fs3_mmap failed reading page %u of [%s]", page, fptr->name);
+		memset(buf, 0x0, len);
+		map->failed = 1;
+	}
+	fptr->loc = loc;
+	pthread_mutex_unlock(&fs3_cur->lock);
+
+	// Install them one at a time, a page may already be there
+	for (i = 0; i < count; i++) {
+		if (map->filled[page + i]) continue;
+		copy.dst = (uint64_t) (map->addr + (uint64_t) (page + i) * FS3_MMAP_PAGE_SIZE);
+		copy.src = (uint64_t) (buf + i * FS3_MMAP_PAGE_SIZE);
+		copy.len = FS3_MMAP_PAGE_SIZE;
+		copy.mode = (map->wp && !writable) ? UFFDIO_COPY_MODE_WP : 0;
+		copy.copy = 0;
+		if ((ioctl(map->uffd, UFFDIO_COPY, &copy) == -1) && (errno != EEXIST)) {
+			logMessage(LOG_ERROR_LEVEL, "fs3_mmap failed filling page %u: %s", page + i, strerror(errno));
+			return -1;
+		}
+		map->filled[page + i] = 1;
+		map->dirty[page + i] = !map->wp || writable;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fault_handler
+// Description  : Service the page faults of one mapping until told to stop
+//
+// Inputs       : arg - the mapping
+// Outputs      : NULL
+
+void *fault_handler(void *arg) {
+	struct Mapping *map = arg;
+	struct uffd_msg msg;
+	struct uffdio_writeprotect wp;
+	struct pollfd fds[2];
+	uint32_t page, count;
+
+	fs3_cur = map->ctx;
+	fds[0].fd = map->uffd;
+	fds[0].events = POLLIN;
+	fds[1].fd = map->stop[0];
+	fds[1].events = POLLIN;
+	while (poll(fds, 2, -1) != -1 || errno == EINTR) {
+		if (fds[1].revents) break;
+		if (!(fds[0].revents & POLLIN)) continue;
+		if (read(map->uffd, &msg, sizeof(msg)) != sizeof(msg)) continue;
+		if (msg.event != UFFD_EVENT_PAGEFAULT) continue;
+		page = (msg.arg.pagefault.address - (uint64_t) map->addr) / FS3_MMAP_PAGE_SIZE;
+
+		if (msg.arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WP) {
+			// First write to a filled page, mark it dirty and let the write through
+			map->dirty[page] = 1;
+			wp.range.start = (uint64_t) (map->addr + (uint64_t) page * FS3_MMAP_PAGE_SIZE);
+			wp.range.len = FS3_MMAP_PAGE_SIZE;
+			wp.mode = 0;
+			ioctl(map->uffd, UFFDIO_WRITEPROTECT, &wp);
+			continue;
+		}
+
+		// Missing page, widen the readahead window if the faults are sequential
+		map->window = (page == map->last_fault + 1) ? map->window * 2 : 1;
+		if (map->window > FS3_MMAP_MAX_READAHEAD) map->window = FS3_MMAP_MAX_READAHEAD;
+		map->last_fault = page;
+		count = (page + map->window > map->npages) ? map->npages - page : map->window;
+		fill_pages(map, page, count, (msg.arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WRITE) != 0);
+	}
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_mmap
+// Description  : Map part of a file into memory.  Pages are read on first
+//                touch; writes reach the file at fs3_munmap.
+//
+// Inputs       : fd - the file handle
+//                offset - file offset to map from, a multiple of the page size
+//                length - bytes to map, offset + length must be within the file
+// Outputs      : the mapped address if successful, NULL if failure
+
+void *fs3_mmap(int16_t fd, uint32_t offset, uint32_t length) {
+	struct uffdio_api api;
+	struct uffdio_register reg;
+	struct Mapping *map;
+	struct File *fptr;
+	int ok;
+
+	if (sysconf(_SC_PAGESIZE) != FS3_MMAP_PAGE_SIZE) {
+		logMessage(LOG_ERROR_LEVEL, "fs3_mmap needs a %d byte system page size", FS3_MMAP_PAGE_SIZE);
+		return NULL;
+	}
+	lock_volume();
+	fptr = get_file_by_fd(fd);
+	ok = fptr && fptr->is_open && (length > 0) && (offset % FS3_MMAP_PAGE_SIZE == 0) &&
+		 ((uint64_t) offset + length <= fptr->size);
+	if (ok) {
+		fptr->maps++;
+	}
+	pthread_mutex_unlock(&fs3_cur->lock);
+	if (!ok) {
+		return NULL;
+	}
+
+	if ((map = calloc(1, sizeof(struct Mapping))) == NULL) {
+		logMessage(LOG_ERROR_LEVEL, "fs3_mmap failed allocating a mapping of fd %d", fd);
+		lock_volume();
+		fptr->maps--;
+		pthread_mutex_unlock(&fs3_cur->lock);
+		return NULL;
+	}
+	map->ctx = fs3_cur;
+	map->file = fptr;
+	map->offset = offset;
+	map->length = length;
+	map->npages = (length + FS3_MMAP_PAGE_SIZE - 1) / FS3_MMAP_PAGE_SIZE;
+	map->filled = calloc(map->npages, 1);
+	map->dirty = calloc(map->npages, 1);
+	map->buf = malloc(FS3_MMAP_MAX_READAHEAD * FS3_MMAP_PAGE_SIZE);
+	map->last_fault = map->npages;
+	map->uffd = map->stop[0] = map->stop[1] = -1;
+	if (!map->filled || !map->dirty || !map->buf) {
+		goto fail;
+	}
+	map->addr = mmap(NULL, (size_t) map->npages * FS3_MMAP_PAGE_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map->addr == MAP_FAILED) {
+		map->addr = NULL;
+		goto fail;
+	}
+
+	// Ask for write-protect faults, but make do without them
+	// (unprivileged processes may only be allowed user-mode faults)
+	if (((map->uffd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK)) == -1) &&
+		((map->uffd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY)) == -1)) {
+		logMessage(LOG_ERROR_LEVEL, "fs3_mmap userfaultfd failed: %s", strerror(errno));
+		goto fail;
+	}
+	api.api = UFFD_API;
+	api.features = 0;
+	if (ioctl(map->uffd, UFFDIO_API, &api) == -1) {
+		goto fail;
+	}
+	map->wp = (api.features & UFFD_FEATURE_PAGEFAULT_FLAG_WP) != 0;
+	reg.range.start = (uint64_t) map->addr;
+	reg.range.len = (uint64_t) map->npages * FS3_MMAP_PAGE_SIZE;
+	reg.mode = UFFDIO_REGISTER_MODE_MISSING | (map->wp ? UFFDIO_REGISTER_MODE_WP : 0);
+	if (ioctl(map->uffd, UFFDIO_REGISTER, &reg) == -1) {
+		if (!map->wp) goto fail;
+		map->wp = 0;
+		reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+		if (ioctl(map->uffd, UFFDIO_REGISTER, &reg) == -1) goto fail;
+	}
+
+	// Start the fault handler
+	if ((pipe(map->stop) == -1) || (pthread_create(&map->handler, NULL, fault_handler, map) != 0)) {
+		goto fail;
+	}
+	pthread_mutex_lock(&fs3_cur->map_lock);
+	map->next = fs3_cur->map_head;
+	fs3_cur->map_head = map;
+	pthread_mutex_unlock(&fs3_cur->map_lock);
+	return map->addr;
+
+fail:
+	logMessage(LOG_ERROR_LEVEL, "fs3_mmap failed mapping fd %d: %s", fd, strerror(errno));
+	if (map->addr) munmap(map->addr, (size_t) map->npages * FS3_MMAP_PAGE_SIZE);
+	if (map->uffd != -1) close(map->uffd);
+	if (map->stop[0] != -1) close(map->stop[0]);
+	if (map->stop[1] != -1) close(map->stop[1]);
+	lock_volume();
+	fptr->maps--;
+	pthread_mutex_unlock(&fs3_cur->lock);
+	free(map->filled);
+	free(map->dirty);
+	free(map->buf);
+	free(map);
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : stop_handler
+// Description  : Stop the fault handler of a mapping; from then on only
+//                filled pages may be touched
+//
+// Inputs       : map - the mapping
+// Outputs      : 0 if successful, -1 if failure
+
+int stop_handler(struct Mapping *map) {
+	int ret = (write(map->stop[1], "", 1) == 1) ? 0 : -1;
+	pthread_join(map->handler, NULL);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : write_back
+// Description  : Write runs of dirty pages of a mapping to its file, leaving
+//                the file position alone (called with the driver lock).
+//                A mapping a fill failed on is not written, its pages may
+//                hold zeros in place of the file.
+//
+// Inputs       : map - the mapping, its handler stopped
+// Outputs      : 0 if successful, -1 if failure
+
+int write_back(struct Mapping *map) {
+	struct File *fptr = map->file;
+	uint32_t page, end;
+	int loc = fptr->loc, ret = 0;
+
+	if (map->failed) {
+		logMessage(LOG_ERROR_LEVEL, "fs3_mmap not writing back [%s], a page could not be read", fptr->name);
+		return -1;
+	}
+	for (page = 0; page < map->npages; page = end) {
+		if (!map->dirty[page]) {
+			end = page + 1;
+			continue;
+		}
+		for (end = page + 1; (end < map->npages) && map->dirty[end]; end++)
+			;
+		fptr->loc = map->offset + page * FS3_MMAP_PAGE_SIZE;
+		if (write_file(fptr, map->addr + (uint64_t) page * FS3_MMAP_PAGE_SIZE,
+			((end == map->npages) ? map->length : end * FS3_MMAP_PAGE_SIZE) - page * FS3_MMAP_PAGE_SIZE) == -1) {
+			ret = -1;
+		}
+	}
+	fptr->loc = loc;
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_mmap_shutdown
+// Description  : Write back the mappings of the volume and detach them from
+//                their files, called at unmount without the driver lock.
+//                The address space stays until fs3_munmap; pages not filled
+//                by then read as zeros, and nothing more reaches the file.
+//
+// Inputs       : none
+// Outputs      : none
+
+void fs3_mmap_shutdown(void) {
+	struct uffdio_range range;
+	struct Mapping *map;
+
+	pthread_mutex_lock(&fs3_cur->map_lock);
+	for (map = fs3_cur->map_head; map; map = map->next) {
+		if (map->file == NULL) continue;
+		stop_handler(map);
+		lock_volume();
+		if (write_back(map) == -1) {
+			logMessage(LOG_ERROR_LEVEL, "fs3_mmap failed writing back [%s] at unmount", map->file->name);
+		}
+		map->file = NULL;
+		pthread_mutex_unlock(&fs3_cur->lock);
+
+		// wakes any thread still waiting on a fault of the mapping
+		range.start = (uint64_t) map->addr;
+		range.len = (uint64_t) map->npages * FS3_MMAP_PAGE_SIZE;
+		ioctl(map->uffd, UFFDIO_UNREGISTER, &range);
+	}
+	pthread_mutex_unlock(&fs3_cur->map_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : release_map
+// Description  : Give back the address space and resources of a mapping
+//                already off its volume's list
+//
+// Inputs       : map - the mapping
+// Outputs      : none
+
+void release_map(struct Mapping *map) {
+	munmap(map->addr, (size_t) map->npages * FS3_MMAP_PAGE_SIZE);
+	close(map->uffd);
+	close(map->stop[0]);
+	close(map->stop[1]);
+	free(map->filled);
+	free(map->dirty);
+	free(map->buf);
+	free(map);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_munmap
+// Description  : Write the dirty pages of a mapping back and unmap it
+//
+// Inputs       : addr - the address returned by fs3_mmap on this volume
+// Outputs      : 0 if successful, -1 if failure (or if the disk was
+//                unmounted first, the mapping is released all the same)
+
+int32_t fs3_munmap(void *addr) {
+	struct Mapping **mptr, *map;
+	int32_t ret = 0;
+
+	pthread_mutex_lock(&fs3_cur->map_lock);
+	for (mptr = &fs3_cur->map_head; *mptr && (*mptr)->addr != addr; mptr = &(*mptr)->next)
+		;
+	if ((map = *mptr) != NULL) {
+		*mptr = map->next;
+	}
+	pthread_mutex_unlock(&fs3_cur->map_lock);
+	if (map == NULL) {
+		return -1;
+	}
+
+	// Write back, unless unmounting already did
+	if (map->file == NULL) {
+		logMessage(LOG_ERROR_LEVEL, "fs3_munmap of a mapping whose disk was unmounted");
+		ret = -1;
+	} else {
+		if (stop_handler(map) == -1) ret = -1;
+		lock_volume();
+		if (write_back(map) == -1) ret = -1;
+		map->file->maps--;
+		pthread_mutex_unlock(&fs3_cur->lock);
+	}
+	release_map(map);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_mmap_close
+// Description  : Release the mappings left on an unmounted volume, called
+//                when its context is destroyed
+//
+// Inputs       : none
+// Outputs      : none
+
+void fs3_mmap_close(void) {
+	struct Mapping *map;
+
+	pthread_mutex_lock(&fs3_cur->map_lock);
+	while ((map = fs3_cur->map_head) != NULL) {
+		fs3_cur->map_head = map->next;
+		if (map->file != NULL) stop_handler(map);
+		release_map(map);
+	}
+	pthread_mutex_unlock(&fs3_cur->map_lock);
+}
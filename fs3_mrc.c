@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_mrc.c
+//  Description    : This is the implementation of the SHARDS miss-ratio
+//                   curve estimator for the FS3 sector cache.  Sampled
+//                   references get a timestamp; a Fenwick tree over the
+//                   timestamps marks the latest reference of each sampled
+//                   sector, so the reuse distance of a reference is the
+//                   number of marks after that sector's previous one.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+
+// Project Includes
+#include <fs3_mrc.h>
+#include <fs3_ctx_pi.h>
+
+//
+// Implementation
+
+static void tree_add(uint32_t t, int v) {
+	for (; t <= FS3_MRC_TIMES; t += t & -t) fs3_cur->mrc_tree[t] += v;
+}
+
+static uint32_t tree_sum(uint32_t t) {
+	uint32_t sum = 0;
+	for (; t > 0; t -= t & -t) sum += fs3_cur->mrc_tree[t];
+	return sum;
+}
+
+static int compare_last(const void *a, const void *b) {
+	uint32_t x = fs3_cur->mrc_last[*(const uint32_t *) a], y = fs3_cur->mrc_last[*(const uint32_t *) b];
+	return (x > y) - (x < y);
+}
+
+static void renumber(void) {
+	uint32_t keys[FS3_MRC_MAX_SAMPLED];
+	uint32_t k, n = 0;
+
+	// Keep the order of the sampled sectors, but pack their timestamps to 1..n
+	for (k = 0; k < FS3_MRC_KEYS; k++) {
+		if (fs3_cur->mrc_last[k]) keys[n++] = k;
+	}
+	qsort(keys, n, sizeof(uint32_t), compare_last);
+	memset(fs3_cur->mrc_tree, 0x0, sizeof(fs3_cur->mrc_tree));
+	for (k = 0; k < n; k++) {
+		fs3_cur->mrc_last[keys[k]] = k + 1;
+		tree_add(k + 1, 1);
+	}
+	fs3_cur->mrc_now = n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_mrc_reset
+// Description  : Forget all sampled references
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_mrc_reset(void) {
+	memset(fs3_cur->mrc_last, 0x0, sizeof(fs3_cur->mrc_last));
+	memset(fs3_cur->mrc_tree, 0x0, sizeof(fs3_cur->mrc_tree));
+	memset(fs3_cur->mrc_hist, 0x0, sizeof(fs3_cur->mrc_hist));
+	fs3_cur->mrc_cold = fs3_cur->mrc_gets = 0;
+	fs3_cur->mrc_now = 0;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_mrc_access
+// Description  : Note a cache reference.  Puts move a sector to the front of
+//                the LRU order just like gets do, so both update recency,
+//                but only gets are counted as hits or misses.
+//
+// Inputs       : trk - the track of the sector
+//                sct - the sector
+//                is_get - 1 for fs3_get_cache, 0 for fs3_put_cache
+// Outputs      : none
+
+void fs3_mrc_access(FS3TrackIndex trk, FS3SectorIndex sct, int is_get) {
+	uint32_t key = (uint32_t) trk * FS3_TRACK_SIZE + sct, dist;
+
+	if ((key >= FS3_MRC_KEYS) || (((key * 2654435761u) >> 22) >= FS3_MRC_THRESHOLD)) return;
+	if (fs3_cur->mrc_now == FS3_MRC_TIMES) renumber();
+
+	if (fs3_cur->mrc_last[key]) {
+		dist = tree_sum(fs3_cur->mrc_now) - tree_sum(fs3_cur->mrc_last[key]);
+		tree_add(fs3_cur->mrc_last[key], -1);
+		if (is_get) {
+			fs3_cur->mrc_hist[dist < FS3_MRC_MAX_SAMPLED ? dist : FS3_MRC_MAX_SAMPLED - 1]++;
+		}
+	} else if (is_get) {
+		fs3_cur->mrc_cold++;
+	}
+	fs3_cur->mrc_gets += is_get ? 1 : 0;
+	fs3_cur->mrc_last[key] = ++fs3_cur->mrc_now;
+	tree_add(fs3_cur->mrc_now, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_mrc_hit_ratio
+// Description  : Predict the hit ratio of an LRU cache.  A sampled get hits
+//                when its scaled reuse distance is below the cache size.
+//
+// Inputs       : cachelines - the cache size in sectors
+// Outputs      : predicted hit ratio (0-1), -1 if nothing has been sampled
+
+double fs3_mrc_hit_ratio(uint32_t cachelines) {
+	uint64_t hits = 0, limit;
+	uint32_t d;
+
+	if (fs3_cur->mrc_gets == 0) return -1;
+	limit = ((uint64_t) cachelines * FS3_MRC_THRESHOLD + FS3_MRC_MODULUS - 1) / FS3_MRC_MODULUS;
+	for (d = 0; (d < limit) && (d < FS3_MRC_MAX_SAMPLED); d++) {
+		hits += fs3_cur->mrc_hist[d];
+	}
+	return (double) hits / fs3_cur->mrc_gets;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_mrc_samples
+// Description  : Get the number of sampled gets behind the estimate
+//
+// Inputs       : none
+// Outputs      : number of sampled gets
+
+uint64_t fs3_mrc_samples(void) {
+	return fs3_cur->mrc_gets;
+}
@@ -0,0 +1,44 @@
+#ifndef FS3_MRC_INCLUDED
+#define FS3_MRC_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_mrc.h
+//  Description    : This is the interface for the miss-ratio curve estimator
+//                   used by the FS3 sector cache.  It follows SHARDS: only
+//                   sectors whose hash falls under a fixed threshold are
+//                   tracked, their LRU reuse distances are measured exactly
+//                   and scaled by the sampling rate, and the distance
+//                   histogram then predicts the hit ratio of any cache size.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include
+#include <stdint.h>
+#include <fs3_controller.h>
+
+// Defines
+#define FS3_MRC_KEYS (FS3_MAX_TRACKS * FS3_TRACK_SIZE)    // Every sector on the disk
+#define FS3_MRC_MODULUS 1024                               // Hash space for sampling
+#define FS3_MRC_THRESHOLD 64                               // Sample 64/1024 = 6.25% of sectors
+#define FS3_MRC_MAX_SAMPLED (FS3_MRC_KEYS / FS3_MRC_MODULUS * FS3_MRC_THRESHOLD * 2)
+#define FS3_MRC_TIMES (FS3_MRC_MAX_SAMPLED * 2)            // Timestamps before renumbering
+
+//
+// Estimator Functions
+
+int fs3_mrc_reset(void);
+	// Forget all sampled references
+
+void fs3_mrc_access(FS3TrackIndex trk, FS3SectorIndex sct, int is_get);
+	// Note a cache reference; only gets count towards the hit ratio
+
+double fs3_mrc_hit_ratio(uint32_t cachelines);
+	// Predicted LRU hit ratio (0-1) for a cache of this many lines, -1 if no samples
+
+uint64_t fs3_mrc_samples(void);
+	// Number of sampled gets behind the estimate
+
+#endif
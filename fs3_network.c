@@ -20,6 +20,9 @@
 #include <fs3_network.h>
 #include <fs3_controller.h>
 #include <fs3_driver.h>
+#include <fs3_ctx_pi.h>
+#include <fs3_metrics.h>
+#include <fs3_trace.h>
 #include <cmpsc311_util.h>
 
 //
@@ -27,9 +30,6 @@
 unsigned char     *fs3_network_address = NULL; // Address of FS3 server
 unsigned short     fs3_network_port = 0;       // Port of FS3 serve
 
-int socket_fd;
-struct sockaddr_in caddr;
-
 //
 // Network functions
 
@@ -45,59 +45,75 @@ struct sockaddr_in caddr;
 
 int network_fs3_syscall(FS3CmdBlk cmd, FS3CmdBlk *ret, void *buf)
 {
-    int opcode;
-    deconstruct_cmdBlock(cmd, &opcode, NULL, NULL, NULL);
+    int opcode, sector, track;
+    uint64_t start = fs3_metrics_now();
+    deconstruct_cmdBlock(cmd, &opcode, &sector, &track, NULL);
 
     // connect if mount requested
     if (opcode == FS3_OP_MOUNT) {
-        if ((socket_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+        if ((fs3_cur->socket_fd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
             return -1;
         }
 
-        caddr.sin_family = AF_INET;
-        caddr.sin_port = htons(fs3_network_port? fs3_network_port : FS3_DEFAULT_PORT);
+        fs3_cur->caddr.sin_family = AF_INET;
+        fs3_cur->caddr.sin_port = htons(fs3_cur->port ? fs3_cur->port :
+                                        fs3_network_port ? fs3_network_port : FS3_DEFAULT_PORT);
+        if (fs3_cur->address || fs3_network_address) {
+            inet_aton(fs3_cur->address ? fs3_cur->address : (char *) fs3_network_address,
+                      &fs3_cur->caddr.sin_addr);
+        }
 
-        if (connect(socket_fd, (struct sockaddr*)&caddr, sizeof(caddr)) == -1) {
-            close(socket_fd);
+        if (connect(fs3_cur->socket_fd, (struct sockaddr*)&fs3_cur->caddr, sizeof(fs3_cur->caddr)) == -1) {
+            close(fs3_cur->socket_fd);
             return -1;
         }
     }
 
-    // write cmd
+    // write cmd, trace events are laid out in opcode order too
+    FS3_TRACE(FS3_TR_NET_MOUNT + opcode, FS3_TR_BEGIN, track, sector, 0);
     FS3CmdBlk network_cmd = htonll64(cmd);
-    if (write(socket_fd, &network_cmd, sizeof(FS3CmdBlk)) != sizeof(FS3CmdBlk)) {
-        close(socket_fd);
+    if (write(fs3_cur->socket_fd, &network_cmd, sizeof(FS3CmdBlk)) != sizeof(FS3CmdBlk)) {
+        close(fs3_cur->socket_fd);
         return -1;
     }
 
     // write buffer
     if (opcode == FS3_OP_WRSECT) {
-        if (write(socket_fd, buf, FS3_SECTOR_SIZE) != FS3_SECTOR_SIZE) {
-            close(socket_fd);
+        if (write(fs3_cur->socket_fd, buf, FS3_SECTOR_SIZE) != FS3_SECTOR_SIZE) {
+            close(fs3_cur->socket_fd);
             return -1;
         }
     }
 
     // read cmd
-    if (read(socket_fd, &network_cmd, sizeof(FS3CmdBlk)) != sizeof(FS3CmdBlk)) {
-        close(socket_fd);
+    if (read(fs3_cur->socket_fd, &network_cmd, sizeof(FS3CmdBlk)) != sizeof(FS3CmdBlk)) {
+        close(fs3_cur->socket_fd);
         return -1;
     }
     *ret = ntohll64(network_cmd);
+    if (fs3_trace_enabled) {
+        int retcode;
+        deconstruct_cmdBlock(*ret, NULL, NULL, NULL, &retcode);
+        FS3_TRACE(FS3_TR_NET_MOUNT + opcode, FS3_TR_END, track, sector, retcode);
+    }
 
     // read buffer
     if (opcode == FS3_OP_RDSECT) {
-        if (read(socket_fd, buf, FS3_SECTOR_SIZE) != FS3_SECTOR_SIZE) {
-            close(socket_fd);
+        if (read(fs3_cur->socket_fd, buf, FS3_SECTOR_SIZE) != FS3_SECTOR_SIZE) {
+            close(fs3_cur->socket_fd);
             return -1;
         }
     }
 
     // disconnect if unmount requested
     if (opcode == FS3_OP_UMOUNT) {
-        close(socket_fd);
+        close(fs3_cur->socket_fd);
     }
 
+    // network histograms are laid out in opcode order
+    fs3_metrics_add(FS3_CNT_NET_SENT, sizeof(FS3CmdBlk) + (opcode == FS3_OP_WRSECT ? FS3_SECTOR_SIZE : 0));
+    fs3_metrics_add(FS3_CNT_NET_RECV, sizeof(FS3CmdBlk) + (opcode == FS3_OP_RDSECT ? FS3_SECTOR_SIZE : 0));
+    fs3_metrics_record(FS3_MET_NET_MOUNT + opcode, start);
     return 0;
 }
 
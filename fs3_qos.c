@@ -0,0 +1,405 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_qos.c
+//  Description    : This is the implementation of FS3 I/O classes.  Waiting
+//                   requests are tagged with a virtual finish time (self-
+//                   clocked fair queuing: the tag of the last request of the
+//                   class, or the tag in service if later, plus its sectors
+//                   over the class weight) and admitted one at a time in tag
+//                   order, skipping classes whose token bucket is empty.
+//                   Delayed writes past the dirty limit are placed by a
+//                   writeback thread, a chunk at a time, each chunk
+//                   admitted as a request of the class of its file.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_driver.h>
+#include <fs3_driver_pi.h>
+#include <fs3_ctx_pi.h>
+#include <fs3_metrics.h>
+#include <fs3_qos.h>
+
+//
+// Defines
+#define FS3_QOS_BURST_NS 100000000ULL   // Bucket depth, 100 ms of the rate
+#define FS3_QOS_SCALE 1024              // Virtual time of one sector at weight 1
+
+//
+// Implementation
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : refill
+// Description  : Add the tokens a class earned since it was last filled
+//
+// Inputs       : c - the class
+//                now - the time (ns)
+// Outputs      : none
+
+void refill(FS3QosClass *c, uint64_t now) {
+	double secs = (now - c->refilled) / 1e9, depth;
+
+	if (c->iops) {
+		depth = c->iops * (FS3_QOS_BURST_NS / 1e9);
+		depth = (depth < FS3_QOS_CHUNK / FS3_SECTOR_SIZE) ? FS3_QOS_CHUNK / FS3_SECTOR_SIZE : depth;
+		c->op_tokens += secs * c->iops;
+		c->op_tokens = (c->op_tokens > depth) ? depth : c->op_tokens;
+	}
+	if (c->kbps) {
+		depth = c->kbps * 1024.0 * (FS3_QOS_BURST_NS / 1e9);
+		depth = (depth < FS3_QOS_CHUNK) ? FS3_QOS_CHUNK : depth;
+		c->byte_tokens += secs * c->kbps * 1024.0;
+		c->byte_tokens = (c->byte_tokens > depth) ? depth : c->byte_tokens;
+	}
+	c->refilled = now;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : tokens_wait
+// Description  : How long until a class has tokens in both buckets
+//
+// Inputs       : c - the class, just refilled
+// Outputs      : 0 if it may be admitted now, else nanoseconds to wait
+
+uint64_t tokens_wait(FS3QosClass *c) {
+	uint64_t ops = 0, bytes = 0;
+
+	if (c->iops && (c->op_tokens <= 0)) {
+		ops = (uint64_t) ((1e-3 - c->op_tokens) * 1e9 / c->iops) + 1;
+	}
+	if (c->kbps && (c->byte_tokens <= 0)) {
+		bytes = (uint64_t) ((1 - c->byte_tokens) * 1e9 / (c->kbps * 1024.0)) + 1;
+	}
+	return (ops > bytes) ? ops : bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : admit_class
+// Description  : Queue a request of a class and wait until it is the
+//                earliest tagged request whose class has tokens and the
+//                controller is free
+//
+// Inputs       : cls - the class
+//                len - bytes in the request
+// Outputs      : none
+
+void admit_class(int cls, int32_t len) {
+	FS3QosClass *c = &fs3_cur->qos[cls];
+	struct QosRequest req, **pp, *r;
+	uint64_t start = fs3_metrics_now(), now, wait, w;
+	uint32_t sectors = (len + FS3_SECTOR_SIZE - 1) / FS3_SECTOR_SIZE;
+	struct timespec until;
+
+	pthread_mutex_lock(&fs3_cur->qos_lock);
+
+	// tag the request and queue it in tag order
+	sectors = sectors ? sectors : 1;
+	req.cls = cls;
+	req.tag = (c->finish > fs3_cur->qos_vtime) ? c->finish : fs3_cur->qos_vtime;
+	req.tag += (uint64_t) sectors * FS3_QOS_SCALE / (c->weight ? c->weight : 1);
+	c->finish = req.tag;
+	for (pp = &fs3_cur->qos_queue; *pp && ((*pp)->tag <= req.tag); pp = &(*pp)->next);
+	req.next = *pp;
+	*pp = &req;
+
+	for (;;) {
+		wait = 0;
+		r = NULL;
+		if (!fs3_cur->qos_busy) {
+			now = fs3_metrics_now();
+			for (r = fs3_cur->qos_queue; r; r = r->next) {
+				refill(&fs3_cur->qos[r->cls], now);
+				if ((w = tokens_wait(&fs3_cur->qos[r->cls])) == 0) break;
+				wait = (!wait || (w < wait)) ? w : wait;
+			}
+			if (r == &req) break;
+		}
+
+		// an earlier request may have become eligible while it slept,
+		// wake it; if every class is out of tokens sleep until one refills
+		if (r) {
+			pthread_cond_broadcast(&fs3_cur->qos_cond);
+			pthread_cond_wait(&fs3_cur->qos_cond, &fs3_cur->qos_lock);
+		} else if (wait) {
+			clock_gettime(CLOCK_REALTIME, &until);
+			until.tv_sec += (until.tv_nsec + wait) / 1000000000ULL;
+			until.tv_nsec = (until.tv_nsec + wait) % 1000000000ULL;
+			pthread_cond_timedwait(&fs3_cur->qos_cond, &fs3_cur->qos_lock, &until);
+		} else {
+			pthread_cond_wait(&fs3_cur->qos_cond, &fs3_cur->qos_lock);
+		}
+	}
+
+	// the request is in service, virtual time is its tag
+	for (pp = &fs3_cur->qos_queue; *pp != &req; pp = &(*pp)->next);
+	*pp = req.next;
+	fs3_cur->qos_busy = 1;
+	fs3_cur->qos_vtime = req.tag;
+	c->op_tokens -= sectors;
+	c->byte_tokens -= len;
+	c->requests++;
+	c->bytes += len;
+	wait = fs3_metrics_now() - start;
+	c->waited += wait;
+	c->max_wait = (wait > c->max_wait) ? wait : c->max_wait;
+	pthread_mutex_unlock(&fs3_cur->qos_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : class_of
+// Description  : Get the class of an open file
+//
+// Inputs       : fd - the file descriptor
+// Outputs      : the class, 0 for a bad descriptor (the call fails later)
+
+int class_of(int16_t fd) {
+	struct File *fptr;
+	int cls = 0;
+
+	lock_volume();
+	fptr = get_file_by_fd(fd);
+	if (fptr && fptr->is_open) {
+		cls = fptr->qos_class;
+	}
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return cls;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_qos_admit
+// Description  : Wait for a file's turn at the controller
+//
+// Inputs       : fd - the file descriptor
+//                len - bytes to transfer
+// Outputs      : 1 if admitted, 0 if QoS is not configured
+
+int fs3_qos_admit(int16_t fd, int32_t len) {
+	if (!fs3_cur->qos_on) return 0;
+	admit_class(class_of(fd), len < 0 ? 0 : len);
+	return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_qos_done
+// Description  : End an admitted transfer and let the next one in
+//
+// Inputs       : none
+// Outputs      : none
+
+void fs3_qos_done(void) {
+	pthread_mutex_lock(&fs3_cur->qos_lock);
+	fs3_cur->qos_busy = 0;
+	pthread_cond_broadcast(&fs3_cur->qos_cond);
+	pthread_mutex_unlock(&fs3_cur->qos_lock);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_qos_transfer
+// Description  : Run a read or write as a series of admitted chunks
+//
+// Inputs       : fd - the file descriptor
+//                buf - the data
+//                count - bytes to transfer
+//                io - the unqueued read or write
+// Outputs      : bytes transferred if successful, -1 if failure
+
+int32_t fs3_qos_transfer(int16_t fd, char *buf, int32_t count,
+		int32_t (*io)(int16_t fd, void *buf, int32_t count)) {
+	int32_t done = 0, len, ret;
+	int cls = class_of(fd);
+
+	if (count <= 0) return io(fd, buf, count);
+	while (done < count) {
+		len = (count - done < FS3_QOS_CHUNK) ? count - done : FS3_QOS_CHUNK;
+		admit_class(cls, len);
+		ret = io(fd, buf + done, len);
+		fs3_qos_done();
+		if (ret < 0) return done ? done : -1;
+		done += ret;
+		if (ret < len) break;
+	}
+	return done;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : writeback_thread
+// Description  : Place delayed writes until the volume is back under half
+//                the dirty limit, charging each chunk to the class of the
+//                file it belongs to rather than to the writer that crossed
+//                the limit.  Runs with the driver lock, dropping it while a
+//                chunk waits to be admitted.
+//
+// Inputs       : arg - the volume
+// Outputs      : NULL
+
+void *writeback_thread(void *arg) {
+	struct File *fptr;
+	uint32_t ino;
+	int cls;
+
+	fs3_cur = arg;
+	pthread_mutex_lock(&fs3_cur->lock);
+	while (!fs3_cur->wb_stop) {
+		if (!fs3_cur->dirty_files || fs3_cur->dalloc_full ||
+			(fs3_cur->dirty_sectors <= FS3_DALLOC_MAX_DIRTY / 2)) {
+			pthread_cond_wait(&fs3_cur->wb_cond, &fs3_cur->lock);
+			continue;
+		}
+		ino = fs3_cur->dirty_files->ino;
+		cls = fs3_cur->dirty_files->qos_class;
+		pthread_mutex_unlock(&fs3_cur->lock);
+		admit_class(cls, FS3_QOS_CHUNK);
+		pthread_mutex_lock(&fs3_cur->lock);
+
+		// the file may have been flushed or unlinked while the chunk waited
+		fptr = fs3_cur->ino_table[ino];
+		if (fptr && fptr->is_dirty && (flush_part(fptr, FS3_QOS_CHUNK / FS3_SECTOR_SIZE) == -1)) {
+			fs3_cur->dalloc_full = 1;
+		}
+		fs3_qos_done();
+	}
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : qos_writeback
+// Description  : Wake the writeback thread, starting it the first time
+//                (called with the driver lock once delayed writes pass the
+//                dirty limit)
+//
+// Inputs       : none
+// Outputs      : none
+
+void qos_writeback(void) {
+	if (fs3_cur->wb_stop) return;
+	if (!fs3_cur->wb_running) {
+		if (pthread_create(&fs3_cur->wb_thread, NULL, writeback_thread, fs3_cur) != 0) {
+			logMessage(LOG_ERROR_LEVEL, "fs3_qos could not start the writeback thread, writers place their own files");
+			fs3_cur->wb_stop = 1;
+			return;
+		}
+		fs3_cur->wb_running = 1;
+	}
+	pthread_cond_signal(&fs3_cur->wb_cond);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_qos_shutdown
+// Description  : Stop the writeback thread, called at unmount without the
+//                driver lock; the unmount places what is left
+//
+// Inputs       : none
+// Outputs      : none
+
+void fs3_qos_shutdown(void) {
+	lock_volume();
+	fs3_cur->wb_stop = 1;
+	pthread_cond_broadcast(&fs3_cur->wb_cond);
+	pthread_mutex_unlock(&fs3_cur->lock);
+	if (fs3_cur->wb_running) {
+		pthread_join(fs3_cur->wb_thread, NULL);
+		fs3_cur->wb_running = 0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_qos_configure
+// Description  : Set the weight and limits of a class, starting its buckets
+//                full.  Reads and writes are queued from the first call on.
+//
+// Inputs       : cls - the class
+//                weight - share of the controller when classes compete
+//                iops - sectors per second, 0 unlimited
+//                kbps - KB per second, 0 unlimited
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_qos_configure(int cls, uint32_t weight, uint32_t iops, uint32_t kbps) {
+	FS3QosClass *c;
+
+	if ((cls < 0) || (cls >= FS3_QOS_CLASSES) || (weight == 0)) {
+		logMessage(LOG_ERROR_LEVEL, "fs3_qos_configure bad class %d or weight %u", cls, weight);
+		return -1;
+	}
+	pthread_mutex_lock(&fs3_cur->qos_lock);
+	c = &fs3_cur->qos[cls];
+	c->weight = weight;
+	c->iops = iops;
+	c->kbps = kbps;
+	c->op_tokens = c->byte_tokens = 0;
+	c->refilled = 0;
+	refill(c, fs3_metrics_now());
+	fs3_cur->qos_on = 1;
+	pthread_mutex_unlock(&fs3_cur->qos_lock);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_qos_set
+// Description  : Put an open file in an I/O class
+//
+// Inputs       : fd - the file descriptor
+//                cls - the class
+// Outputs      : 0 if successful, -1 if failure
+
+int32_t fs3_qos_set(int16_t fd, int cls) {
+	struct File *fptr;
+	int32_t ret = -1;
+
+	if ((cls < 0) || (cls >= FS3_QOS_CLASSES)) return -1;
+	lock_volume();
+	fptr = get_file_by_fd(fd);
+	if (fptr && fptr->is_open) {
+		fptr->qos_class = cls;
+		ret = 0;
+	}
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_log_qos_metrics
+// Description  : Log the requests, bytes and admission waits of each class
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_log_qos_metrics(void) {
+	FS3QosClass *c;
+	int cls;
+
+	if (!fs3_cur->qos_on) return 0;
+	logMessage(LOG_OUTPUT_LEVEL, "** FS3 QoS Metrics **");
+	pthread_mutex_lock(&fs3_cur->qos_lock);
+	for (cls = 0; cls < FS3_QOS_CLASSES; cls++) {
+		c = &fs3_cur->qos[cls];
+		if (c->requests == 0) continue;
+		logMessage(LOG_OUTPUT_LEVEL, "Class %d (weight %u, %u iops, %u KB/s) : %9lu requests, %8.2f MB, "
+			"wait mean %8lu ns, max %9lu ns", cls, c->weight ? c->weight : 1, c->iops, c->kbps,
+			c->requests, c->bytes / 1048576.0, c->waited / c->requests, c->max_wait);
+	}
+	pthread_mutex_unlock(&fs3_cur->qos_lock);
+	return 0;
+}
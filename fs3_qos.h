@@ -0,0 +1,71 @@
+#ifndef FS3_QOS_INCLUDED
+#define FS3_QOS_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_qos.h
+//  Description    : This is the interface for FS3 I/O classes.  Each open
+//                   file belongs to a class (0 unless set); reads and writes
+//                   pass a weighted fair queue in front of the controller,
+//                   and a class may be held to an IOPS or bandwidth limit by
+//                   a token bucket.  Long reads and writes are admitted a
+//                   chunk at a time, so one class cannot hold the controller
+//                   for more than a chunk while another is waiting.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include
+#include <stdint.h>
+
+// Defines
+#define FS3_QOS_CLASSES 4                           // I/O classes per volume
+#define FS3_QOS_CHUNK (16 * 1024)                   // Largest transfer admitted at once
+
+// This is the state of one I/O class
+typedef struct {
+	uint32_t weight;        // Share of the controller when classes compete, 0 unset (1)
+	uint32_t iops;          // Sectors per second, 0 unlimited
+	uint32_t kbps;          // KB per second, 0 unlimited
+	double   op_tokens;     // Sector bucket, may go negative after a large request
+	double   byte_tokens;   // Byte bucket, likewise
+	uint64_t refilled;      // When the buckets were last filled (ns)
+	uint64_t finish;        // Virtual finish time of the last request queued
+	uint64_t requests;      // Requests admitted
+	uint64_t bytes;         // Bytes admitted
+	uint64_t waited;        // Total time requests waited to be admitted (ns)
+	uint64_t max_wait;      // Longest wait (ns)
+} FS3QosClass;
+
+// This is a read or write waiting to be admitted
+struct QosRequest {
+	uint64_t tag;               // Virtual finish time
+	int cls;                    // I/O class
+	struct QosRequest *next;    // Next request in tag order
+};
+
+//
+// QoS Functions
+
+int fs3_qos_configure(int cls, uint32_t weight, uint32_t iops, uint32_t kbps);
+	// Set the weight and limits of a class (iops/kbps 0 for unlimited)
+
+int32_t fs3_qos_set(int16_t fd, int cls);
+	// Put an open file in a class, until it is next opened
+
+int fs3_log_qos_metrics(void);
+	// Log the requests, bytes and waits of each class used
+
+int fs3_qos_admit(int16_t fd, int32_t len);
+	// Wait for the file's turn at the controller, 1 if admitted (call
+	// fs3_qos_done after the transfer), 0 if QoS is not configured
+
+void fs3_qos_done(void);
+	// End an admitted transfer
+
+int32_t fs3_qos_transfer(int16_t fd, char *buf, int32_t count,
+		int32_t (*io)(int16_t fd, void *buf, int32_t count));
+	// Run a read or write in admitted chunks of FS3_QOS_CHUNK bytes
+
+#endif
@@ -0,0 +1,494 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_shmcache.c
+//  Description    : This is the shared sector cache of the FS3 filesystem.
+//                   The index and the sectors live in a POSIX shared-memory
+//                   segment, so every process on the host that names the
+//                   same segment shares one warm cache.  Lookups lock one of
+//                   FS3_SHM_STRIPES robust mutexes over the hash buckets;
+//                   replacement is CLOCK under its own lock.  A process that
+//                   dies holding a stripe leaves it to be rebuilt (emptied)
+//                   by the next process to take it, and slots it was filling
+//                   are reclaimed by the clock hand.  Sectors are keyed by
+//                   track and sector only, so the processes sharing a
+//                   segment must be using the same disk.  Each sector has a
+//                   generation, bumped by every write and drop of it; a
+//                   fill (a sector read from the disk after a miss) is
+//                   only stored if the generation is still the one the miss
+//                   saw, so it never overwrites a newer write by another
+//                   process.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_cache.h>
+#include <fs3_cache_pi.h>
+#include <fs3_ctx_pi.h>
+#include <fs3_metrics.h>
+
+//
+// Defines
+#define FS3_SHM_ATTACH_TRIES 1000         // Waits of 1 ms for the creator to finish
+#define SHM_BUCKETS(c) ((uint32_t *) ((c) + 1))
+#define SHM_SLOTS(c) ((struct ShmSlot *) (SHM_BUCKETS(c) + (c)->nbuckets))
+
+//
+// Implementation
+
+static uint32_t shm_bucket(struct ShmCache *c, uint32_t key) {
+	return (key * 2654435761u) & (c->nbuckets - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : recover_stripe
+// Description  : Empty the buckets of a stripe whose holder died, since its
+//                chains or sectors may be half updated, and refuse the fills
+//                pending on them since it may have been writing
+//
+// Inputs       : c - the segment
+//                stripe - the stripe
+// Outputs      : none
+
+void recover_stripe(struct ShmCache *c, int stripe) {
+	struct ShmSlot *slots = SHM_SLOTS(c);
+	uint32_t b, i;
+
+	for (b = stripe; b < c->nbuckets; b += FS3_SHM_STRIPES) {
+		SHM_BUCKETS(c)[b] = 0;
+	}
+	for (i = 0; i < FS3_SHM_KEYS; i++) {
+		if (shm_bucket(c, i + 1) % FS3_SHM_STRIPES == stripe) {
+			c->gens[i]++;
+		}
+	}
+	for (i = 0; i < c->capacity; i++) {
+		if ((slots[i].key != FS3_SHM_FREE) && (slots[i].key != FS3_SHM_RESERVED) &&
+			(shm_bucket(c, slots[i].key) % FS3_SHM_STRIPES == stripe)) {
+			slots[i].key = FS3_SHM_FREE;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : shm_lock
+// Description  : Take a lock of the segment, repairing what a dead holder
+//                may have left behind
+//
+// Inputs       : c - the segment
+//                stripe - the stripe to lock, -1 for the clock lock
+// Outputs      : none
+
+void shm_lock(struct ShmCache *c, int stripe) {
+	pthread_mutex_t *m = (stripe < 0) ? &c->clock_lock : &c->stripes[stripe];
+
+	if (pthread_mutex_lock(m) == EOWNERDEAD) {
+		// the clock hand and user count are always consistent; slots the
+		// dead process reserved are reclaimed as the hand passes them
+		if (stripe >= 0) {
+			recover_stripe(c, stripe);
+		}
+		__atomic_add_fetch(&c->recoveries, 1, __ATOMIC_RELAXED);
+		pthread_mutex_consistent(m);
+		logMessage(LOG_ERROR_LEVEL, "Shared cache recovered a lock left by a dead process");
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : find_slot_locked
+// Description  : Find the slot of a key in its bucket (stripe held)
+//
+// Inputs       : c - the segment
+//                key - the key
+//                prevp - set to the link pointing at the slot, if not NULL
+// Outputs      : the slot, NULL if the key is not cached
+
+struct ShmSlot * find_slot_locked(struct ShmCache *c, uint32_t key, uint32_t **prevp) {
+	struct ShmSlot *slots = SHM_SLOTS(c);
+	uint32_t *link = &SHM_BUCKETS(c)[shm_bucket(c, key)];
+
+	while (*link && (slots[*link - 1].key != key)) {
+		link = &slots[*link - 1].next;
+	}
+	if (prevp) *prevp = link;
+	return *link ? &slots[*link - 1] : NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : reserve_slot
+// Description  : Advance the clock hand to a free or evictable slot and
+//                reserve it for this process
+//
+// Inputs       : c - the segment
+// Outputs      : slot index, -1 if every slot is being filled
+
+int64_t reserve_slot(struct ShmCache *c) {
+	struct ShmSlot *slots = SHM_SLOTS(c), *s;
+	uint32_t key, *link, step;
+	int64_t found = -1;
+	int stripe;
+
+	shm_lock(c, -1);
+	for (step = 0; (step < 2 * c->capacity + 1) && (found < 0); step++) {
+		s = &slots[c->hand];
+		key = s->key;
+		if ((key == FS3_SHM_RESERVED) && (kill(s->owner, 0) == -1) && (errno == ESRCH)) {
+			key = s->key = FS3_SHM_FREE;
+		}
+		if (key == FS3_SHM_FREE) {
+			found = c->hand;
+		} else if (key != FS3_SHM_RESERVED) {
+			stripe = shm_bucket(c, key) % FS3_SHM_STRIPES;
+			shm_lock(c, stripe);
+			if (s->key != key) {
+				// dropped meanwhile, look again next time round
+			} else if (s->ref) {
+				s->ref = 0;
+			} else if (find_slot_locked(c, key, &link) == s) {
+				*link = s->next;
+				s->key = FS3_SHM_FREE;
+				found = c->hand;
+				__atomic_add_fetch(&c->evictions, 1, __ATOMIC_RELAXED);
+			}
+			pthread_mutex_unlock(&c->stripes[stripe]);
+		}
+		if (found >= 0) {
+			s->owner = getpid();
+			s->key = FS3_SHM_RESERVED;
+		}
+		c->hand = (c->hand + 1) % c->capacity;
+	}
+	pthread_mutex_unlock(&c->clock_lock);
+	return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : shm_cache_attach
+// Description  : Map the named segment, creating it with the given number
+//                of lines if no process has; later processes use the size
+//                it was created with
+//
+// Inputs       : name - the segment name ("/name")
+//                cachelines - lines if the segment is created
+// Outputs      : 0 if successful, -1 if failure
+
+int shm_cache_attach(const char *name, uint16_t cachelines) {
+	pthread_mutexattr_t attr;
+	struct ShmCache *c;
+	struct stat st;
+	uint32_t nbuckets = 1;
+	size_t size;
+	int fd, created = 1, i;
+
+	if (cachelines == 0) return -1;
+	while (nbuckets < cachelines) nbuckets <<= 1;
+	size = sizeof(struct ShmCache) + sizeof(uint32_t) * nbuckets + sizeof(struct ShmSlot) * cachelines;
+
+	if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) == -1) {
+		created = 0;
+		if ((errno != EEXIST) || ((fd = shm_open(name, O_RDWR, 0600)) == -1)) {
+			logMessage(LOG_ERROR_LEVEL, "Shared cache [%s] could not be opened: %s", name, strerror(errno));
+			return -1;
+		}
+
+		// wait for the creator to size and initialize it
+		for (i = 0; (fstat(fd, &st) == 0) && (st.st_size < sizeof(struct ShmCache)) &&
+			(i < FS3_SHM_ATTACH_TRIES); i++) {
+			usleep(1000);
+		}
+		if (st.st_size < sizeof(struct ShmCache)) {
+			logMessage(LOG_ERROR_LEVEL, "Shared cache [%s] was never initialized", name);
+			close(fd);
+			return -1;
+		}
+		size = st.st_size;
+	} else if (ftruncate(fd, size) == -1) {
+		logMessage(LOG_ERROR_LEVEL, "Shared cache [%s] could not be sized: %s", name, strerror(errno));
+		close(fd);
+		shm_unlink(name);
+		return -1;
+	}
+	c = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (c == MAP_FAILED) {
+		logMessage(LOG_ERROR_LEVEL, "Shared cache [%s] could not be mapped: %s", name, strerror(errno));
+		if (created) shm_unlink(name);
+		return -1;
+	}
+
+	if (created) {
+		// the segment is zero filled, so every slot starts FREE
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+		pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+		pthread_mutex_init(&c->clock_lock, &attr);
+		for (i = 0; i < FS3_SHM_STRIPES; i++) {
+			pthread_mutex_init(&c->stripes[i], &attr);
+		}
+		pthread_mutexattr_destroy(&attr);
+		c->capacity = cachelines;
+		c->nbuckets = nbuckets;
+		__atomic_store_n(&c->magic, FS3_SHM_MAGIC, __ATOMIC_RELEASE);
+	} else {
+		for (i = 0; (__atomic_load_n(&c->magic, __ATOMIC_ACQUIRE) != FS3_SHM_MAGIC) &&
+			(i < FS3_SHM_ATTACH_TRIES); i++) {
+			usleep(1000);
+		}
+		if ((c->magic != FS3_SHM_MAGIC) || (size != sizeof(struct ShmCache) +
+			sizeof(uint32_t) * c->nbuckets + sizeof(struct ShmSlot) * c->capacity)) {
+			logMessage(LOG_ERROR_LEVEL, "Shared cache [%s] is not an FS3 cache", name);
+			munmap(c, size);
+			return -1;
+		}
+	}
+
+	if ((fs3_cur->shm_seen = calloc(FS3_SHM_KEYS, sizeof(uint32_t))) == NULL) {
+		logMessage(LOG_ERROR_LEVEL, "Shared cache [%s] could not allocate its fill tickets", name);
+		munmap(c, size);
+		return -1;
+	}
+	shm_lock(c, -1);
+	c->users++;
+	pthread_mutex_unlock(&c->clock_lock);
+	fs3_cur->shm = c;
+	fs3_cur->shm_size = size;
+	fs3_cur->cache_capacity = c->capacity;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : shm_cache_detach
+// Description  : Unmap the segment, removing it when the last process
+//                leaves
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int shm_cache_detach(void) {
+	struct ShmCache *c = fs3_cur->shm;
+	uint32_t users;
+
+	shm_lock(c, -1);
+	users = --c->users;
+	pthread_mutex_unlock(&c->clock_lock);
+	if (users == 0) {
+		shm_unlink(fs3_cur->shm_name);
+	}
+	munmap(c, fs3_cur->shm_size);
+	free(fs3_cur->shm_seen);
+	fs3_cur->shm_seen = NULL;
+	fs3_cur->shm = NULL;
+	fs3_cur->shm_size = 0;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : shm_cache_get
+// Description  : Copy a cached sector out of the segment, since another
+//                process may replace the slot as soon as the stripe is free.
+//                A line stored before our lease on the track began is not
+//                used, and a miss notes the generation a fill must match.
+//
+// Inputs       : track - the track
+//                sector - the sector
+// Outputs      : the volume's copy of the sector, NULL if not cached
+
+char * shm_cache_get(int track, int sector) {
+	struct ShmCache *c = fs3_cur->shm;
+	uint32_t key = track * FS3_TRACK_SIZE + sector + 1;
+	int stripe = shm_bucket(c, key) % FS3_SHM_STRIPES;
+	struct ShmSlot *s;
+
+	shm_lock(c, stripe);
+	s = find_slot_locked(c, key, NULL);
+	if (s && fs3_cur->leases && !fs3_lease_covers(track, s->stored)) {
+		// another client may have written it while we held no lease
+		s = NULL;
+	}
+	if (s) {
+		memcpy(fs3_cur->shm_line, s->data, FS3_SECTOR_SIZE);
+		s->ref = 1;
+	} else {
+		fs3_cur->shm_seen[key - 1] = c->gens[key - 1] + 1;
+	}
+	pthread_mutex_unlock(&c->stripes[stripe]);
+	__atomic_add_fetch(s ? &c->hits : &c->misses, 1, __ATOMIC_RELAXED);
+	return s ? fs3_cur->shm_line : NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : shm_cache_contains
+// Description  : Check for a sector without copying it or marking it used.
+//                Not finding it notes the generation as a miss does, since
+//                the caller may go on to read it.
+//
+// Inputs       : track - the track
+//                sector - the sector
+// Outputs      : 1 if cached, 0 if not
+
+int shm_cache_contains(int track, int sector) {
+	struct ShmCache *c = fs3_cur->shm;
+	uint32_t key = track * FS3_TRACK_SIZE + sector + 1;
+	int stripe = shm_bucket(c, key) % FS3_SHM_STRIPES, found;
+
+	shm_lock(c, stripe);
+	found = find_slot_locked(c, key, NULL) != NULL;
+	if (!found) {
+		fs3_cur->shm_seen[key - 1] = c->gens[key - 1] + 1;
+	}
+	pthread_mutex_unlock(&c->stripes[stripe]);
+	return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : shm_cache_put
+// Description  : Store a sector, in a slot the clock hand frees if it is
+//                not cached yet.  A cold sector is left unmarked, so the
+//                hand takes it the first time it comes round.  A write
+//                bumps the sector's generation; a fill is refused unless
+//                the generation is still the one our miss saw.
+//
+// Inputs       : track - the track
+//                sector - the sector
+//                buf - the sector data
+//                cold - nonzero to store it unmarked
+//                fill - nonzero if buf was read from the disk after a miss
+// Outputs      : 0 if successful, -1 if failure
+
+int shm_cache_put(int track, int sector, char *buf, int cold, int fill) {
+	struct ShmCache *c = fs3_cur->shm;
+	uint32_t key = track * FS3_TRACK_SIZE + sector + 1, b = shm_bucket(c, key);
+	uint32_t seen = fs3_cur->shm_seen[key - 1];
+	int stripe = b % FS3_SHM_STRIPES;
+	struct ShmSlot *s;
+	int64_t idx;
+
+	// whichever it is, our miss is answered
+	fs3_cur->shm_seen[key - 1] = 0;
+
+	shm_lock(c, stripe);
+	if (fill && (seen == 0)) {
+		// got from the cache rather than missed, only mark it used
+		if ((s = find_slot_locked(c, key, NULL))) {
+			s->ref = s->ref || !cold;
+		}
+		pthread_mutex_unlock(&c->stripes[stripe]);
+		return 0;
+	}
+	if (fill && (seen != c->gens[key - 1] + 1)) {
+		// written or dropped since the miss, what was read may be older
+		pthread_mutex_unlock(&c->stripes[stripe]);
+		__atomic_add_fetch(&c->stale_fills, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	if (!fill) {
+		c->gens[key - 1]++;
+	}
+
+	// already cached, refresh it in place
+	if ((s = find_slot_locked(c, key, NULL))) {
+		memcpy(s->data, buf, FS3_SECTOR_SIZE);
+		s->stored = fs3_metrics_now();
+		s->ref = s->ref || !cold;
+		pthread_mutex_unlock(&c->stripes[stripe]);
+		return 0;
+	}
+	pthread_mutex_unlock(&c->stripes[stripe]);
+
+	if ((idx = reserve_slot(c)) < 0) return -1;
+
+	// another process may have stored or written it while the slot was found
+	shm_lock(c, stripe);
+	if (fill && (seen != c->gens[key - 1] + 1)) {
+		SHM_SLOTS(c)[idx].key = FS3_SHM_FREE;
+		__atomic_add_fetch(&c->stale_fills, 1, __ATOMIC_RELAXED);
+	} else if ((s = find_slot_locked(c, key, NULL))) {
+		memcpy(s->data, buf, FS3_SECTOR_SIZE);
+		s->stored = fs3_metrics_now();
+		SHM_SLOTS(c)[idx].key = FS3_SHM_FREE;
+	} else {
+		s = &SHM_SLOTS(c)[idx];
+		memcpy(s->data, buf, FS3_SECTOR_SIZE);
+		s->stored = fs3_metrics_now();
+		s->ref = !cold;
+		s->next = SHM_BUCKETS(c)[b];
+		s->key = key;
+		SHM_BUCKETS(c)[b] = idx + 1;
+		__atomic_add_fetch(&c->inserts, 1, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&c->stripes[stripe]);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : shm_cache_drop
+// Description  : Remove a sector from the segment, if it is there
+//
+// Inputs       : track - the track
+//                sector - the sector
+// Outputs      : 0 if successful, -1 if failure
+
+int shm_cache_drop(int track, int sector) {
+	struct ShmCache *c = fs3_cur->shm;
+	uint32_t key = track * FS3_TRACK_SIZE + sector + 1, *link;
+	int stripe = shm_bucket(c, key) % FS3_SHM_STRIPES;
+	struct ShmSlot *s;
+
+	// a fill that missed before the drop would bring the old data back
+	shm_lock(c, stripe);
+	c->gens[key - 1]++;
+	if ((s = find_slot_locked(c, key, &link))) {
+		*link = s->next;
+		s->key = FS3_SHM_FREE;
+	}
+	pthread_mutex_unlock(&c->stripes[stripe]);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : shm_cache_log
+// Description  : Log the segment's totals over every process using it
+//
+// Inputs       : none
+// Outputs      : none
+
+void shm_cache_log(void) {
+	struct ShmCache *c = fs3_cur->shm;
+	uint64_t hits = __atomic_load_n(&c->hits, __ATOMIC_RELAXED);
+	uint64_t misses = __atomic_load_n(&c->misses, __ATOMIC_RELAXED);
+
+	logMessage(LOG_OUTPUT_LEVEL, "Shared cache [%s] : %u lines, %u processes attached", fs3_cur->shm_name,
+		c->capacity, c->users);
+	logMessage(LOG_OUTPUT_LEVEL, "Shared hits      [%9lu]", hits);
+	logMessage(LOG_OUTPUT_LEVEL, "Shared misses    [%9lu]", misses);
+	logMessage(LOG_OUTPUT_LEVEL, "Shared inserts   [%9lu]", __atomic_load_n(&c->inserts, __ATOMIC_RELAXED));
+	logMessage(LOG_OUTPUT_LEVEL, "Shared evictions [%9lu]", __atomic_load_n(&c->evictions, __ATOMIC_RELAXED));
+	logMessage(LOG_OUTPUT_LEVEL, "Shared recovered [%9lu]", __atomic_load_n(&c->recoveries, __ATOMIC_RELAXED));
+	logMessage(LOG_OUTPUT_LEVEL, "Shared stale     [%9lu]", __atomic_load_n(&c->stale_fills, __ATOMIC_RELAXED));
+	if (hits + misses) {
+		logMessage(LOG_OUTPUT_LEVEL, "Shared hit ratio [%%%5.2f]", 100.0 * hits / (hits + misses));
+	}
+}
@@ -17,6 +17,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -26,15 +29,31 @@
 #include <fs3_common.h>
 #include <fs3_cache.h>
 #include <fs3_network.h>
+#include <fs3_workload.h>
+#include <fs3_metrics.h>
+#include <fs3_trace.h>
+#include <fs3_wal.h>
+#include <fs3_qos.h>
+#include <fs3_lease.h>
 #include <cmpsc311_log.h>
 #include <cmpsc311_util.h>
 
 // Defines
 #define FS3_WORKLOAD_DIR "workload"
 #define FS3_SIM_MAX_OPEN_FILES 256
-#define FS3_ARGUMENTS "hvc:l:i:p:"
+#define FS3_SIM_MAX_THREADS 64
+#define FS3_SIM_VALIDATE_CHUNK (1 << 20)   // Bytes read back per validation step
+#define FS3_SIM_QOS_FOREGROUND 1           // I/O class of the first replay thread's files
+#define FS3_SIM_QOS_BACKGROUND 2           // I/O class of the other threads' files
+#define FS3_SIM_QOS_WEIGHT 8               // Foreground share of the controller
+#define FS3_SIM_LEASE_MS 1000              // Lease period in a coherence domain
+#define FS3_SIM_L2_LINES 16384             // Lines of the victim file (16 MB)
+#define FS3_ARGUMENTS "hvc:l:i:p:t:m:M:T:wbq:S:L:V:Z:D:"
 #define USAGE \
-	"USAGE: fs3_sim [-h] [-v] [-c <cache size>] [-l <logfile>] <workload-file>\n" \
+	"USAGE: fs3_sim [-h] [-v] [-c <cache size>] [-l <logfile>] [-t <threads>]\n" \
+	"               [-m <metrics-file>] [-M json|prom] [-T <trace-file>] [-w] [-b]\n" \
+	"               [-q <KB/s>] [-S <segment>] [-L <domain>] [-V <victim-file>]\n" \
+	"               [-Z <percent>] [-D <min-run>] <workload-file>\n" \
 	"\n" \
 	"where:\n" \
 	"    -h - help mode (display this message)\n" \
@@ -43,8 +62,25 @@
 	"    -l - write log messages to the filename <logfile>\n" \
     "    -i - IP address of server to connect to.\n" \
     "    -p - port number of server to connect to.\n" \
+	"    -t - replay a compiled workload on this many threads, split by file\n" \
+	"    -m - export latency metrics to <metrics-file> periodically and at unmount\n" \
+	"    -M - metrics export format, json (default) or prom\n" \
+	"    -T - record binary trace events, written to <trace-file> at unmount\n" \
+	"    -w - keep file metadata in a write-ahead log on the disk, replayed at mount\n" \
+	"    -b - write what validation read back of each file to workload/<file>.cmm\n" \
+	"    -q - with -t, queue the first thread's files as foreground and limit the\n" \
+	"         other threads' files to <KB/s> (0 for fair queuing only)\n" \
+	"    -S - share the cache with other processes in shared-memory <segment> (/name)\n" \
+	"    -L - keep the cache coherent with the other clients of the disk in\n" \
+	"         lease <domain> (/name)\n" \
+	"    -V - keep lines evicted from the cache in <victim-file>, kept warm for\n" \
+	"         the next run on the same disk with -w\n" \
+	"    -Z - keep <percent> of the cache's memory as compressed lines\n" \
+	"    -D - before validation, defragment files whose runs of sectors average\n" \
+	"         fewer than <min-run> sectors\n" \
 	"\n" \
-	"    <workload-file> - file contain the workload to simulate\n" \
+	"    <workload-file> - file contain the workload to simulate (text, or\n" \
+	"                      compiled with fs3_wlcomp)\n" \
 	"\n" \
 
 // This is the file table
@@ -53,16 +89,46 @@ typedef struct {
 	int16_t   fhandle;   // This is a file handle for the opened file
 } FS3SimulationTable;
 
+// This is the state of one parallel replay thread
+typedef struct {
+	pthread_t           thread;   // The worker thread
+	int                 id;       // Worker number
+	uint64_t           *index;    // Indices of the ops this worker replays
+	uint64_t            nops;     // Number of ops in the index
+	uint64_t            done;     // Number of ops completed (and timed)
+	FS3SimulationTable *ftable;   // This worker's file handles
+	char               *rbuf;     // Read buffer
+	uint64_t           *lat;      // Per-op latency (ns)
+	uint64_t            bytes;    // Bytes read and written
+	int                 err;      // Set if an op failed
+} FS3SimWorker;
+
 //
 // Global Data
 int verbose;
 uint16_t fs3CacheSize = FS3_DEFAULT_CACHE_SIZE; 
+int fs3SimThreads = 1;
+int fs3SimBackup = 0;
+int fs3SimQos = 0;
+uint32_t fs3SimDefrag = 0;
+
+// Compiled workload being replayed
+FS3WorkloadName *replay_names;
+FS3WorkloadOp *replay_ops;
+char *replay_payload;
 
 //
 // Functional Prototypes
 
 int simulate_FS3( char *wload );              // control loop of the FS3 simulation
+int replay_FS3( char *wload, int wfd );       // replay of a compiled workload
+int replay_op( FS3SimulationTable *ftable, FS3WorkloadOp *op, char *rbuf ); // issue one op
+void * replay_worker( void *arg );            // parallel replay thread
+void free_workers( FS3SimWorker *workers );   // free what the workers allocated
+int replay_parallel( FS3SimulationTable *ftable, uint64_t nops, uint32_t nfiles, uint32_t maxread );
+int finish_FS3( FS3SimulationTable *ftable, int entries ); // validate and shut down
 int validate_file(char *fname, int16_t mfh);  // Validate a file in the filesystem
+size_t first_mismatch(const char *a, const char *b, size_t len); // Offset of first difference
 
 //
 // Functions
@@ -80,6 +146,10 @@ int main( int argc, char *argv[] ) {
 
 	// Local variables
 	int ch, verbose = 0, log_initialized = 0;
+	unsigned percent;
+	char *metrics_file = NULL;
+	uint32_t qos_kbps;
+	FS3MetricFormats metrics_format = FS3_METRICS_JSON;
 
 	// Process the command line parameters
 	while ((ch = getopt(argc, argv, FS3_ARGUMENTS)) != -1) {
@@ -120,6 +190,83 @@ int main( int argc, char *argv[] ) {
 			}
 			break;
 
+		case 'm': // Set the metrics export file
+			metrics_file = optarg;
+			break;
+
+		case 'M': // Set the metrics export format
+			if ( strcmp(optarg, "json") == 0 ) {
+				metrics_format = FS3_METRICS_JSON;
+			} else if ( strcmp(optarg, "prom") == 0 ) {
+				metrics_format = FS3_METRICS_PROM;
+			} else {
+				logMessage( LOG_ERROR_LEVEL, "Bad metrics format [%s]", optarg );
+				return(-1);
+			}
+			break;
+
+		case 'T': // Enable tracing
+			fs3_trace_configure(optarg);
+			break;
+
+		case 'w': // Enable the metadata log
+			fs3_wal_configure(1);
+			break;
+
+		case 'b': // Write backups of the validated files
+			fs3SimBackup = 1;
+			break;
+
+		case 'q': // Queue the replay threads in foreground and background classes
+			if ( (sscanf(optarg, "%u", &qos_kbps) != 1) ||
+				 (fs3_qos_configure(FS3_SIM_QOS_FOREGROUND, FS3_SIM_QOS_WEIGHT, 0, 0) == -1) ||
+				 (fs3_qos_configure(FS3_SIM_QOS_BACKGROUND, 1, 0, qos_kbps) == -1) ) {
+				logMessage( LOG_ERROR_LEVEL, "Bad background bandwidth [%s]", optarg );
+				return(-1);
+			}
+			fs3SimQos = 1;
+			break;
+
+		case 'S': // Keep the cache in shared memory
+			if ( fs3_share_cache(optarg) == -1 ) {
+				return(-1);
+			}
+			break;
+
+		case 'V': // Keep evicted lines in a victim file
+			if ( fs3_cache_l2(optarg, FS3_SIM_L2_LINES) == -1 ) {
+				return(-1);
+			}
+			break;
+
+		case 'Z': // Keep part of the cache compressed
+			if ( (sscanf(optarg, "%u", &percent) != 1) || (percent > 100) || (fs3_compress_cache(percent) == -1) ) {
+				logMessage( LOG_ERROR_LEVEL, "Bad compressed share [%s]", optarg );
+				return(-1);
+			}
+			break;
+
+		case 'D': // Defragment before validation
+			if ( (sscanf(optarg, "%u", &fs3SimDefrag) != 1) || (fs3SimDefrag == 0) ) {
+				logMessage( LOG_ERROR_LEVEL, "Bad defragmentation run [%s]", optarg );
+				return(-1);
+			}
+			break;
+
+		case 'L': // Join a coherence domain
+			if ( fs3_lease_configure(optarg, FS3_SIM_LEASE_MS) == -1 ) {
+				return(-1);
+			}
+			break;
+
+		case 't': // Set the number of replay threads
+			if ( (sscanf(optarg, "%d", &fs3SimThreads) != 1) || (fs3SimThreads < 1) ||
+				 (fs3SimThreads > FS3_SIM_MAX_THREADS) ) {
+				logMessage( LOG_ERROR_LEVEL, "Bad thread count [%s]", optarg );
+				return(-1);
+			}
+			break;
+
 		default:  // Default (unknown)
 			fprintf( stderr, "Unknown command line option (%c), aborting.\n", ch );
 			return( -1 );
@@ -137,6 +284,10 @@ int main( int argc, char *argv[] ) {
 		enableLogLevels(FS3ControllerLLevel | FS3DriverLLevel | FS3SimulatorLLevel);
 	}
 
+	if ( metrics_file ) {
+		fs3_metrics_configure(metrics_file, metrics_format);
+	}
+
 	// The filename should be the next option
 	if ( optind >= argc ) {
 		fprintf( stderr, "Missing command line parameters, use -h to see usage, aborting.\n" );
@@ -170,7 +321,22 @@ int simulate_FS3( char *wload ) {
 	FILE *fhandle = NULL;
 	int32_t err=0, len, off, fields, linecount;
 	FS3SimulationTable ftable[FS3_SIM_MAX_OPEN_FILES];
-	int idx, i, millions;
+	int idx, i, millions, wfd;
+	char magic[sizeof(FS3_WORKLOAD_MAGIC)-1];
+
+	// Compiled workloads are replayed directly from the mapped file
+	if ( (wfd=open(wload, O_RDONLY)) != -1 ) {
+		if ( (read(wfd, magic, sizeof(magic)) == sizeof(magic)) &&
+			 (memcmp(magic, FS3_WORKLOAD_MAGIC, sizeof(magic)) == 0) ) {
+			return( replay_FS3(wload, wfd) );
+		}
+		close(wfd);
+	}
+
+	if ( fs3SimThreads > 1 ) {
+		logMessage( LOG_ERROR_LEVEL, "Parallel replay needs a workload compiled with fs3_wlcomp [%s].", wload );
+		return( -1 );
+	}
 
 	// Setup the file table
 	memset(ftable, 0x0, sizeof(FS3SimulationTable)*FS3_SIM_MAX_OPEN_FILES);
@@ -204,6 +370,9 @@ int simulate_FS3( char *wload ) {
 			} else if ( (linecount > 0) && (linecount)%100000 == 0 ) {
 				fprintf( stderr, ". " );
 			}
+			if ( (linecount > 0) && (linecount)%100000 == 0 ) {
+				fs3_metrics_dump();
+			}
 
 			// Parse out the string
 			linecount ++;
@@ -243,7 +412,7 @@ int simulate_FS3( char *wload ) {
 				ftable[idx].filename = strdup(fname);
 
 				// Now perform the open
-				ftable[idx].fhandle = fs3_open(ftable[idx].filename);
+				ftable[idx].fhandle = fs3_workload_open(ftable[idx].filename);
 				if (ftable[idx].fhandle == -1) {
 					// Failed, error out
 					logMessage(LOG_ERROR_LEVEL, "Open of new file [%s] failed, aborting simulation.", fname);
@@ -351,45 +520,370 @@ int simulate_FS3( char *wload ) {
 		}
 	}
 
-	// Now walk the the table looking for the file
+	// Validate the files and shut down the interface
+	fclose( fhandle );
+	err = finish_FS3(ftable, FS3_SIM_MAX_OPEN_FILES);
 	for (i=0; i<FS3_SIM_MAX_OPEN_FILES; i++) {
+		CMPSC311_SAFE_FREE(ftable[i].filename);
+	}
+	return( err );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : replay_FS3
+// Description  : Replay a compiled workload.  The file is mapped read-only
+//                and each op is issued straight from the mapping, so there
+//                is no parsing, filename lookup or allocation per op.
+//
+// Inputs       : wload - the name of the workload file
+//                wfd - the open descriptor of the workload file
+// Outputs      : 0 if successful test, -1 if failure
+
+int replay_FS3( char *wload, int wfd ) {
+
+	// Local variables
+	FS3SimulationTable *ftable;
+	FS3WorkloadHeader *hdr;
+	FS3WorkloadOp *op, *end;
+	char *base, *rbuf;
+	struct stat stats;
+	uint64_t count = 0;
+	int ret;
+
+	// Map the workload and check the layout
+	if ( (fstat(wfd, &stats) == -1) || (stats.st_size < sizeof(FS3WorkloadHeader)) ||
+		 ((base = mmap(NULL, stats.st_size, PROT_READ, MAP_PRIVATE, wfd, 0)) == MAP_FAILED) ) {
+		logMessage( LOG_ERROR_LEVEL, "Failure mapping the compiled workload [%s], error: %s.\n",
+			wload, strerror(errno) );
+		close( wfd );
+		return( -1 );
+	}
+	close( wfd );
+	madvise(base, stats.st_size, MADV_SEQUENTIAL);
+	hdr = (FS3WorkloadHeader *)base;
+	if ( fs3_workload_check(base, stats.st_size) == -1 ) {
+		logMessage( LOG_ERROR_LEVEL, "Compiled workload [%s] is corrupt or the wrong version.", wload );
+		munmap( base, stats.st_size );
+		return( -1 );
+	}
+	// Everything the replay needs is allocated up front
+	replay_names = (FS3WorkloadName *)(base + hdr->names);
+	replay_ops = (FS3WorkloadOp *)(base + hdr->ops);
+	replay_payload = base + hdr->payload;
+	ftable = calloc(hdr->nfiles, sizeof(FS3SimulationTable));
+	rbuf = malloc(hdr->maxread ? hdr->maxread : 1);
+	if ( (ftable == NULL) || (rbuf == NULL) ) {
+		logMessage( LOG_ERROR_LEVEL, "FS3 simulator failed replay allocation." );
+		munmap( base, stats.st_size );
+		return( -1 );
+	}
+
+	// Startup the interface
+	if ( (fs3_mount_disk() == -1) || (fs3_init_cache(fs3CacheSize) == -1) ){
+		logMessage( LOG_ERROR_LEVEL, "FS3 simulator failed initialization.");
+		munmap( base, stats.st_size );
+		return( -1 );
+	}
+	logMessage(FS3SimulatorLLevel, "FS3 simulator initialization complete, replaying %lu ops.", hdr->nops);
+
+	if ( fs3SimThreads > 1 ) {
+		ret = replay_parallel(ftable, hdr->nops, hdr->nfiles, hdr->maxread);
+	} else {
+		for (op = replay_ops, end = op + hdr->nops, ret = 0; (op < end) && !ret; op++) {
+
+			// Give some output when doing long worklaods
+			if ( (++count % 1000000) == 0 ) {
+				fprintf( stderr, ". %lu million operations.\n", count / 1000000 );
+			} else if ( (count % 100000) == 0 ) {
+				fprintf( stderr, ". " );
+			}
+			if ( (count % 100000) == 0 ) {
+				fs3_metrics_dump();
+			}
+			ret = replay_op(ftable, op, rbuf);
+		}
+	}
+
+	// Validate the files (names still point into the mapping) and shut down
+	if ( ret == 0 ) {
+		ret = finish_FS3(ftable, hdr->nfiles);
+	}
+	free(rbuf);
+	free(ftable);
+	munmap( base, stats.st_size );
+	return( ret );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : replay_op
+// Description  : Issue one compiled workload op, opening the file the first
+//                time it is used as the text replay does
+//
+// Inputs       : ftable - the file table indexed by file id
+//                op - the op to issue
+//                rbuf - buffer large enough for any read in the workload
+// Outputs      : 0 if successful, -1 if failure
+
+int replay_op( FS3SimulationTable *ftable, FS3WorkloadOp *op, char *rbuf ) {
+
+	// Local variables
+	FS3SimulationTable *fent = &ftable[op->file];
+
+	if (fent->filename == NULL) {
+		fent->filename = replay_names[op->file];
+		fent->fhandle = -1;
+	}
+	return( fs3_workload_op(&fent->fhandle, fent->filename, op, replay_payload, rbuf) );
+}
+
+static uint64_t sim_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : replay_worker
+// Description  : Replay the ops of the files owned by one worker, in
+//                workload order, timing each op
+//
+// Inputs       : arg - the FS3SimWorker for this thread
+// Outputs      : NULL
+
+void * replay_worker( void *arg ) {
+
+	// Local variables
+	FS3SimWorker *wrk = (FS3SimWorker *)arg;
+	FS3WorkloadOp *op;
+	uint64_t i, t0;
+	int opened;
+
+	for (i = 0; i < wrk->nops; i++) {
+		op = &replay_ops[wrk->index[i]];
+		opened = (wrk->ftable[op->file].filename != NULL);
+		t0 = sim_now();
+		if (replay_op(wrk->ftable, op, wrk->rbuf)) {
+			wrk->err = 1;
+			break;
+		}
+		if ( fs3SimQos && !opened ) {
+			fs3_qos_set(wrk->ftable[op->file].fhandle,
+				wrk->id ? FS3_SIM_QOS_BACKGROUND : FS3_SIM_QOS_FOREGROUND);
+		}
+		wrk->lat[i] = sim_now() - t0;
+		wrk->bytes += (op->opcode == FS3_WL_SEEK) ? 0 : op->len;
+		wrk->done = i + 1;
+	}
+	return( NULL );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : free_workers
+// Description  : Free the op indexes, latencies, file tables and read
+//                buffers of the workers, whichever were allocated
+//
+// Inputs       : workers - the workers, none of them running
+// Outputs      : none
+
+void free_workers( FS3SimWorker *workers ) {
+
+	// Local variables
+	int t;
+
+	for (t = 0; t < fs3SimThreads; t++) {
+		free(workers[t].index);
+		free(workers[t].lat);
+		free(workers[t].ftable);
+		free(workers[t].rbuf);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : replay_parallel
+// Description  : Partition the compiled workload by file over fs3SimThreads
+//                workers, run them, and report throughput and latency.  Each
+//                file belongs to exactly one worker, so per-file op order is
+//                preserved.
+//
+// Inputs       : ftable - the shared file table, filled in for validation
+//                nops - the number of ops in the workload
+//                nfiles - the number of files in the workload
+//                maxread - the largest read in the workload
+// Outputs      : 0 if successful, -1 if failure
+
+int replay_parallel( FS3SimulationTable *ftable, uint64_t nops, uint32_t nfiles, uint32_t maxread ) {
+
+	// Local variables
+	FS3SimWorker workers[FS3_SIM_MAX_THREADS], *wrk;
+	uint64_t i, total = 0, bytes = 0, start, elapsed;
+	int t, f, err = 0;
+
+	// Count, then index, the ops owned by each worker
+	memset(workers, 0x0, sizeof(workers));
+	for (i = 0; i < nops; i++) {
+		workers[replay_ops[i].file % fs3SimThreads].nops++;
+	}
+	for (t = 0; t < fs3SimThreads; t++) {
+		wrk = &workers[t];
+		wrk->id = t;
+		wrk->index = malloc(sizeof(uint64_t) * (wrk->nops ? wrk->nops : 1));
+		wrk->lat = malloc(sizeof(uint64_t) * (wrk->nops ? wrk->nops : 1));
+		wrk->ftable = calloc(nfiles, sizeof(FS3SimulationTable));
+		wrk->rbuf = malloc(maxread ? maxread : 1);
+		if (!wrk->index || !wrk->lat || !wrk->ftable || !wrk->rbuf) {
+			logMessage( LOG_ERROR_LEVEL, "FS3 simulator failed replay allocation." );
+			free_workers(workers);
+			return( -1 );
+		}
+		wrk->nops = 0;
+	}
+	for (i = 0; i < nops; i++) {
+		wrk = &workers[replay_ops[i].file % fs3SimThreads];
+		wrk->index[wrk->nops++] = i;
+	}
+
+	// Run the workers
+	start = sim_now();
+	for (t = 0; t < fs3SimThreads; t++) {
+		if (pthread_create(&workers[t].thread, NULL, replay_worker, &workers[t]) != 0) {
+			// the workers already running use the ops and the file table
+			logMessage( LOG_ERROR_LEVEL, "FS3 simulator failed to start replay thread %d.", t );
+			while (t-- > 0) {
+				pthread_join(workers[t].thread, NULL);
+			}
+			free_workers(workers);
+			return( -1 );
+		}
+	}
+	for (t = 0; t < fs3SimThreads; t++) {
+		pthread_join(workers[t].thread, NULL);
+	}
+	elapsed = sim_now() - start;
+
+	// Report per-thread latency and aggregate throughput, over the ops that
+	// completed (a worker stops at its first failure)
+	for (t = 0; t < fs3SimThreads; t++) {
+		wrk = &workers[t];
+		err |= wrk->err;
+		total += wrk->done;
+		bytes += wrk->bytes;
+		if (wrk->done) {
+			qsort(wrk->lat, wrk->done, sizeof(uint64_t), compare_u64);
+			logMessage(LOG_OUTPUT_LEVEL, "Thread %2d : %9lu ops, latency p50 %7lu ns, p99 %8lu ns, max %9lu ns",
+				t, wrk->done, wrk->lat[wrk->done / 2], wrk->lat[(wrk->done * 99) / 100], wrk->lat[wrk->done - 1]);
+		}
+
+		// Hand the handles back for validation
+		for (f = 0; f < nfiles; f++) {
+			if (wrk->ftable[f].filename != NULL) {
+				ftable[f] = wrk->ftable[f];
+			}
+		}
+	}
+	free_workers(workers);
+	logMessage(LOG_OUTPUT_LEVEL, "Parallel replay : %d threads, %lu ops in %.3f s (%.0f ops/s, %.2f MB/s)",
+		fs3SimThreads, total, elapsed / 1e9, total * 1e9 / elapsed, bytes * 1e3 / elapsed);
+	return( err ? -1 : 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : finish_FS3
+// Description  : Validate every file in the table, log the cache metrics
+//                and shut down the interface
+//
+// Inputs       : ftable - the simulation file table
+//                entries - the number of slots in the table
+// Outputs      : 0 if successful test, -1 if failure
+
+int finish_FS3( FS3SimulationTable *ftable, int entries ) {
+
+	// Local variables
+	FS3DefragReport report;
+	uint64_t seeks;
+	int i;
+
+	// Defragment what the replay left behind, if asked
+	if (fs3SimDefrag) {
+		if (fs3_defrag(fs3SimDefrag, &report) == -1) {
+			logMessage(LOG_ERROR_LEVEL, "FS3 simulation failed, defragmentation failed");
+			return(-1);
+		}
+		fs3_log_defrag(&report);
+	}
+
+	// Now walk the the table looking for the file
+	seeks = fs3_metrics_count(FS3_MET_NET_TSEEK);
+	for (i=0; i<entries; i++) {
 		if (ftable[i].filename != NULL) {
 			if (validate_file(ftable[i].filename, ftable[i].fhandle) != 0) {
-				logMessage(LOG_ERROR_LEVEL, "FS3 Validation failed on file [%s].", ftable[i].filename,fname);
-				fclose( fhandle );
+				logMessage(LOG_ERROR_LEVEL, "FS3 Validation failed on file [%s].", ftable[i].filename);
 				return(-1);
 			}
 
 			// Clean up the file
 			logMessage(FS3SimulatorLLevel, "Contents of file [%s] validated.", ftable[i].filename);
 			fs3_close(ftable[i].fhandle);
-			free(ftable[i].filename);
-			ftable[i].filename = NULL;
 		}
 	}
+	logMessage(LOG_OUTPUT_LEVEL, "Validation track seeks [%lu]", fs3_metrics_count(FS3_MET_NET_TSEEK) - seeks);
 
-	// Log cache metrics, shut down the interface
-	if ( fs3_log_cache_metrics() == -1 ) {
+	// Log cache and latency metrics, shut down the interface
+	if ( (fs3_log_cache_metrics() == -1) || (fs3_log_metrics() == -1) || (fs3_log_qos_metrics() == -1) ||
+		 (fs3_log_lease_metrics() == -1) ) {
 		logMessage(LOG_ERROR_LEVEL, "FS3 simulation failed, controller metrics failed");
 		return(-1);
 	}
 	if ((fs3_unmount_disk() == -1) || (fs3_close_cache() == -1)) {
 		logMessage( LOG_ERROR_LEVEL, "FS3 simulator failed shutdown.");
-		fclose( fhandle );
 		return( -1 );
 	}
 	logMessage(FS3SimulatorLLevel, "FS3 simulator shutdown complete.");
 	logMessage(LOG_OUTPUT_LEVEL, "FS3 simulation: all tests successful!!!.");
-
-	// Close the workload file, successfully
-	fclose( fhandle );
 	return( 0 );
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : first_mismatch
+// Description  : Find the first byte where two buffers differ, a word at a
+//                time up to the differing word
+//
+// Inputs       : a, b - the buffers
+//                len - bytes to compare
+// Outputs      : offset of the first difference, len if none
+
+size_t first_mismatch(const char *a, const char *b, size_t len) {
+	size_t off = 0;
+	uint64_t x, y;
+
+	for (; off + sizeof(uint64_t) <= len; off += sizeof(uint64_t)) {
+		memcpy(&x, a + off, sizeof(uint64_t));
+		memcpy(&y, b + off, sizeof(uint64_t));
+		if (x != y) break;
+	}
+	for (; (off < len) && (a[off] == b[off]); off++)
+		;
+	return off;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Function     : validate_file
-// Description  : Vadliate a file in the filesystem
+// Description  : Vadliate a file in the filesystem.  The source is mapped and
+//                the FS3 file read back a chunk at a time, so memory use
+//                does not grow with the file; with -b each chunk is also
+//                appended to a <file>.cmm backup for debugging.
 //
 // Inputs       : fname - the name of the file to validate
 //                mfh - the disk file handle
@@ -400,69 +894,85 @@ int validate_file(char *fname, int16_t mfh) {
 	// Local variables
 	char filename[256], bkfile[256], *filbuf, *membuf;
 	struct stat stats;
-	int idx, fh;
+	size_t off, len, bad;
+	int fh, bk = -1, ret = -1;
 
-	// First figure out how big the file is, setup buffer
+	// First figure out how big the file is, map it
 	snprintf(filename, 256, "%s/%s", FS3_WORKLOAD_DIR, fname);
 	if ((stat(filename, &stats) != 0) || (stats.st_size == 0)) {
 		logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], missing or "
 			"unknown source.", filename);
 		return(-1);		
 	}
-	if ( ((filbuf = malloc(stats.st_size)) == NULL) || ((membuf = malloc(stats.st_size)) == NULL) ) {
-		logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], failed "
-			"buffer allocation.", filename);
-		return(-1);		
-	}
-
-	// Now open the file and read the contents
 	if ((fh=open(filename, O_RDONLY)) == -1) {
 		logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], open failed ", filename);
 		return(-1);		
 	}
-	if ((read(fh, filbuf, stats.st_size)) == -1) {
-		logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], read failed ", filename);
-		return(-1);
-	}
+	filbuf = mmap(NULL, stats.st_size, PROT_READ, MAP_PRIVATE, fh, 0);
 	close(fh);
-
-	// Seek to the beginning of the disk file, read the contents
-	if (fs3_seek(mfh, 0) == -1) {
-		// Failed, error out
-		logMessage(LOG_ERROR_LEVEL, "Read fs3 file [%s] see to zero failed.", fname);
-		return(-1);
-	}
-	if (fs3_read(mfh, membuf, stats.st_size) != stats.st_size) {
-		// Failed, error out
-		logMessage(LOG_ERROR_LEVEL, "Read fs3 file [%s] of length %d failed.", fname, stats.st_size);
+	if (filbuf == MAP_FAILED) {
+		logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], mmap failed (%s)", 
+			filename, strerror(errno));
 		return(-1);
 	}
-
-	// Now create a backup of the disk file so people can debug
-	snprintf(bkfile, 256, "%s/%s.cmm", FS3_WORKLOAD_DIR, fname);
-	if ((fh=open(bkfile, O_RDWR|O_CREAT|O_TRUNC, S_IRWXU)) == -1) {
-		logMessage(LOG_ERROR_LEVEL, "Failure creating backup file [%s], open failed (%s) ", 
-			bkfile, strerror(errno));
+	madvise(filbuf, stats.st_size, MADV_SEQUENTIAL);
+	if ((membuf = malloc(FS3_SIM_VALIDATE_CHUNK)) == NULL) {
+		logMessage(LOG_ERROR_LEVEL, "Failure validating file [%s], failed "
+			"buffer allocation.", filename);
+		munmap(filbuf, stats.st_size);
 		return(-1);		
 	}
-	if ((write(fh, membuf, stats.st_size)) == -1) {
-		logMessage(LOG_ERROR_LEVEL, "Failure writing backup file [%s].", bkfile);
-		return(-1);
+
+	// Optionally create a backup of the disk file so people can debug
+	if (fs3SimBackup) {
+		snprintf(bkfile, 256, "%s/%s.cmm", FS3_WORKLOAD_DIR, fname);
+		if ((bk=open(bkfile, O_RDWR|O_CREAT|O_TRUNC, S_IRWXU)) == -1) {
+			logMessage(LOG_ERROR_LEVEL, "Failure creating backup file [%s], open failed (%s) ", 
+				bkfile, strerror(errno));
+			goto done;
+		}
 	}
-	close(fh);
 
-	// Now walk the buffers and compare byte for byte
-	for (idx=0; idx<stats.st_size; idx++) {
-		if (membuf[idx] != filbuf[idx]) {
-			logMessage(LOG_ERROR_LEVEL, "Validation of [%s] failed at offset %d (mem %x/'%c' "
-				"!= fil %x/'%c')", fname, idx, membuf[idx], membuf[idx], filbuf[idx], filbuf[idx]);
-			return(-1);
+	// Seek to the beginning of the disk file; it is read once, so keep it
+	// from pushing other files out of the cache
+	if (fs3_seek(mfh, 0) == -1) {
+		// Failed, error out
+		logMessage(LOG_ERROR_LEVEL, "Read fs3 file [%s] see to zero failed.", fname);
+		goto done;
+	}
+	fs3_advise(mfh, 0, 0, FS3_ADVICE_NOREUSE);
+
+	// Now read the disk file a chunk at a time and compare
+	for (off = 0; off < stats.st_size; off += len) {
+		len = stats.st_size - off < FS3_SIM_VALIDATE_CHUNK ? stats.st_size - off : FS3_SIM_VALIDATE_CHUNK;
+		if (fs3_read(mfh, membuf, len) != len) {
+			// Failed, error out
+			logMessage(LOG_ERROR_LEVEL, "Read fs3 file [%s] of length %d at %lu failed.", 
+				fname, stats.st_size, off);
+			goto done;
+		}
+		if ((bk != -1) && (write(bk, membuf, len) != len)) {
+			logMessage(LOG_ERROR_LEVEL, "Failure writing backup file [%s].", bkfile);
+			goto done;
+		}
+		if (memcmp(membuf, filbuf + off, len) != 0) {
+			bad = first_mismatch(membuf, filbuf + off, len);
+			logMessage(LOG_ERROR_LEVEL, "Validation of [%s] failed at offset %lu (mem %x/'%c' "
+				"!= fil %x/'%c')", fname, off + bad, membuf[bad], membuf[bad], 
+				filbuf[off + bad], filbuf[off + bad]);
+			goto done;
 		}
 	}
+	fs3_advise(mfh, 0, 0, FS3_ADVICE_DONTNEED);
 
-	// Free the buffers, log success, and return successfully
-	free(filbuf);
-	free(membuf);
+	// Log success
 	logMessage(LOG_OUTPUT_LEVEL, "Validation of [%s], length %d sucessful.", fname, stats.st_size);
-	return( 0 );
+	ret = 0;
+
+	// Free the buffers and return
+done:
+	if (bk != -1) close(bk);
+	free(membuf);
+	munmap(filbuf, stats.st_size);
+	return( ret );
 }
@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_trace.c
+//  Description    : This is the implementation of binary event tracing for
+//                   the FS3 filesystem.  Every thread owns a ring of
+//                   FS3_TRACE_RING_EVENTS events; rings are linked onto a
+//                   global list with a compare-and-swap the first time a
+//                   thread traces, and are never freed so they can be dumped
+//                   after the thread exits.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_trace.h>
+#include <fs3_metrics.h>
+
+// This is a thread's ring, only ever written by that thread
+typedef struct TraceRing {
+	uint32_t          tid;                            // Trace thread id
+	uint64_t          head;                           // Events ever written
+	struct TraceRing *next;                           // Next registered ring
+	FS3TraceEvent     events[FS3_TRACE_RING_EVENTS];  // The events
+} TraceRing;
+
+//
+// Support Macros/Data
+int fs3_trace_enabled = 0;
+char *trace_path = NULL;
+TraceRing *trace_rings = NULL;
+uint32_t trace_next_tid = 0;
+static __thread TraceRing *trace_ring = NULL;
+
+//
+// Implementation
+
+static TraceRing *register_ring(void) {
+	TraceRing *ring = calloc(1, sizeof(TraceRing));
+	if (ring == NULL) return NULL;
+	ring->tid = __atomic_add_fetch(&trace_next_tid, 1, __ATOMIC_RELAXED);
+	ring->next = __atomic_load_n(&trace_rings, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&trace_rings, &ring->next, ring, 0,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+	return ring;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_trace_event
+// Description  : Append an event to the calling thread's ring, overwriting
+//                the oldest event once the ring is full
+//
+// Inputs       : type - the event type
+//                phase - begin, end or instant
+//                arg0, arg1, arg2 - event arguments
+// Outputs      : none
+
+void fs3_trace_event(FS3TraceTypes type, FS3TracePhases phase, uint32_t arg0, uint32_t arg1, int32_t arg2) {
+	FS3TraceEvent *ev;
+	uint64_t head;
+
+	if ((trace_ring == NULL) && ((trace_ring = register_ring()) == NULL)) return;
+	head = trace_ring->head;
+	ev = &trace_ring->events[head & (FS3_TRACE_RING_EVENTS - 1)];
+	ev->ts = fs3_metrics_now();
+	ev->type = type;
+	ev->phase = phase;
+	ev->pad = 0;
+	ev->arg0 = arg0;
+	ev->arg1 = arg1;
+	ev->arg2 = arg2;
+	__atomic_store_n(&trace_ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_trace_configure
+// Description  : Enable tracing to a dump file
+//
+// Inputs       : path - the dump file, NULL to disable tracing
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_trace_configure(const char *path) {
+	free(trace_path);
+	trace_path = path ? strdup(path) : NULL;
+	fs3_trace_enabled = (trace_path != NULL);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_trace_dump
+// Description  : Write every thread's ring to the dump file.  Threads still
+//                tracing while this runs may have their newest events torn,
+//                so dump once the workload threads are done.
+//
+// Inputs       : none
+// Outputs      : 0 if successful (or nothing configured), -1 if failure
+
+int fs3_trace_dump(void) {
+	FS3TraceHeader hdr;
+	FS3TraceRingHeader rhdr;
+	TraceRing *ring;
+	uint64_t head, i;
+	FILE *fh;
+
+	if (trace_path == NULL) return 0;
+	if ((fh = fopen(trace_path, "w")) == NULL) {
+		logMessage(LOG_ERROR_LEVEL, "Failed opening trace file [%s]", trace_path);
+		return -1;
+	}
+
+	memset(&hdr, 0x0, sizeof(hdr));
+	memcpy(hdr.magic, FS3_TRACE_MAGIC, sizeof(hdr.magic));
+	hdr.version = FS3_TRACE_VERSION;
+	for (ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+		hdr.nrings++;
+	}
+	fwrite(&hdr, sizeof(hdr), 1, fh);
+
+	for (ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		rhdr.tid = ring->tid;
+		rhdr.count = (head < FS3_TRACE_RING_EVENTS) ? head : FS3_TRACE_RING_EVENTS;
+		rhdr.dropped = head - rhdr.count;
+		fwrite(&rhdr, sizeof(rhdr), 1, fh);
+		for (i = head - rhdr.count; i < head; i++) {
+			fwrite(&ring->events[i & (FS3_TRACE_RING_EVENTS - 1)], sizeof(FS3TraceEvent), 1, fh);
+		}
+	}
+
+	if (fclose(fh) != 0) {
+		logMessage(LOG_ERROR_LEVEL, "Failed writing trace file [%s]", trace_path);
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,106 @@
+#ifndef FS3_TRACE_INCLUDED
+#define FS3_TRACE_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_trace.h
+//  Description    : This is the interface for binary event tracing in the
+//                   FS3 driver, cache and network layers.  Each thread
+//                   writes fixed-size events into its own ring buffer, so
+//                   recording takes no locks; when tracing is off a trace
+//                   point costs one predictable branch.  fs3_tracedump
+//                   converts a dump to Chrome/Perfetto trace JSON.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include
+#include <stdint.h>
+
+// Defines
+#define FS3_TRACE_MAGIC "FS3T"
+#define FS3_TRACE_VERSION 2                 // 2 added FS3_TR_CACHE_PUT
+#define FS3_TRACE_RING_EVENTS (1 << 18)     // Events kept per thread, oldest overwritten
+
+// These are the traced events
+typedef enum {
+
+	FS3_TR_DRIVER_OPEN    = 0,   // fs3_open (begin/end)
+	FS3_TR_DRIVER_CLOSE   = 1,   // fs3_close (begin/end)
+	FS3_TR_DRIVER_READ    = 2,   // fs3_read (begin/end)
+	FS3_TR_DRIVER_WRITE   = 3,   // fs3_write (begin/end)
+	FS3_TR_DRIVER_SEEK    = 4,   // fs3_seek (begin/end)
+	FS3_TR_CACHE_HIT      = 5,   // fs3_get_cache found the sector (instant)
+	FS3_TR_CACHE_MISS     = 6,   // fs3_get_cache did not (instant)
+	FS3_TR_CACHE_EVICT    = 7,   // LRU sector dropped (instant)
+	FS3_TR_NET_MOUNT      = 8,   // MOUNT sent (begin) / reply received (end)
+	FS3_TR_NET_TSEEK      = 9,   // TSEEK sent / received
+	FS3_TR_NET_RDSECT     = 10,  // RDSECT sent / received
+	FS3_TR_NET_WRSECT     = 11,  // WRSECT sent / received
+	FS3_TR_NET_UMOUNT     = 12,  // UMOUNT sent / received
+	FS3_TR_CACHE_PUT      = 13,  // fs3_put_cache stored the sector (instant)
+	FS3_TR_MAXVAL         = 14   // Number of event types
+
+} FS3TraceTypes;
+
+// These are the event phases (same letters as the Chrome trace format)
+typedef enum {
+
+	FS3_TR_BEGIN   = 'B',        // Start of a span
+	FS3_TR_END     = 'E',        // End of a span
+	FS3_TR_INSTANT = 'i'         // Point event
+
+} FS3TracePhases;
+
+// This is a single trace event (24 bytes)
+typedef struct {
+	uint64_t ts;                 // CLOCK_MONOTONIC nanoseconds
+	uint16_t type;               // FS3TraceTypes
+	uint8_t  phase;              // FS3TracePhases
+	uint8_t  pad;
+	uint32_t arg0;               // fd, or track
+	uint32_t arg1;               // count/offset, or sector
+	int32_t  arg2;               // return value on end events
+} FS3TraceEvent;
+
+// This is the header at the start of a trace dump, followed by nrings
+// FS3TraceRingHeader blocks each followed by its events, oldest first
+typedef struct {
+	char     magic[4];           // FS3_TRACE_MAGIC
+	uint32_t version;            // FS3_TRACE_VERSION
+	uint32_t nrings;             // Number of thread rings
+	uint32_t pad;
+} FS3TraceHeader;
+
+typedef struct {
+	uint32_t tid;                // Trace thread id (1 is the first thread traced)
+	uint32_t count;              // Number of events that follow
+	uint64_t dropped;            // Events overwritten before the dump
+} FS3TraceRingHeader;
+
+//
+// Trace Functions
+
+extern int fs3_trace_enabled;
+
+void fs3_trace_event(FS3TraceTypes type, FS3TracePhases phase, uint32_t arg0, uint32_t arg1, int32_t arg2);
+	// Append an event to the calling thread's ring
+
+#ifdef FS3_NO_TRACE
+#define FS3_TRACE(type, phase, arg0, arg1, arg2)
+#else
+#define FS3_TRACE(type, phase, arg0, arg1, arg2) do { \
+		if (__builtin_expect(fs3_trace_enabled, 0)) \
+			fs3_trace_event(type, phase, arg0, arg1, arg2); \
+	} while (0)
+#endif
+	// Trace point, compiled out entirely with -DFS3_NO_TRACE
+
+int fs3_trace_configure(const char *path);
+	// Enable tracing to the given dump file (NULL disables it)
+
+int fs3_trace_dump(void);
+	// Write every thread's ring to the configured dump file, if any
+
+#endif
@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_tracedump.c
+//  Description    : This is the trace converter for the FS3 filesystem.  It
+//                   reads a binary trace written by fs3_trace_dump and writes
+//                   Chrome trace-event JSON, which loads in chrome://tracing
+//                   and ui.perfetto.dev.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+
+// Project Includes
+#include <fs3_trace.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define USAGE \
+	"USAGE: fs3_tracedump [-h] <trace-file> [<json-file>]\n" \
+	"\n" \
+	"where:\n" \
+	"    -h - help mode (display this message)\n" \
+	"\n" \
+	"    <trace-file> - binary trace written by fs3_client -T\n" \
+	"    <json-file>  - Chrome trace JSON output (default stdout)\n" \
+	"\n" \
+
+//
+// Global Data
+static const char *trace_names[FS3_TR_MAXVAL] = {
+	"open", "close", "read", "write", "seek",
+	"hit", "miss", "evict",
+	"MOUNT", "TSEEK", "RDSECT", "WRSECT", "UMOUNT",
+	"put"
+};
+static const char *trace_cats[FS3_TR_MAXVAL] = {
+	"driver", "driver", "driver", "driver", "driver",
+	"cache", "cache", "cache",
+	"network", "network", "network", "network", "network",
+	"cache"
+};
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : write_event
+// Description  : Write one trace event as a Chrome trace JSON object
+//
+// Inputs       : out - the output file
+//                ev - the event
+//                tid - the trace thread id
+//                base - timestamp of the earliest event in the trace
+// Outputs      : none
+
+void write_event(FILE *out, FS3TraceEvent *ev, uint32_t tid, uint64_t base) {
+	uint64_t ts = ev->ts - base;
+
+	fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%lu.%03lu,\"pid\":1,\"tid\":%u",
+		trace_names[ev->type], trace_cats[ev->type], ev->phase, ts / 1000, ts % 1000, tid);
+	if (ev->phase == FS3_TR_INSTANT) {
+		fprintf(out, ",\"s\":\"t\"");
+	}
+	if (ev->type <= FS3_TR_DRIVER_SEEK) {
+		if (ev->phase == FS3_TR_BEGIN) {
+			fprintf(out, ",\"args\":{\"fd\":%u,\"arg\":%u}}", ev->arg0, ev->arg1);
+		} else {
+			fprintf(out, ",\"args\":{\"ret\":%d}}", ev->arg2);
+		}
+	} else if (ev->phase == FS3_TR_END) {
+		fprintf(out, ",\"args\":{\"ret\":%d}}", ev->arg2);
+	} else {
+		fprintf(out, ",\"args\":{\"track\":%u,\"sector\":%u}}", ev->arg0, ev->arg1);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the FS3 trace converter
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main( int argc, char *argv[] ) {
+
+	// Local variables
+	FS3TraceHeader hdr;
+	FS3TraceRingHeader *rhdrs;
+	FS3TraceEvent **events;
+	uint64_t base = UINT64_MAX, total = 0, dropped = 0;
+	uint32_t r, i;
+	FILE *in, *out = stdout;
+
+	// Process the command line parameters
+	if ( (argc < 2) || (argc > 3) || !strcmp(argv[1], "-h") ) {
+		fprintf( stderr, USAGE );
+		return( -1 );
+	}
+	initializeLogWithFilehandle( CMPSC311_LOG_STDERR );
+	if ( (in = fopen(argv[1], "r")) == NULL ) {
+		logMessage( LOG_ERROR_LEVEL, "Failure opening the trace file [%s], error: %s.",
+			argv[1], strerror(errno) );
+		return( -1 );
+	}
+	if ( (fread(&hdr, sizeof(hdr), 1, in) != 1) || memcmp(hdr.magic, FS3_TRACE_MAGIC, sizeof(hdr.magic)) ||
+		 (hdr.version < 1) || (hdr.version > FS3_TRACE_VERSION) ) {
+		logMessage( LOG_ERROR_LEVEL, "File [%s] is not an FS3 trace.", argv[1] );
+		fclose( in );
+		return( -1 );
+	}
+
+	// Read every ring, finding the earliest timestamp
+	rhdrs = calloc(hdr.nrings, sizeof(FS3TraceRingHeader));
+	events = calloc(hdr.nrings, sizeof(FS3TraceEvent *));
+	for (r = 0; r < hdr.nrings; r++) {
+		if ( fread(&rhdrs[r], sizeof(FS3TraceRingHeader), 1, in) != 1 ) {
+			logMessage( LOG_ERROR_LEVEL, "Trace file [%s] is truncated.", argv[1] );
+			fclose( in );
+			return( -1 );
+		}
+		events[r] = malloc(sizeof(FS3TraceEvent) * (rhdrs[r].count ? rhdrs[r].count : 1));
+		if ( fread(events[r], sizeof(FS3TraceEvent), rhdrs[r].count, in) != rhdrs[r].count ) {
+			logMessage( LOG_ERROR_LEVEL, "Trace file [%s] is truncated.", argv[1] );
+			fclose( in );
+			return( -1 );
+		}
+		for (i = 0; i < rhdrs[r].count; i++) {
+			if ( events[r][i].type >= FS3_TR_MAXVAL ) {
+				logMessage( LOG_ERROR_LEVEL, "Trace file [%s] has a bad event type %u.", argv[1], events[r][i].type );
+				fclose( in );
+				return( -1 );
+			}
+			base = (events[r][i].ts < base) ? events[r][i].ts : base;
+		}
+		total += rhdrs[r].count;
+		dropped += rhdrs[r].dropped;
+	}
+	fclose( in );
+
+	// Now write the JSON, one thread at a time
+	if ( (argc == 3) && ((out = fopen(argv[2], "w")) == NULL) ) {
+		logMessage( LOG_ERROR_LEVEL, "Failure opening the JSON file [%s], error: %s.",
+			argv[2], strerror(errno) );
+		return( -1 );
+	}
+	fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"fs3_client\"}}");
+	for (r = 0; r < hdr.nrings; r++) {
+		fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+			rhdrs[r].tid, rhdrs[r].tid);
+		for (i = 0; i < rhdrs[r].count; i++) {
+			write_event(out, &events[r][i], rhdrs[r].tid, base);
+		}
+		free(events[r]);
+	}
+	fprintf(out, "\n]}\n");
+	if ( out != stdout ) {
+		fclose( out );
+	}
+
+	logMessage( LOG_OUTPUT_LEVEL, "Converted %lu events from %u threads (%lu overwritten).",
+		total, hdr.nrings, dropped );
+	free(rhdrs);
+	free(events);
+	return( 0 );
+}
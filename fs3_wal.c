@@ -0,0 +1,674 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_wal.c
+//  Description    : This is the implementation of the FS3 metadata
+//                   write-ahead log.  Records are packed into the log sector
+//                   being filled, which is rewritten at each group commit;
+//                   the driver lock already serializes writers, so every
+//                   update made inside one commit window shares a single
+//                   sector write.  Log and checkpoint sectors carry the
+//                   epoch, so replay stops at the first sector left over
+//                   from an older epoch.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_driver.h>
+#include <fs3_driver_pi.h>
+#include <fs3_ctx_pi.h>
+#include <fs3_metrics.h>
+#include <fs3_wal.h>
+
+//
+// Support Macros/Data
+#define WAL_HDR ((int) sizeof(FS3WalSectorHdr))
+#define WAL_MAX_RECORD (sizeof(FS3WalRecHdr) + 4 + FS3_MAX_NAME_LENGTH)
+
+// These are the record bodies that follow an FS3WalRecHdr
+typedef struct {
+	uint32_t parent;        // CREATE: parent directory, then the name
+} FS3WalCreate;
+
+typedef struct {
+	uint32_t block;         // EXTENT: index of the first block in the file
+	uint16_t track;
+	uint16_t sector;
+	uint32_t count;         // Blocks on consecutive sectors
+} FS3WalExtent;
+
+typedef struct {
+	uint16_t track;         // SLOT and CARVE
+	uint16_t sector;
+	uint16_t off;           // SLOT only
+	uint8_t  cls;
+	uint8_t  pad;
+} FS3WalSlot;
+
+//
+// Implementation
+
+static void write_sector(int track, int sector, char *buf) {
+	fix_track(track);
+	fs3_syscall(FS3_OP_WRSECT, sector, 0, 0, buf);
+	fs3_metrics_add(FS3_CNT_WAL_WRITE, FS3_SECTOR_SIZE);
+	fs3_cur->wal_writes++;
+}
+
+static void read_sector(int track, int sector, char *buf) {
+	fix_track(track);
+	fs3_syscall(FS3_OP_RDSECT, sector, 0, 0, buf);
+}
+
+static void stream_init(WalStream *st, int track, uint32_t sector, uint32_t limit, uint32_t epoch) {
+	FS3WalSectorHdr *hdr = (FS3WalSectorHdr *) st->buf;
+	st->track = track;
+	st->sector = sector;
+	st->limit = limit;
+	st->epoch = epoch;
+	memset(st->buf, 0x0, FS3_SECTOR_SIZE);
+	hdr->magic = FS3_WAL_MAGIC;
+	hdr->epoch = epoch;
+	hdr->used = WAL_HDR;
+}
+
+static void stream_write(WalStream *st) {
+	write_sector(st->track + st->sector / FS3_TRACK_SIZE, st->sector % FS3_TRACK_SIZE, st->buf);
+}
+
+static int stream_put(WalStream *st, const void *rec, int len) {
+	FS3WalSectorHdr *hdr = (FS3WalSectorHdr *) st->buf;
+
+	// records never straddle sectors, a full sector is written and left
+	if (hdr->used + len > FS3_SECTOR_SIZE) {
+		stream_write(st);
+		if (st->sector + 1 == st->limit) return -1;
+		stream_init(st, st->track, st->sector + 1, st->limit, st->epoch);
+		if (st == &fs3_cur->wal_log) fs3_cur->wal_dirty = 0;
+	}
+	memcpy(st->buf + hdr->used, rec, len);
+	hdr->used += len;
+	return 0;
+}
+
+static int encode(char *rec, FS3WalTypes type, int flags, uint32_t ino, const void *body, int blen,
+				  const char *name) {
+	FS3WalRecHdr *hdr = (FS3WalRecHdr *) rec;
+	int nlen = name ? strlen(name) : 0;
+	hdr->type = type;
+	hdr->flags = flags;
+	hdr->len = sizeof(FS3WalRecHdr) + blen + nlen;
+	hdr->ino = ino;
+	memcpy(rec + sizeof(FS3WalRecHdr), body, blen);
+	memcpy(rec + sizeof(FS3WalRecHdr) + blen, name, nlen);
+	return hdr->len;
+}
+
+// The commit thread writes the log sector once its oldest record has waited a
+// full window, so records are committed on time when no driver call follows
+static void *commit_thread(void *arg) {
+	struct timespec until;
+	uint64_t now, wait;
+
+	fs3_cur = arg;
+	pthread_mutex_lock(&fs3_cur->lock);
+	while (!fs3_cur->wal_stop) {
+		if (!fs3_cur->wal_dirty) {
+			pthread_cond_wait(&fs3_cur->wal_cond, &fs3_cur->lock);
+			continue;
+		}
+		now = fs3_metrics_now();
+		if (now - fs3_cur->wal_first >= FS3_WAL_GROUP_NS) {
+			fs3_wal_commit();
+			continue;
+		}
+		wait = fs3_cur->wal_first + FS3_WAL_GROUP_NS - now;
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_sec += (until.tv_nsec + wait) / 1000000000ULL;
+		until.tv_nsec = (until.tv_nsec + wait) % 1000000000ULL;
+		pthread_cond_timedwait(&fs3_cur->wal_cond, &fs3_cur->lock, &until);
+	}
+	pthread_mutex_unlock(&fs3_cur->lock);
+	return NULL;
+}
+
+// Called with the driver lock as the log sector turns dirty
+static void start_committer(void) {
+	if (fs3_cur->wal_stop) return;
+	if (!fs3_cur->wal_running) {
+		if (pthread_create(&fs3_cur->wal_thread, NULL, commit_thread, fs3_cur) != 0) {
+			logMessage(LOG_ERROR_LEVEL, "FS3 metadata log could not start the commit thread, committing at driver calls only.");
+			fs3_cur->wal_stop = 1;
+			return;
+		}
+		fs3_cur->wal_running = 1;
+	}
+	pthread_cond_signal(&fs3_cur->wal_cond);
+}
+
+static void append(FS3WalTypes type, int flags, uint32_t ino, const void *body, int blen, const char *name) {
+	char rec[WAL_MAX_RECORD];
+	FS3WalSectorHdr *hdr = (FS3WalSectorHdr *) fs3_cur->wal_log.buf;
+	FS3WalRecHdr *last;
+	int len;
+
+	if (!fs3_cur->wal_on || fs3_cur->wal_quiet) return;
+	if (!fs3_cur->wal_dirty) {
+		fs3_cur->wal_first = fs3_metrics_now();
+		start_committer();
+	}
+	fs3_cur->wal_dirty = 1;
+	fs3_cur->wal_records++;
+
+	// a file growing write by write keeps updating one SIZE record
+	if ((type == FS3_WAL_SIZE) && (fs3_cur->wal_last >= 0)) {
+		last = (FS3WalRecHdr *) (fs3_cur->wal_log.buf + fs3_cur->wal_last);
+		if ((last->type == FS3_WAL_SIZE) && (last->ino == ino)) {
+			memcpy(last + 1, body, blen);
+			return;
+		}
+	}
+	len = encode(rec, type, flags, ino, body, blen, name);
+	if (stream_put(&fs3_cur->wal_log, rec, len)) {
+		logMessage(LOG_ERROR_LEVEL, "FS3 metadata log is full, logging stopped.");
+		fs3_cur->wal_on = 0;
+		return;
+	}
+	fs3_cur->wal_last = hdr->used - len;
+}
+
+static int checkpoint_put(FS3WalTypes type, int flags, uint32_t ino, const void *body, int blen,
+						  const char *name) {
+	char rec[WAL_MAX_RECORD];
+	return stream_put(&fs3_cur->wal_ckpt, rec, encode(rec, type, flags, ino, body, blen, name));
+}
+
+static int checkpoint_file(struct File *fptr) {
+	FS3WalCreate create = { fptr->parent->ino };
+	FS3WalExtent ext;
+	FS3WalSlot slot;
+	struct Block *bptr;
+	uint32_t blk = 0, size = fptr->size;
+
+	if (checkpoint_put(FS3_WAL_CREATE, fptr->is_dir | (fptr->is_readonly << 1), fptr->ino,
+					   &create, sizeof(create), fptr->name)) return -1;
+	if (fptr->is_dir) return 0;
+	if (fptr->slot) {
+		slot = (FS3WalSlot) { fptr->slot->track, fptr->slot->sector, fptr->slot->off, fptr->slot->cls, 0 };
+		if (checkpoint_put(FS3_WAL_SLOT, 0, fptr->ino, &slot, sizeof(slot), NULL)) return -1;
+	}
+
+	// one record per run of blocks on consecutive sectors
+	for (bptr = fptr->bhead; bptr; ) {
+		if (bptr->track == FS3_NO_TRACK) {
+			bptr = bptr->next;
+			blk++;
+			continue;
+		}
+		ext = (FS3WalExtent) { blk, bptr->track, bptr->sector, 0 };
+		do {
+			ext.count++;
+			bptr = bptr->next;
+		} while (bptr && (bptr->track == ext.track) && (bptr->sector == ext.sector + ext.count));
+		blk += ext.count;
+		if (checkpoint_put(FS3_WAL_EXTENT, 0, fptr->ino, &ext, sizeof(ext), NULL)) return -1;
+	}
+	return checkpoint_put(FS3_WAL_SIZE, 0, fptr->ino, &size, sizeof(size), NULL);
+}
+
+static int apply(FS3WalRecHdr *rec) {
+	char name[FS3_MAX_NAME_LENGTH + 1];
+	const char *body = (const char *) (rec + 1);
+	int blen = rec->len - sizeof(FS3WalRecHdr);
+	struct File *fptr = get_file_by_ino(rec->ino), *src;
+	const FS3WalExtent *ext = (const FS3WalExtent *) body;
+	const FS3WalSlot *sl = (const FS3WalSlot *) body;
+	struct Block *bptr;
+	struct Slot *slot;
+	uint32_t i;
+
+	switch (rec->type) {
+	case FS3_WAL_CREATE:
+		fptr = get_file_by_ino(((const FS3WalCreate *) body)->parent);
+		blen -= sizeof(FS3WalCreate);
+		if (!fptr || !fptr->is_dir || (rec->ino < fs3_cur->next_ino) || (blen <= 0) || (blen > FS3_MAX_NAME_LENGTH)) return -1;
+		memcpy(name, body + sizeof(FS3WalCreate), blen);
+		name[blen] = '\0';
+		set_next_ino(rec->ino);
+		create_file(fptr, name, rec->flags & 1)->is_readonly = (rec->flags >> 1) & 1;
+		return 0;
+
+	case FS3_WAL_SNAPSHOT:
+		if ((rec->ino < fs3_cur->next_ino) || (blen <= 0) || (blen > FS3_MAX_NAME_LENGTH)) return -1;
+		memcpy(name, body, blen);
+		name[blen] = '\0';
+		set_next_ino(rec->ino);
+		fs3_cur->snapshots = find_entry(fs3_cur->root, FS3_SNAPSHOT_DIR, strlen(FS3_SNAPSHOT_DIR));
+		if (fs3_cur->snapshots && !fs3_cur->snapshots->is_readonly) fs3_cur->snapshots = NULL;
+		return take_snapshot(name);
+
+	case FS3_WAL_NEXTINO:
+		set_next_ino(rec->ino);
+		return 0;
+
+	case FS3_WAL_CARVE:
+		carve_slots(sl->cls, sl->track, sl->sector);
+		return 0;
+
+	default:
+		break;
+	}
+
+	// the rest update an existing file
+	if (!fptr || fptr->is_dir) return -1;
+	switch (rec->type) {
+	case FS3_WAL_SIZE:
+		fptr->size = *(const uint32_t *) body;
+		return 0;
+
+	case FS3_WAL_EXTENT:
+		if (fptr->slot) {
+			free_slot(fptr->slot);
+			fptr->slot = NULL;
+		}
+		if (!fptr->bhead) fptr->bhead = create_blk();
+		for (bptr = fptr->bhead, i = 0; i < ext->block; ++i) bptr = next_blk(bptr);
+		for (i = 0; i < ext->count; ++i, bptr = (i < ext->count) ? next_blk(bptr) : bptr) {
+			bptr->track = ext->track;
+			bptr->sector = ext->sector + i;
+		}
+		return 0;
+
+	case FS3_WAL_SLOT:
+		if (!(slot = find_slot(sl->track, sl->sector, sl->off, sl->cls))) return -1;
+		if (fptr->slot) free_slot(fptr->slot);
+		fptr->slot = slot;
+		return 0;
+
+	case FS3_WAL_UNLINK:
+		if (fptr->is_open) return -1;
+		delete_file(fptr);
+		return 0;
+
+	case FS3_WAL_CLONE:
+		src = get_file_by_ino(*(const uint32_t *) body);
+		if (!src || src->is_dir || fptr->bhead || fptr->slot) return -1;
+		share_blocks(src, fptr);
+		return 0;
+
+	default:
+		return -1;
+	}
+}
+
+static int replay_sector(char *buf, uint32_t epoch) {
+	FS3WalSectorHdr *hdr = (FS3WalSectorHdr *) buf;
+	FS3WalRecHdr *rec;
+	int off;
+
+	if ((hdr->magic != FS3_WAL_MAGIC) || (hdr->epoch != epoch) || (hdr->used < WAL_HDR) ||
+		(hdr->used > FS3_SECTOR_SIZE)) return -1;
+	for (off = WAL_HDR; off < hdr->used; off += rec->len) {
+		rec = (FS3WalRecHdr *) (buf + off);
+		if ((rec->len < sizeof(FS3WalRecHdr)) || (off + rec->len > hdr->used) || apply(rec)) {
+			logMessage(LOG_ERROR_LEVEL, "FS3 metadata log has a bad record at offset %d.", off);
+			return -1;
+		}
+		fs3_cur->wal_last = off;
+	}
+	return 0;
+}
+
+static void rebuild(void) {
+	struct File *fptr;
+	struct Block *bptr;
+	int t, i, nblocks;
+
+	// reference counts and the allocator follow from the recovered files
+	memset(fs3_cur->sector_refs, 0x0, sizeof(fs3_cur->sector_refs));
+	for (t = 0; t < FS3_MAX_TRACKS - FS3_WAL_RESERVED_TRACKS; ++t) {
+		fs3_cur->track_used[t] = 0;
+	}
+	for (i = 0; i < fs3_cur->packed_sectors; ++i) {
+		if (fs3_cur->track_used[fs3_cur->carved[i].track] <= fs3_cur->carved[i].sector) fs3_cur->track_used[fs3_cur->carved[i].track] = fs3_cur->carved[i].sector + 1;
+	}
+	for (fptr = fs3_cur->fhead; fptr; fptr = fptr->next) {
+		if (fptr->is_dir || fptr->slot || !fptr->size) continue;
+		nblocks = (fptr->size + FS3_SECTOR_SIZE - 1) / FS3_SECTOR_SIZE;
+		if (!fptr->bhead) fptr->bhead = create_blk();
+		for (bptr = fptr->bhead, i = 0; i < nblocks; ++i, bptr = (i < nblocks) ? next_blk(bptr) : bptr) {
+			if (bptr->track == FS3_NO_TRACK) continue;
+			fs3_cur->sector_refs[bptr->track][bptr->sector]++;
+			if (fs3_cur->track_used[bptr->track] <= bptr->sector) fs3_cur->track_used[bptr->track] = bptr->sector + 1;
+		}
+	}
+	fs3_cur->snapshots = find_entry(fs3_cur->root, FS3_SNAPSHOT_DIR, strlen(FS3_SNAPSHOT_DIR));
+	if (fs3_cur->snapshots && !fs3_cur->snapshots->is_readonly) fs3_cur->snapshots = NULL;
+}
+
+static uint64_t new_volume(void) {
+	return (fs3_metrics_now() ^ ((uint64_t) getpid() << 32)) | 1;
+}
+
+static void write_log_header(uint32_t epoch, uint32_t area, uint32_t sectors) {
+	char buf[FS3_SECTOR_SIZE] = {0};
+	FS3WalLogHdr *hdr = (FS3WalLogHdr *) buf;
+	hdr->magic = FS3_WAL_MAGIC;
+	hdr->epoch = epoch;
+	hdr->ckpt_area = area;
+	hdr->ckpt_sectors = sectors;
+	hdr->mounts = fs3_cur->wal_mounts;
+	hdr->volume = fs3_cur->wal_volume;
+	write_sector(FS3_WAL_TRACK, 0, buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_wal_configure
+// Description  : Turn the metadata log on or off for the next mount
+//
+// Inputs       : enable - nonzero to log
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_wal_configure(int enable) {
+	fs3_cur->wal_configured = enable;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_wal_enabled
+// Description  : Check if the mounted disk is logged
+//
+// Inputs       : none
+// Outputs      : 1 if logging, 0 if not
+
+int fs3_wal_enabled(void) {
+	return fs3_cur->wal_on;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_wal_stamp
+// Description  : Get a stamp of the disk and of one mount of it.  Every
+//                logged mount counts itself in the log header, so the
+//                previous stamp of the next mount matches this mount's
+//                stamp only if no other client mounted the disk between.
+//
+// Inputs       : previous - nonzero for the mount before this one
+// Outputs      : the stamp, 0 if the disk is not logged
+
+uint64_t fs3_wal_stamp(int previous) {
+	if (!fs3_cur->wal_volume) return 0;
+	return fs3_cur->wal_volume ^ ((uint64_t) (fs3_cur->wal_mounts - (previous ? 1 : 0)) << 32);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_wal_recover
+// Description  : Rebuild the files from the newest checkpoint and the log
+//                after it, or format an empty log on a fresh disk.  Called
+//                by fs3_mount_disk with the root directory in place.
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if the checkpoint is damaged (the
+//                log is left alone and not turned on)
+
+int fs3_wal_recover(void) {
+	char buf[FS3_SECTOR_SIZE];
+	FS3WalLogHdr hdr;
+	uint32_t i;
+	int tail = -1;
+
+	fs3_cur->wal_on = 0;
+	fs3_cur->wal_volume = 0;
+	fs3_cur->wal_mounts = 0;
+	fs3_cur->wal_stop = 0;
+	if (!fs3_cur->wal_configured) return 0;
+	fs3_cur->wal_records = fs3_cur->wal_writes = fs3_cur->wal_ckpts = 0;
+	for (i = FS3_MAX_TRACKS - FS3_WAL_RESERVED_TRACKS; i < FS3_MAX_TRACKS; ++i) {
+		fs3_cur->track_used[i] = FS3_TRACK_SIZE;
+	}
+
+	read_sector(FS3_WAL_TRACK, 0, buf);
+	memcpy(&hdr, buf, sizeof(hdr));
+	if (hdr.magic != FS3_WAL_MAGIC) {
+		fs3_cur->wal_area = 0;
+		fs3_cur->wal_volume = new_volume();
+		fs3_cur->wal_mounts = 1;
+		write_log_header(1, fs3_cur->wal_area, 0);
+		stream_init(&fs3_cur->wal_log, FS3_WAL_TRACK, 1, FS3_TRACK_SIZE, 1);
+		fs3_cur->wal_last = -1;
+		fs3_cur->wal_dirty = 0;
+		fs3_cur->wal_on = 1;
+		return 0;
+	}
+
+	// count the mount; disks logged before volumes were named get one now
+	if ((fs3_cur->wal_volume = hdr.volume) == 0) {
+		fs3_cur->wal_volume = new_volume();
+	}
+	fs3_cur->wal_mounts = hdr.mounts + 1;
+
+	// the checkpoint must be whole, the log ends at its first stale sector;
+	// a damaged checkpoint leaves the log as it is and the disk unlogged
+	fs3_cur->wal_quiet = 1;
+	fs3_cur->wal_area = hdr.ckpt_area;
+	for (i = 0; i < hdr.ckpt_sectors; ++i) {
+		read_sector(FS3_WAL_CKPT_TRACK(fs3_cur->wal_area) + i / FS3_TRACK_SIZE, i % FS3_TRACK_SIZE, buf);
+		if (replay_sector(buf, hdr.epoch)) {
+			logMessage(LOG_ERROR_LEVEL, "FS3 checkpoint sector %u is damaged.", i);
+			fs3_cur->wal_quiet = 0;
+			fs3_cur->wal_volume = 0;
+			fs3_cur->wal_mounts = 0;
+			return -1;
+		}
+	}
+	write_log_header(hdr.epoch, hdr.ckpt_area, hdr.ckpt_sectors);
+	stream_init(&fs3_cur->wal_log, FS3_WAL_TRACK, 1, FS3_TRACK_SIZE, hdr.epoch);
+	for (i = 1; i < FS3_TRACK_SIZE; ++i) {
+		read_sector(FS3_WAL_TRACK, i, buf);
+		fs3_cur->wal_last = -1;
+		if (replay_sector(buf, hdr.epoch)) break;
+
+		// appending carries on in the last sector of the log
+		fs3_cur->wal_log.sector = i;
+		memcpy(fs3_cur->wal_log.buf, buf, FS3_SECTOR_SIZE);
+		tail = fs3_cur->wal_last;
+	}
+	fs3_cur->wal_last = tail;
+	fs3_cur->wal_quiet = 0;
+	rebuild();
+
+	logMessage(LOG_INFO_LEVEL, "FS3 recovered epoch %u from %u checkpoint and %u log sectors.",
+		hdr.epoch, hdr.ckpt_sectors, fs3_cur->wal_log.sector);
+	fs3_cur->wal_dirty = 0;
+	fs3_cur->wal_on = 1;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_wal_commit
+// Description  : Write the log sector being filled if it has new records
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_wal_commit(void) {
+	if (fs3_cur->wal_on && fs3_cur->wal_dirty) {
+		stream_write(&fs3_cur->wal_log);
+		fs3_cur->wal_dirty = 0;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_wal_poll
+// Description  : Group commit once the oldest unwritten record has waited a
+//                full window, and checkpoint once the log is long.  Called
+//                by the driver at the end of calls that change metadata;
+//                the commit thread covers a window no call follows.
+//
+// Inputs       : none
+// Outputs      : none
+
+void fs3_wal_poll(void) {
+	if (!fs3_cur->wal_on) return;
+	if (fs3_cur->wal_dirty && (fs3_metrics_now() - fs3_cur->wal_first >= FS3_WAL_GROUP_NS)) {
+		fs3_wal_commit();
+	}
+	if (fs3_cur->wal_log.sector >= FS3_WAL_CKPT_AT) {
+		fs3_wal_checkpoint();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_wal_shutdown
+// Description  : Stop the commit thread, called at unmount without the
+//                driver lock; records made after are committed at close
+//
+// Inputs       : none
+// Outputs      : none
+
+void fs3_wal_shutdown(void) {
+	lock_volume();
+	fs3_cur->wal_stop = 1;
+	pthread_cond_broadcast(&fs3_cur->wal_cond);
+	pthread_mutex_unlock(&fs3_cur->lock);
+	if (fs3_cur->wal_running) {
+		pthread_join(fs3_cur->wal_thread, NULL);
+		fs3_cur->wal_running = 0;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_wal_checkpoint
+// Description  : Write every file to the checkpoint area not in use, then
+//                switch the log header to it and start a new, empty epoch
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_wal_checkpoint(void) {
+	uint32_t epoch = fs3_cur->wal_log.epoch + 1, area = !fs3_cur->wal_area;
+	struct File *fptr;
+	int i, ret = 0;
+
+	if (!fs3_cur->wal_on) return -1;
+
+	// place every block first, so the files hold nothing the log lacks
+	flush_all();
+	fs3_wal_commit();
+
+	stream_init(&fs3_cur->wal_ckpt, FS3_WAL_CKPT_TRACK(area), 0, FS3_WAL_CKPT_TRACKS * FS3_TRACK_SIZE, epoch);
+	for (i = 0; (ret == 0) && (i < fs3_cur->packed_sectors); ++i) {
+		FS3WalSlot carve = { fs3_cur->carved[i].track, fs3_cur->carved[i].sector, 0, fs3_cur->carved[i].cls, 0 };
+		ret = checkpoint_put(FS3_WAL_CARVE, 0, 0, &carve, sizeof(carve), NULL);
+	}
+	for (fptr = fs3_cur->fhead; (ret == 0) && fptr; fptr = fptr->next) {
+		if (fptr != fs3_cur->root) ret = checkpoint_file(fptr);
+	}
+	if ((ret == 0) && (ret = checkpoint_put(FS3_WAL_NEXTINO, 0, fs3_cur->next_ino, NULL, 0, NULL)) == 0) {
+		stream_write(&fs3_cur->wal_ckpt);
+	}
+	if (ret) {
+		logMessage(LOG_ERROR_LEVEL, "FS3 checkpoint does not fit in %d sectors, log left as is.",
+			FS3_WAL_CKPT_TRACKS * FS3_TRACK_SIZE);
+		return -1;
+	}
+
+	write_log_header(epoch, area, fs3_cur->wal_ckpt.sector + 1);
+	fs3_cur->wal_area = area;
+	stream_init(&fs3_cur->wal_log, FS3_WAL_TRACK, 1, FS3_TRACK_SIZE, epoch);
+	fs3_cur->wal_last = -1;
+	fs3_cur->wal_dirty = 0;
+	fs3_cur->wal_ckpts++;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_wal_close
+// Description  : Commit what is left and stop logging at unmount
+//
+// Inputs       : none
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_wal_close(void) {
+	if (!fs3_cur->wal_on) return 0;
+	fs3_wal_commit();
+	logMessage(LOG_OUTPUT_LEVEL, "FS3 metadata log: %lu records, %lu sector writes, %lu checkpoints",
+		fs3_cur->wal_records, fs3_cur->wal_writes, fs3_cur->wal_ckpts);
+	fs3_cur->wal_on = 0;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_wal_suppress
+// Description  : Stop (or resume) keeping records, while the driver makes a
+//                change it logs as a single record
+//
+// Inputs       : on - nonzero to stop recording
+// Outputs      : none
+
+void fs3_wal_suppress(int on) {
+	fs3_cur->wal_quiet = on;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_wal_create ... fs3_wal_snapshot
+// Description  : Append one record of each type to the log
+//
+// Inputs       : the fields of the record
+// Outputs      : none
+
+void fs3_wal_create(uint32_t ino, uint32_t parent, int flags, const char *name) {
+	FS3WalCreate create = { parent };
+	append(FS3_WAL_CREATE, flags, ino, &create, sizeof(create), name);
+}
+
+void fs3_wal_size(uint32_t ino, uint32_t size) {
+	append(FS3_WAL_SIZE, 0, ino, &size, sizeof(size), NULL);
+}
+
+void fs3_wal_extent(uint32_t ino, uint32_t block, int track, int sector, uint32_t count) {
+	FS3WalExtent ext = { block, track, sector, count };
+	append(FS3_WAL_EXTENT, 0, ino, &ext, sizeof(ext), NULL);
+}
+
+void fs3_wal_slot(uint32_t ino, int track, int sector, int off, int cls) {
+	FS3WalSlot slot = { track, sector, off, cls, 0 };
+	append(FS3_WAL_SLOT, 0, ino, &slot, sizeof(slot), NULL);
+}
+
+void fs3_wal_carve(int track, int sector, int cls) {
+	FS3WalSlot slot = { track, sector, 0, cls, 0 };
+	append(FS3_WAL_CARVE, 0, 0, &slot, sizeof(slot), NULL);
+}
+
+void fs3_wal_unlink(uint32_t ino) {
+	append(FS3_WAL_UNLINK, 0, ino, NULL, 0, NULL);
+}
+
+void fs3_wal_clone(uint32_t ino, uint32_t src) {
+	append(FS3_WAL_CLONE, 0, ino, &src, sizeof(src), NULL);
+}
+
+void fs3_wal_snapshot(uint32_t first_ino, const char *name) {
+	append(FS3_WAL_SNAPSHOT, 0, first_ino, NULL, 0, name);
+}
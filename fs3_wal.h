@@ -0,0 +1,131 @@
+#ifndef FS3_WAL_INCLUDED
+#define FS3_WAL_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_wal.h
+//  Description    : This is the interface for the FS3 metadata write-ahead
+//                   log.  File creates, sizes, block placements, slot
+//                   assignments, clones, snapshots and unlinks are appended
+//                   as small records to a log track; records are group
+//                   committed, so one sector write covers every update made
+//                   in a commit window.  A checkpoint writes the whole
+//                   namespace as records to one of two checkpoint areas and
+//                   starts a new log epoch.  Mounting replays the newest
+//                   checkpoint and then the log.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include
+#include <stdint.h>
+#include <fs3_controller.h>
+
+// Defines
+#define FS3_WAL_MAGIC 0x4c415733                                 // "3WAL"
+#define FS3_WAL_TRACK (FS3_MAX_TRACKS - 1)                        // The log, sector 0 is its header
+#define FS3_WAL_CKPT_TRACKS 3                                     // Tracks per checkpoint area
+#define FS3_WAL_CKPT_TRACK(h) (FS3_WAL_TRACK - FS3_WAL_CKPT_TRACKS * (2 - (h)))  // First track of area h
+#define FS3_WAL_RESERVED_TRACKS (1 + 2 * FS3_WAL_CKPT_TRACKS)     // Tracks kept from file data
+#define FS3_WAL_CKPT_AT (FS3_TRACK_SIZE * 3 / 4)                  // Log sectors that trigger a checkpoint
+#ifndef FS3_WAL_GROUP_NS
+#define FS3_WAL_GROUP_NS 2000000                                  // Group commit window (2 ms)
+#endif
+
+// These are the record types
+typedef enum {
+
+	FS3_WAL_CREATE   = 1,   // File or directory created (parent, flags, name)
+	FS3_WAL_SIZE     = 2,   // File size changed
+	FS3_WAL_EXTENT   = 3,   // Run of blocks placed on contiguous sectors
+	FS3_WAL_SLOT     = 4,   // Small file moved to a slot
+	FS3_WAL_CARVE    = 5,   // Sector carved into slots of a class
+	FS3_WAL_UNLINK   = 6,   // File deleted
+	FS3_WAL_CLONE    = 7,   // File made to share another file's blocks
+	FS3_WAL_SNAPSHOT = 8,   // Snapshot taken (first inode used, name)
+	FS3_WAL_NEXTINO  = 9    // Next inode number, ends a checkpoint
+
+} FS3WalTypes;
+
+// This is the header at the start of every log and checkpoint sector
+typedef struct {
+	uint32_t magic;         // FS3_WAL_MAGIC
+	uint32_t epoch;         // Log epoch, bumped by every checkpoint
+	uint16_t used;          // Bytes used in the sector, this header included
+	uint16_t pad;
+} FS3WalSectorHdr;
+
+// This is the log header in sector 0 of the log track
+typedef struct {
+	uint32_t magic;         // FS3_WAL_MAGIC
+	uint32_t epoch;         // Current log epoch
+	uint32_t ckpt_area;     // Checkpoint area holding the epoch's checkpoint
+	uint32_t ckpt_sectors;  // Sectors in that checkpoint
+	uint32_t mounts;        // Times the disk was mounted, bumped by each mount
+	uint32_t pad;
+	uint64_t volume;        // Identity of the disk, chosen when the log is formatted
+} FS3WalLogHdr;
+
+// This is a sequence of sectors written record by record
+typedef struct {
+	int track;              // First track
+	uint32_t sector;        // Sector being filled, counted from the first track
+	uint32_t limit;         // Sectors available
+	uint32_t epoch;         // Stamped on every sector
+	char buf[FS3_SECTOR_SIZE];
+} WalStream;
+
+// This is the header of every record
+typedef struct {
+	uint8_t  type;          // FS3WalTypes
+	uint8_t  flags;         // CREATE: 1 directory, 2 read-only
+	uint16_t len;           // Record length, this header included
+	uint32_t ino;           // File the record is about
+} FS3WalRecHdr;
+
+//
+// Log Functions
+
+int fs3_wal_configure(int enable);
+	// Turn the log on or off, takes effect at the next mount
+
+int fs3_wal_enabled(void);
+	// Nonzero if the mounted disk is logged
+
+uint64_t fs3_wal_stamp(int previous);
+	// Identity of the disk and of this mount (or the one before it), 0 if
+	// not logged
+
+int fs3_wal_recover(void);
+	// Replay the checkpoint and log at mount, or format an empty log
+
+int fs3_wal_commit(void);
+	// Write out records not yet on disk
+
+void fs3_wal_poll(void);
+	// Commit when the window has passed, checkpoint when the log is long
+
+void fs3_wal_shutdown(void);
+	// Stop the commit thread at unmount, without the driver lock
+
+int fs3_wal_checkpoint(void);
+	// Write every file to the other checkpoint area and start a new epoch
+
+int fs3_wal_close(void);
+	// Commit and stop logging at unmount
+
+void fs3_wal_suppress(int on);
+	// Stop recording while an update is logged as one record
+
+void fs3_wal_create(uint32_t ino, uint32_t parent, int flags, const char *name);
+void fs3_wal_size(uint32_t ino, uint32_t size);
+void fs3_wal_extent(uint32_t ino, uint32_t block, int track, int sector, uint32_t count);
+void fs3_wal_slot(uint32_t ino, int track, int sector, int off, int cls);
+void fs3_wal_carve(int track, int sector, int cls);
+void fs3_wal_unlink(uint32_t ino);
+void fs3_wal_clone(uint32_t ino, uint32_t src);
+void fs3_wal_snapshot(uint32_t first_ino, const char *name);
+	// Append one record
+
+#endif
@@ -0,0 +1,227 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_wlcomp.c
+//  Description    : This is the workload compiler for the FS3 simulator.  It
+//                   translates a text workload into the binary format in
+//                   fs3_workload.h so the simulator can replay it without
+//                   parsing, filename lookups or allocation.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+// Project Includes
+#include <fs3_workload.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define FS3_WLCOMP_HASH_SIZE 4096
+#define USAGE \
+	"USAGE: fs3_wlcomp [-h] <workload-file> <compiled-file>\n" \
+	"\n" \
+	"where:\n" \
+	"    -h - help mode (display this message)\n" \
+	"\n" \
+	"    <workload-file> - text workload to compile\n" \
+	"    <compiled-file> - file to write the compiled workload to\n" \
+	"\n" \
+
+// This is an interned filename
+typedef struct WlcompName {
+	char              *filename;  // The filename
+	uint32_t           id;        // The interned file id
+	struct WlcompName *next;      // Next name in the hash chain
+} WlcompName;
+
+//
+// Global Data
+WlcompName *names[FS3_WLCOMP_HASH_SIZE];
+FS3WorkloadName *name_table = NULL;
+uint32_t nfiles = 0, name_capacity = 0;
+FS3WorkloadOp *ops = NULL;
+uint64_t nops = 0, op_capacity = 0;
+char *payload = NULL;
+uint64_t payload_size = 0, payload_capacity = 0;
+
+//
+// Functions
+
+static uint32_t hash_name(const char *str) {
+	uint32_t hash = 5381;
+	while (*str) {
+		hash = hash * 33 + (unsigned char) *str++;
+	}
+	return hash % FS3_WLCOMP_HASH_SIZE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : intern_name
+// Description  : Get the file id for a filename, assigning the next id the
+//                first time the name is seen
+//
+// Inputs       : filename - the name to intern
+// Outputs      : the file id
+
+uint32_t intern_name(char *filename) {
+	uint32_t hash = hash_name(filename);
+	WlcompName *nptr;
+
+	for (nptr = names[hash]; nptr; nptr = nptr->next) {
+		if (!strcmp(nptr->filename, filename)) return nptr->id;
+	}
+
+	if (nfiles == name_capacity) {
+		name_capacity = name_capacity ? name_capacity * 2 : 256;
+		name_table = realloc(name_table, sizeof(FS3WorkloadName) * name_capacity);
+	}
+	memset(name_table[nfiles], 0x0, sizeof(FS3WorkloadName));
+	strncpy(name_table[nfiles], filename, FS3_MAX_PATH_LENGTH - 1);
+
+	nptr = malloc(sizeof(WlcompName));
+	nptr->filename = strdup(filename);
+	nptr->id = nfiles++;
+	nptr->next = names[hash];
+	names[hash] = nptr;
+	return nptr->id;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : add_op
+// Description  : Append an operation (and its write data) to the output
+//
+// Inputs       : opcode - the workload opcode
+//                file - the interned file id
+//                len - the length of the operation
+//                off - the offset of the operation
+//                text - the raw workload text for writes (NULL otherwise)
+// Outputs      : none
+
+void add_op(int opcode, uint32_t file, int32_t len, int32_t off, char *text) {
+	FS3WorkloadOp *op;
+	int32_t i;
+
+	if (nops == op_capacity) {
+		op_capacity = op_capacity ? op_capacity * 2 : 65536;
+		ops = realloc(ops, sizeof(FS3WorkloadOp) * op_capacity);
+	}
+	op = &ops[nops++];
+	memset(op, 0x0, sizeof(FS3WorkloadOp));
+	op->opcode = opcode;
+	op->file = file;
+	op->len = len;
+	op->off = off;
+	op->data = payload_size;
+
+	if (text) {
+		while (payload_size + len > payload_capacity) {
+			payload_capacity = payload_capacity ? payload_capacity * 2 : 1024 * 1024;
+			payload = realloc(payload, payload_capacity);
+		}
+		for (i = 0; i < len; i++) {
+			payload[payload_size++] = (text[i] == '^') ? '\n' : text[i];
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the FS3 workload compiler
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main( int argc, char *argv[] ) {
+
+	// Local variables
+	char line[1024], fname[128], command[128], *sep;
+	int32_t len, off, linecount = 0;
+	uint32_t maxread = 0;
+	FS3WorkloadHeader hdr;
+	FILE *in, *out;
+	uint32_t file;
+
+	// Process the command line parameters
+	if ( (argc != 3) || !strcmp(argv[1], "-h") ) {
+		fprintf( stderr, USAGE );
+		return( -1 );
+	}
+	initializeLogWithFilehandle( CMPSC311_LOG_STDERR );
+	if ( (in = fopen(argv[1], "r")) == NULL ) {
+		logMessage( LOG_ERROR_LEVEL, "Failure opening the workload file [%s], error: %s.",
+			argv[1], strerror(errno) );
+		return( -1 );
+	}
+
+	// Translate each line the same way the simulator parses it
+	while (fgets(line, 1024, in) != NULL) {
+		linecount++;
+		sep = strchr(line, ':');
+		if ( (sscanf(line, "%s %s %d %d", fname, command, &len, &off) != 4) || (sep == NULL) ) {
+			logMessage( LOG_ERROR_LEVEL, "FS3 un-parsable workload string, aborting [%s], line %d",
+				line, linecount );
+			fclose( in );
+			return( -1 );
+		}
+		file = intern_name(fname);
+
+		if (strncmp(command, "WRITEAT", 7) == 0) {
+			CMPSC311_ASSERT2((strlen(sep+1)>=len), "Workload str [%d<%d]", strlen(sep+1), len);
+			add_op(FS3_WL_WRITEAT, file, len, off, sep + 1);
+		} else if (strncmp(command, "WRITE", 5) == 0) {
+			CMPSC311_ASSERT2((strlen(sep+1)>=len), "Workload str [%d<%d]", strlen(sep+1), len);
+			add_op(FS3_WL_WRITE, file, len, off, sep + 1);
+		} else if (strncmp(command, "SEEK", 4) == 0) {
+			add_op(FS3_WL_SEEK, file, len, off, NULL);
+		} else if (strncmp(command, "READ", 4) == 0) {
+			add_op(FS3_WL_READ, file, len, off, NULL);
+			maxread = (len > maxread) ? len : maxread;
+		} else {
+			logMessage( LOG_ERROR_LEVEL, "FS3 unknown workload command [%s], line %d", command, linecount );
+			fclose( in );
+			return( -1 );
+		}
+	}
+	fclose( in );
+
+	// Now write out the header, names, ops and payloads
+	memset(&hdr, 0x0, sizeof(hdr));
+	memcpy(hdr.magic, FS3_WORKLOAD_MAGIC, sizeof(hdr.magic));
+	hdr.version = FS3_WORKLOAD_VERSION;
+	hdr.nfiles = nfiles;
+	hdr.maxread = maxread;
+	hdr.nops = nops;
+	hdr.names = sizeof(FS3WorkloadHeader);
+	hdr.ops = hdr.names + sizeof(FS3WorkloadName) * nfiles;
+	hdr.payload = hdr.ops + sizeof(FS3WorkloadOp) * nops;
+
+	if ( (out = fopen(argv[2], "w")) == NULL ) {
+		logMessage( LOG_ERROR_LEVEL, "Failure opening the compiled file [%s], error: %s.",
+			argv[2], strerror(errno) );
+		return( -1 );
+	}
+	if ( (fwrite(&hdr, sizeof(hdr), 1, out) != 1) ||
+		 (fwrite(name_table, sizeof(FS3WorkloadName), nfiles, out) != nfiles) ||
+		 (fwrite(ops, sizeof(FS3WorkloadOp), nops, out) != nops) ||
+		 (fwrite(payload, 1, payload_size, out) != payload_size) ) {
+		logMessage( LOG_ERROR_LEVEL, "Failure writing the compiled file [%s].", argv[2] );
+		fclose( out );
+		return( -1 );
+	}
+	fclose( out );
+
+	logMessage( LOG_OUTPUT_LEVEL, "Compiled %lu operations on %u files (%lu payload bytes) to [%s].",
+		nops, nfiles, payload_size, argv[2] );
+	return( 0 );
+}
@@ -0,0 +1,504 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_wlgen.c
+//  Description    : This is the synthetic workload generator for the FS3
+//                   simulator.  It emits a WRITE/WRITEAT/SEEK/READ workload
+//                   with configurable file sizes, read/write mix, I/O sizes
+//                   and offset distributions, along with the source files
+//                   the simulator validates against.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include Files
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// Project Includes
+#include <fs3_controller.h>
+#include <fs3_driver.h>
+#include <cmpsc311_log.h>
+
+// Defines
+#define FS3_WORKLOAD_DIR "workload"
+#define FS3_WLGEN_LINE_SIZE 1024
+#define FS3_ARGUMENTS "hf:n:s:i:r:a:D:x:"
+#define USAGE \
+	"USAGE: fs3_wlgen [-h] [-f <files>] [-n <ops>] [-s <dist>] [-i <dist>] [-r <frac>]\n" \
+	"                 [-a <offsets>] [-D <dir>] [-x <seed>] <workload-file>\n" \
+	"\n" \
+	"where:\n" \
+	"    -h - help mode (display this message)\n" \
+	"    -f - number of files (default 16)\n" \
+	"    -n - number of read/write operations (default 100000)\n" \
+	"    -s - file size distribution (default uniform:16384:262144)\n" \
+	"    -i - I/O size distribution (default uniform:1:1000)\n" \
+	"    -r - fraction of operations that are reads (default 0.30)\n" \
+	"    -a - offset distribution (default uniform), one of\n" \
+	"           seq, uniform, zipf[:theta], hotset[:frac:prob:shift-ops]\n" \
+	"           (zipf theta is between 0 and 1 exclusive, default 0.99)\n" \
+	"    -D - directory under workload/ for the source files (default synth)\n" \
+	"    -x - random seed (default 1)\n" \
+	"\n" \
+	"    Size distributions are fixed:N, uniform:MIN:MAX or lognormal:MEDIAN:SIGMA.\n" \
+	"\n" \
+	"    <workload-file> - file to write the generated workload to\n" \
+	"\n" \
+
+// Size distributions
+typedef enum {
+	WLGEN_FIXED     = 0,
+	WLGEN_UNIFORM   = 1,
+	WLGEN_LOGNORMAL = 2,
+} WlgenSizeKind;
+
+typedef struct {
+	WlgenSizeKind kind;
+	double a, b;
+} WlgenSizeDist;
+
+// Offset distributions
+typedef enum {
+	WLGEN_SEQ     = 0,
+	WLGEN_RANDOM  = 1,
+	WLGEN_ZIPF    = 2,
+	WLGEN_HOTSET  = 3,
+} WlgenOffsetKind;
+
+// This is the per-file state of the generator
+typedef struct {
+	char     *filename;  // Workload name of the file
+	char     *data;      // Final contents of the file
+	int32_t   target;    // Size the file is grown to
+	int32_t   size;      // Current size of the file
+	int32_t   loc;       // Current position in the file
+	int32_t   cursor;    // Sequential offset cursor
+} WlgenFile;
+
+//
+// Global Data
+uint64_t wlgen_seed = 1;
+WlgenOffsetKind wlgen_offsets = WLGEN_RANDOM;
+double zipf_theta = 0.99, zipf_zetan, zipf_eta, zipf_alpha;
+uint64_t zipf_n;
+double hot_frac = 0.1, hot_prob = 0.9, hot_pos = 0.0;
+int hot_shift = 10000;
+FILE *wlgen_out;
+
+//
+// Functions
+
+static uint64_t wlgen_rand(void) {
+	wlgen_seed ^= wlgen_seed << 13;
+	wlgen_seed ^= wlgen_seed >> 7;
+	wlgen_seed ^= wlgen_seed << 17;
+	return wlgen_seed;
+}
+
+static double wlgen_uniform(void) {
+	return (wlgen_rand() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_size_dist
+// Description  : Parse a fixed:N, uniform:MIN:MAX or lognormal:MEDIAN:SIGMA
+//                size distribution; sizes must fit an int32_t
+//
+// Inputs       : spec - the distribution string
+//                dist - the distribution to fill in
+// Outputs      : 0 if successful, -1 if failure
+
+int parse_size_dist(char *spec, WlgenSizeDist *dist) {
+	if (sscanf(spec, "fixed:%lf", &dist->a) == 1) {
+		dist->kind = WLGEN_FIXED;
+	} else if (sscanf(spec, "uniform:%lf:%lf", &dist->a, &dist->b) == 2) {
+		dist->kind = WLGEN_UNIFORM;
+		if (dist->b < dist->a) return -1;
+	} else if (sscanf(spec, "lognormal:%lf:%lf", &dist->a, &dist->b) == 2) {
+		dist->kind = WLGEN_LOGNORMAL;
+	} else {
+		return -1;
+	}
+	if ((dist->kind != WLGEN_LOGNORMAL) && (dist->b > INT32_MAX)) return -1;
+	return ((dist->a >= 1) && (dist->a <= INT32_MAX)) ? 0 : -1;
+}
+
+int32_t sample_size(WlgenSizeDist *dist) {
+	double u, v, size;
+	switch (dist->kind) {
+	case WLGEN_FIXED:
+		return (int32_t) dist->a;
+	case WLGEN_UNIFORM:
+		return (int32_t) (dist->a + wlgen_rand() % (uint64_t) (dist->b - dist->a + 1));
+	default:
+		// Box-Muller normal scaled around the median
+		u = wlgen_uniform() + 1e-12;
+		v = wlgen_uniform();
+		size = dist->a * exp(dist->b * sqrt(-2.0 * log(u)) * cos(2 * M_PI * v));
+		return size < INT32_MAX ? (int32_t) size : INT32_MAX;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : parse_offset_dist
+// Description  : Parse the offset distribution specification
+//
+// Inputs       : spec - the distribution string
+// Outputs      : 0 if successful, -1 if failure
+
+int parse_offset_dist(char *spec) {
+	if (strcmp(spec, "seq") == 0) {
+		wlgen_offsets = WLGEN_SEQ;
+	} else if (strcmp(spec, "uniform") == 0) {
+		wlgen_offsets = WLGEN_RANDOM;
+	} else if (strncmp(spec, "zipf", 4) == 0) {
+		wlgen_offsets = WLGEN_ZIPF;
+		sscanf(spec, "zipf:%lf", &zipf_theta);
+		// the sampler below only holds for 0 < theta < 1
+		if (!((zipf_theta > 0) && (zipf_theta < 1.0))) return -1;
+	} else if (strncmp(spec, "hotset", 6) == 0) {
+		wlgen_offsets = WLGEN_HOTSET;
+		sscanf(spec, "hotset:%lf:%lf:%d", &hot_frac, &hot_prob, &hot_shift);
+		if ((hot_frac <= 0) || (hot_frac > 1) || (hot_shift <= 0)) return -1;
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : init_zipf
+// Description  : Setup the Zipfian generator over n sector-sized blocks
+//                (Gray et al., "Quickly Generating Billion-Record Databases")
+//
+// Inputs       : n - the number of blocks in the largest file
+// Outputs      : none
+
+void init_zipf(uint64_t n) {
+	double zeta2 = 1.0 + pow(0.5, zipf_theta);
+	uint64_t i;
+
+	zipf_n = n;
+	zipf_zetan = 0;
+	for (i = 1; i <= n; i++) {
+		zipf_zetan += 1.0 / pow((double) i, zipf_theta);
+	}
+	zipf_alpha = 1.0 / (1.0 - zipf_theta);
+	zipf_eta = (1.0 - pow(2.0 / n, 1.0 - zipf_theta)) / (1.0 - zeta2 / zipf_zetan);
+}
+
+uint64_t sample_zipf(void) {
+	double u = wlgen_uniform(), uz = u * zipf_zetan, blk;
+	if (uz < 1.0) return 0;
+	if (uz < 1.0 + pow(0.5, zipf_theta)) return 1;
+	blk = zipf_n * pow(zipf_eta * u - zipf_eta + 1.0, zipf_alpha);
+	return (blk >= 0) && (blk < zipf_n) ? (uint64_t) blk : zipf_n - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : pick_offset
+// Description  : Choose an offset in [0, maxoff] for an access of len bytes
+//
+// Inputs       : fptr - the file being accessed
+//                maxoff - the largest legal offset
+//                len - the length of the access
+// Outputs      : the chosen offset
+
+int32_t pick_offset(WlgenFile *fptr, int32_t maxoff, int32_t len) {
+	int32_t off, blocks = maxoff / FS3_SECTOR_SIZE + 1, hot, blk;
+
+	switch (wlgen_offsets) {
+	case WLGEN_SEQ:
+		if (fptr->cursor > maxoff) fptr->cursor = 0;
+		off = fptr->cursor;
+		fptr->cursor = off + len;
+		return off;
+
+	case WLGEN_RANDOM:
+		return wlgen_rand() % ((uint64_t) maxoff + 1);
+
+	case WLGEN_ZIPF:
+		blk = sample_zipf() % blocks;
+		break;
+
+	default:
+		hot = (int32_t) (hot_frac * blocks);
+		hot = hot ? hot : 1;
+		if (wlgen_uniform() < hot_prob) {
+			blk = ((int32_t) (hot_pos * blocks) + wlgen_rand() % hot) % blocks;
+		} else {
+			blk = wlgen_rand() % blocks;
+		}
+		break;
+	}
+
+	off = blk * FS3_SECTOR_SIZE + wlgen_rand() % FS3_SECTOR_SIZE;
+	return off < maxoff ? off : maxoff;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : emit_write
+// Description  : Emit a WRITEAT (or WRITE if at) of the file data, split into
+//                as many lines as the simulator's line buffer requires
+//
+// Inputs       : fptr - the file being written
+//                off - the offset of the write, or -1 to write at loc
+//                len - the number of bytes to write
+// Outputs      : none
+
+void emit_write(WlgenFile *fptr, int32_t off, int32_t len) {
+	char *cmd;
+	int32_t hdr, chunk, i;
+
+	if (off == -1) {
+		off = fptr->loc;
+	}
+	while (len > 0) {
+		// The simulator reads each line into a 1024 byte buffer, leave room
+		// for the length digits, the newline and the terminator
+		cmd = (off == fptr->loc) ? "WRITE" : "WRITEAT";
+		hdr = strlen(fptr->filename) + strlen(cmd) + snprintf(NULL, 0, " %d", off) + 10;
+		chunk = FS3_WLGEN_LINE_SIZE - hdr;
+		chunk = len < chunk ? len : chunk;
+		fprintf(wlgen_out, "%s %s %d %d :", fptr->filename, cmd, chunk, (off == fptr->loc) ? 0 : off);
+		for (i = 0; i < chunk; i++) {
+			fputc(fptr->data[off + i] == '\n' ? '^' : fptr->data[off + i], wlgen_out);
+		}
+		fputc('\n', wlgen_out);
+
+		off += chunk;
+		len -= chunk;
+		fptr->loc = off;
+		if (fptr->size < off) {
+			fptr->size = off;
+		}
+	}
+}
+
+void emit_seek(WlgenFile *fptr, int32_t off) {
+	if (fptr->loc != off) {
+		fprintf(wlgen_out, "%s SEEK 0 %d :\n", fptr->filename, off);
+		fptr->loc = off;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : write_source
+// Description  : Write the final contents of a file to its source file
+//
+// Inputs       : fptr - the file to save
+// Outputs      : 0 if successful, -1 if failure
+
+int write_source(WlgenFile *fptr) {
+	char path[256];
+	FILE *fh;
+
+	snprintf(path, sizeof(path), "%s/%s", FS3_WORKLOAD_DIR, fptr->filename);
+	if ((fh = fopen(path, "w")) == NULL) {
+		logMessage(LOG_ERROR_LEVEL, "Failed creating source file [%s] : %s", path, strerror(errno));
+		return -1;
+	}
+	if (fwrite(fptr->data, 1, fptr->size, fh) != fptr->size) {
+		logMessage(LOG_ERROR_LEVEL, "Failed writing source file [%s]", path);
+		fclose(fh);
+		return -1;
+	}
+	fclose(fh);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : main
+// Description  : The main function for the FS3 workload generator
+//
+// Inputs       : argc - the number of command line parameters
+//                argv - the parameters
+// Outputs      : 0 if successful, -1 if failure
+
+int main( int argc, char *argv[] ) {
+
+	// Local variables
+	static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ,.;!?'\"-";
+	int ch, nfiles = 16, nops = 100000, i, j;
+	double readfrac = 0.30;
+	char *dir = "synth", path[256];
+	WlgenSizeDist sizes = { WLGEN_UNIFORM, 16384, 262144 }, iosizes = { WLGEN_UNIFORM, 1, 1000 };
+	WlgenFile *files, *fptr;
+	int32_t len, off, maxtarget = 0;
+
+	// Process the command line parameters
+	while ((ch = getopt(argc, argv, FS3_ARGUMENTS)) != -1) {
+
+		switch (ch) {
+		case 'h': // Help, print usage
+			fprintf( stderr, USAGE );
+			return( -1 );
+
+		case 'f': // File count
+			if ( (sscanf(optarg, "%d", &nfiles) != 1) || (nfiles <= 0) ) {
+				fprintf( stderr, "Bad file count [%s]\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'n': // Operation count
+			if ( (sscanf(optarg, "%d", &nops) != 1) || (nops < 0) ) {
+				fprintf( stderr, "Bad operation count [%s]\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 's': // File size distribution
+			if ( parse_size_dist(optarg, &sizes) ) {
+				fprintf( stderr, "Bad file size distribution [%s]\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'i': // I/O size distribution
+			if ( parse_size_dist(optarg, &iosizes) ) {
+				fprintf( stderr, "Bad I/O size distribution [%s]\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'r': // Read fraction
+			if ( (sscanf(optarg, "%lf", &readfrac) != 1) || (readfrac < 0) || (readfrac > 1) ) {
+				fprintf( stderr, "Bad read fraction [%s]\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'a': // Offset distribution
+			if ( parse_offset_dist(optarg) ) {
+				fprintf( stderr, "Bad offset distribution [%s]\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		case 'D': // Source directory
+			dir = optarg;
+			break;
+
+		case 'x': // Random seed
+			if ( (sscanf(optarg, "%lu", &wlgen_seed) != 1) || (wlgen_seed == 0) ) {
+				fprintf( stderr, "Bad seed [%s]\n", optarg );
+				return( -1 );
+			}
+			break;
+
+		default:  // Default (unknown)
+			fprintf( stderr, "Unknown command line option (%c), aborting.\n", ch );
+			return( -1 );
+		}
+	}
+	initializeLogWithFilehandle( CMPSC311_LOG_STDERR );
+
+	// The filename should be the next option
+	if ( optind >= argc ) {
+		fprintf( stderr, "Missing command line parameters, use -h to see usage, aborting.\n" );
+		return( -1 );
+	}
+	if ( (wlgen_out = fopen(argv[optind], "w")) == NULL ) {
+		logMessage( LOG_ERROR_LEVEL, "Failure opening the workload file [%s], error: %s.",
+			argv[optind], strerror(errno) );
+		return( -1 );
+	}
+	snprintf(path, sizeof(path), "%s/%s", FS3_WORKLOAD_DIR, dir);
+	if ( (mkdir(path, 0755) == -1) && (errno != EEXIST) ) {
+		logMessage( LOG_ERROR_LEVEL, "Failure creating source directory [%s], error: %s.",
+			path, strerror(errno) );
+		return( -1 );
+	}
+
+	// Setup the files and their final contents
+	if ( (files = calloc(nfiles, sizeof(WlgenFile))) == NULL ) {
+		logMessage( LOG_ERROR_LEVEL, "Failure allocating %d files.", nfiles );
+		return( -1 );
+	}
+	for (i = 0; i < nfiles; i++) {
+		fptr = &files[i];
+		snprintf(path, sizeof(path), "%s/file%04d.txt", dir, i);
+		CMPSC311_ASSERT1(strlen(path) < FS3_MAX_PATH_LENGTH, "Workload filename too long [%s]", path);
+		fptr->filename = strdup(path);
+		fptr->target = sample_size(&sizes);
+		fptr->target = fptr->target > 0 ? fptr->target : 1;
+		fptr->data = malloc(fptr->target);
+		if ( (fptr->filename == NULL) || (fptr->data == NULL) ) {
+			logMessage( LOG_ERROR_LEVEL, "Failure allocating %d bytes for [%s].", fptr->target, path );
+			return( -1 );
+		}
+		for (j = 0; j < fptr->target; j++) {
+			fptr->data[j] = (wlgen_rand() % 64 == 0) ? '\n' : alphabet[wlgen_rand() % (sizeof(alphabet) - 1)];
+		}
+		maxtarget = fptr->target > maxtarget ? fptr->target : maxtarget;
+	}
+	if (wlgen_offsets == WLGEN_ZIPF) {
+		init_zipf(maxtarget / FS3_SECTOR_SIZE + 1);
+	}
+
+	// Now generate the operations
+	for (i = 0; i < nops; i++) {
+		fptr = &files[wlgen_rand() % nfiles];
+		len = sample_size(&iosizes);
+		len = len > 0 ? len : 1;
+
+		if ((i > 0) && (i % hot_shift == 0)) {
+			hot_pos += hot_frac;
+			hot_pos -= (hot_pos >= 1.0) ? 1.0 : 0.0;
+		}
+
+		if ((fptr->size > 0) && (wlgen_uniform() < readfrac)) {
+			// Read within the current file contents
+			len = len < fptr->size ? len : fptr->size;
+			off = pick_offset(fptr, fptr->size - len, len);
+			emit_seek(fptr, off);
+			fprintf(wlgen_out, "%s READ %d 0 :\n", fptr->filename, len);
+			fptr->loc += len;
+		} else if ((fptr->size < fptr->target) && ((fptr->size == 0) || (wlgen_rand() & 1))) {
+			// Append towards the target size
+			len = len < fptr->target - fptr->size ? len : fptr->target - fptr->size;
+			emit_seek(fptr, fptr->size);
+			emit_write(fptr, -1, len);
+		} else {
+			// Overwrite existing data, possibly extending the file
+			len = len < fptr->target ? len : fptr->target;
+			off = pick_offset(fptr, (fptr->size < fptr->target - len) ? fptr->size : fptr->target - len, len);
+			emit_write(fptr, off, len);
+		}
+	}
+
+	// Finish every file at its target size so validation covers it all
+	for (i = 0; i < nfiles; i++) {
+		fptr = &files[i];
+		if (fptr->size < fptr->target) {
+			emit_seek(fptr, fptr->size);
+			emit_write(fptr, -1, fptr->target - fptr->size);
+		}
+		if (write_source(fptr)) {
+			return( -1 );
+		}
+		free(fptr->filename);
+		free(fptr->data);
+	}
+
+	// Close the workload file, successfully
+	free(files);
+	fclose(wlgen_out);
+	return( 0 );
+}
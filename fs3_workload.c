@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_workload.c
+//  Description    : This is the replay side of the compiled workload format
+//                   shared by the FS3 simulator and the offline cache
+//                   analyzer: the load-time check of a mapped workload and
+//                   the issue of one op through the driver.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include Files
+#include <string.h>
+
+// Project Includes
+#include <fs3_workload.h>
+#include <cmpsc311_log.h>
+
+//
+// Functions
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_workload_check
+// Description  : Check the layout of a mapped compiled workload and every
+//                op in it, once, so the replay can index the name table,
+//                payload and read buffer without further checks
+//
+// Inputs       : base - the mapped workload
+//                size - length of the mapping
+// Outputs      : 0 if valid, -1 if corrupt or the wrong version
+
+int fs3_workload_check(char *base, size_t size) {
+	FS3WorkloadHeader *hdr = (FS3WorkloadHeader *) base;
+	FS3WorkloadName *names;
+	FS3WorkloadOp *op, *end;
+	uint64_t room;
+	uint32_t f;
+
+	// The header, names, ops and payload follow each other within the file
+	if ((size < sizeof(FS3WorkloadHeader)) || (hdr->version != FS3_WORKLOAD_VERSION) ||
+		(hdr->payload > size) || (hdr->ops > hdr->payload) || (hdr->names > hdr->ops) ||
+		(hdr->names < sizeof(FS3WorkloadHeader)) ||
+		(hdr->nops != (hdr->payload - hdr->ops) / sizeof(FS3WorkloadOp)) ||
+		(hdr->ops + hdr->nops * sizeof(FS3WorkloadOp) != hdr->payload) ||
+		(hdr->nfiles != (hdr->ops - hdr->names) / sizeof(FS3WorkloadName)) ||
+		(hdr->names + hdr->nfiles * sizeof(FS3WorkloadName) != hdr->ops)) {
+		return -1;
+	}
+	names = (FS3WorkloadName *) (base + hdr->names);
+	for (f = 0; f < hdr->nfiles; f++) {
+		if (memchr(names[f], '\0', sizeof(FS3WorkloadName)) == NULL) {
+			return -1;
+		}
+	}
+
+	// Each op names a file in the table, writes stay within the payload and
+	// reads fit the replay buffer
+	room = size - hdr->payload;
+	for (op = (FS3WorkloadOp *) (base + hdr->ops), end = op + hdr->nops; op < end; op++) {
+		if ((op->opcode >= FS3_WL_MAXVAL) || (op->file >= hdr->nfiles)) {
+			return -1;
+		}
+		if (((op->opcode == FS3_WL_WRITE) || (op->opcode == FS3_WL_WRITEAT)) &&
+			((op->data > room) || (op->len > room - op->data))) {
+			return -1;
+		}
+		if ((op->opcode == FS3_WL_READ) && (op->len > hdr->maxread)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_workload_open
+// Description  : Open a workload file, first creating any directories in
+//                its name
+//
+// Inputs       : fname - the workload filename
+// Outputs      : file handle if successful, -1 if failure
+
+int16_t fs3_workload_open(char *fname) {
+	char path[FS3_MAX_PATH_LENGTH], *sep;
+
+	strncpy(path, fname, FS3_MAX_PATH_LENGTH - 1);
+	path[FS3_MAX_PATH_LENGTH - 1] = '\0';
+	for (sep = strchr(path, '/'); sep != NULL; sep = strchr(sep + 1, '/')) {
+		*sep = '\0';
+		fs3_mkdir(path);   // fails harmlessly if it already exists
+		*sep = '/';
+	}
+	return fs3_open(fname);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : fs3_workload_op
+// Description  : Issue one workload op through the driver, opening the file
+//                the first time it is used
+//
+// Inputs       : fhandle - the file's handle, -1 until opened
+//                fname - the file name
+//                op - the op to issue
+//                payload - the write payloads, op->data is an offset into it
+//                rbuf - read buffer of at least op->len bytes
+// Outputs      : 0 if successful, -1 if failure
+
+int fs3_workload_op(int16_t *fhandle, char *fname, FS3WorkloadOp *op, char *payload, char *rbuf) {
+	int ret;
+
+	if ((*fhandle == -1) && ((*fhandle = fs3_workload_open(fname)) == -1)) {
+		logMessage(LOG_ERROR_LEVEL, "Open of new file [%s] failed, aborting replay.", fname);
+		return -1;
+	}
+
+	switch (op->opcode) {
+	case FS3_WL_WRITEAT:
+		if (fs3_seek(*fhandle, op->off)) {
+			ret = 1;
+			break;
+		}
+		// Fall through to the write
+
+	case FS3_WL_WRITE:
+		ret = (fs3_write(*fhandle, payload + op->data, op->len) != op->len);
+		break;
+
+	case FS3_WL_SEEK:
+		ret = (fs3_seek(*fhandle, op->off) != op->len);
+		break;
+
+	case FS3_WL_READ:
+		ret = (fs3_read(*fhandle, rbuf, op->len) != op->len);
+		break;
+
+	default:
+		ret = 1;
+		break;
+	}
+
+	if (ret) {
+		logMessage(LOG_ERROR_LEVEL, "Workload op %d of length %d at %d on file [%s] failed, aborting replay.",
+			op->opcode, op->len, op->off, fname);
+		return -1;
+	}
+	return 0;
+}
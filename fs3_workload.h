@@ -0,0 +1,76 @@
+#ifndef FS3_WORKLOAD_INCLUDED
+#define FS3_WORKLOAD_INCLUDED
+
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_workload.h
+//  Description    : This is the layout of the compiled (binary) workload
+//                   format replayed by the FS3 simulator.  A compiled
+//                   workload is a header, a table of interned filenames, a
+//                   fixed-size op array and the write payloads with the
+//                   '^' line markers already turned back into newlines.
+//                   All fields are in host byte order.  The simulator and
+//                   the cache analyzer share the loader and replay below.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Include
+#include <stddef.h>
+#include <stdint.h>
+#include <fs3_driver.h>
+
+// Defines
+#define FS3_WORKLOAD_MAGIC "FS3W"
+#define FS3_WORKLOAD_VERSION 1
+
+// These are the workload operations
+typedef enum {
+
+	FS3_WL_WRITE   = 0,  // Write at the current position
+	FS3_WL_WRITEAT = 1,  // Seek then write
+	FS3_WL_SEEK    = 2,  // Seek to a position
+	FS3_WL_READ    = 3,  // Read from the current position
+	FS3_WL_MAXVAL  = 4   // Maximum opcode value
+
+} FS3WorkloadOpCodes;
+
+// This is the header at the start of a compiled workload
+typedef struct {
+	char     magic[4];   // FS3_WORKLOAD_MAGIC
+	uint32_t version;    // FS3_WORKLOAD_VERSION
+	uint32_t nfiles;     // Number of interned filenames
+	uint32_t maxread;    // Largest READ length, sizes the replay buffer
+	uint64_t nops;       // Number of operations
+	uint64_t names;      // File offset of the name table
+	uint64_t ops;        // File offset of the op array
+	uint64_t payload;    // File offset of the write payloads
+} FS3WorkloadHeader;
+
+// Names are stored in fixed FS3_MAX_PATH_LENGTH slots, indexed by file id
+typedef char FS3WorkloadName[FS3_MAX_PATH_LENGTH];
+
+// This is a single compiled operation
+typedef struct {
+	uint8_t  opcode;     // FS3WorkloadOpCodes
+	uint8_t  pad[3];
+	uint32_t file;       // Interned file id
+	uint32_t len;        // Length of the read or write
+	uint32_t off;        // Offset of the seek or write
+	uint64_t data;       // Offset of the write data within the payload
+} FS3WorkloadOp;
+
+//
+// Replay Functions
+
+int fs3_workload_check(char *base, size_t size);
+	// Check a mapped compiled workload, and each of its ops, before it is replayed
+
+int16_t fs3_workload_open(char *fname);
+	// Open a workload file, creating the directories in its name
+
+int fs3_workload_op(int16_t *fhandle, char *fname, FS3WorkloadOp *op, char *payload, char *rbuf);
+	// Issue one op, opening the file (handle -1) the first time it is used
+
+#endif
@@ -0,0 +1,687 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  File           : fs3_zcache.c
+//  Description    : This is the compressed tier of the FS3 cache.  Part of
+//                   the cache's memory is given to lines evicted from the
+//                   (uncompressed) LRU list, compressed with a small LZF
+//                   style codec, then with a canonical byte code built from
+//                   the first lines seen, into chunks of 64 byte size
+//                   classes carved from slab pages.  A hit decompresses the line and moves
+//                   it back to the LRU list; when a chunk cannot be had the
+//                   least recently used compressed lines are evicted, to
+//                   the victim file if there is one.
+//
+//   Author        : Ruimin Gao
+//   Last Modified : October 18, 2026
+//
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <cmpsc311_log.h>
+
+// Project Includes
+#include <fs3_cache.h>
+#include <fs3_cache_pi.h>
+#include <fs3_ctx_pi.h>
+
+//
+// Defines
+#define FS3_ZC_HASH_BITS 10                 // Match finder table of 1024 positions
+#define FS3_ZC_MAX_OFF 8192                 // Farthest back a match may start
+#define FS3_ZC_MAX_LIT 32                   // Longest literal run
+#define FS3_ZC_MAX_MATCH 264                // Longest match
+#define ZC_CHUNK(cls) (((cls) + 1) * FS3_ZC_CLASS)
+#define ZC_PER_PAGE(cls) (FS3_ZC_PAGE / ZC_CHUNK(cls))
+
+//
+// Implementation
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_compress
+// Description  : Compress a buffer.  Runs of literals are a byte n (0-31)
+//                and n + 1 bytes; matches are 3 bit length - 2 (7 means a
+//                length byte follows) and 13 bit offset - 1.
+//
+// Inputs       : in - the data
+//                n - its length
+//                out - the compressed data
+//                max - room in out
+// Outputs      : compressed length, 0 if it does not fit
+
+int zc_compress(const uint8_t *in, int n, uint8_t *out, int max) {
+	uint16_t table[1 << FS3_ZC_HASH_BITS];
+	int ip = 0, lit = 0, op = 0, ref, off, len, cnt, h;
+
+	memset(table, 0x0, sizeof(table));
+	while (ip < n) {
+		len = 0;
+		if (ip + 2 < n) {
+			h = ((in[ip] << 16 | in[ip + 1] << 8 | in[ip + 2]) * 2654435761u) >> (32 - FS3_ZC_HASH_BITS);
+			ref = table[h] - 1;
+			table[h] = ip + 1;
+			off = ip - ref - 1;
+			if ((ref >= 0) && (off < FS3_ZC_MAX_OFF) && !memcmp(in + ref, in + ip, 3)) {
+				for (len = 3; (len < FS3_ZC_MAX_MATCH) && (ip + len < n) && (in[ref + len] == in[ip + len]); len++)
+					;
+			}
+		}
+		if ((len == 0) && (ip + 1 < n)) {
+			ip++;
+			continue;
+		}
+		if (len == 0) ip++;
+
+		// literals before the match (or up to the end)
+		for (; lit < ip; lit += cnt) {
+			cnt = (ip - lit > FS3_ZC_MAX_LIT) ? FS3_ZC_MAX_LIT : ip - lit;
+			if (op + 1 + cnt > max) return 0;
+			out[op++] = cnt - 1;
+			memcpy(out + op, in + lit, cnt);
+			op += cnt;
+		}
+		if (len) {
+			if (op + 3 > max) return 0;
+			if (len - 2 < 7) {
+				out[op++] = ((len - 2) << 5) | (off >> 8);
+			} else {
+				out[op++] = (7 << 5) | (off >> 8);
+				out[op++] = len - 2 - 7;
+			}
+			out[op++] = off & 0xff;
+			ip += len;
+			lit = ip;
+		}
+	}
+	return op;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_decompress
+// Description  : Decompress what zc_compress made
+//
+// Inputs       : in - the compressed data
+//                n - its length
+//                out - the data
+//                max - room in out
+// Outputs      : data length, -1 if the input is damaged
+
+int zc_decompress(const uint8_t *in, int n, uint8_t *out, int max) {
+	int ip = 0, op = 0, ctrl, len, ref;
+
+	while (ip < n) {
+		ctrl = in[ip++];
+		if (ctrl < FS3_ZC_MAX_LIT) {
+			len = ctrl + 1;
+			if ((ip + len > n) || (op + len > max)) return -1;
+			memcpy(out + op, in + ip, len);
+			ip += len;
+			op += len;
+			continue;
+		}
+		len = ctrl >> 5;
+		if (len == 7) {
+			if (ip >= n) return -1;
+			len += in[ip++];
+		}
+		if (ip >= n) return -1;
+		ref = op - (((ctrl & 0x1f) << 8) | in[ip++]) - 1;
+		len += 2;
+		if ((ref < 0) || (op + len > max)) return -1;
+		for (; len > 0; len--) {
+			out[op++] = out[ref++];
+		}
+	}
+	return op;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_build_model
+// Description  : Build the byte code from the counts of the lines seen,
+//                every byte getting a code so any line can be coded.  The
+//                counts are flattened until no code is too long.
+//
+// Inputs       : m - the model
+// Outputs      : none
+
+void zc_build_model(struct ZModel *m) {
+	uint64_t weight[512];
+	int parent[512], i, j, a, b, nodes, depth, longest, code;
+
+	do {
+		for (i = 0; i < 256; i++) {
+			weight[i] = (uint64_t) m->freq[i] + 1;
+			parent[i] = -1;
+		}
+
+		// join the two lightest trees until one is left
+		for (nodes = 256; nodes < 511; nodes++) {
+			for (a = b = -1, j = 0; j < nodes; j++) {
+				if (parent[j] != -1) continue;
+				if ((a == -1) || (weight[j] < weight[a])) {
+					b = a;
+					a = j;
+				} else if ((b == -1) || (weight[j] < weight[b])) {
+					b = j;
+				}
+			}
+			weight[nodes] = weight[a] + weight[b];
+			parent[nodes] = -1;
+			parent[a] = parent[b] = nodes;
+		}
+		for (longest = i = 0; i < 256; i++) {
+			for (depth = 0, j = i; parent[j] != -1; j = parent[j]) depth++;
+			m->bits[i] = depth;
+			longest = (depth > longest) ? depth : longest;
+		}
+		for (i = 0; i < 256; i++) {
+			m->freq[i] /= 2;
+		}
+	} while (longest > FS3_ZC_MAX_BITS);
+
+	// canonical codes, shorter first, then by byte
+	memset(m->count, 0x0, sizeof(m->count));
+	for (i = 0; i < 256; i++) {
+		m->count[m->bits[i]]++;
+	}
+	for (code = 0, j = 0, i = 1; i <= FS3_ZC_MAX_BITS; i++) {
+		m->first[i] = code;
+		m->offset[i] = j;
+		code = (code + m->count[i]) << 1;
+		j += m->count[i];
+	}
+	for (i = 1; i <= FS3_ZC_MAX_BITS; i++) {
+		for (a = 0, j = 0; j < 256; j++) {
+			if (m->bits[j] == i) {
+				m->sorted[m->offset[i] + a] = j;
+				m->code[j] = m->first[i] + a++;
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_encode
+// Description  : Code a buffer with the byte code, its length first
+//
+// Inputs       : m - the model
+//                in - the data
+//                n - its length
+//                out - the coded data
+//                max - room in out
+// Outputs      : coded length, 0 if it does not fit
+
+int zc_encode(struct ZModel *m, const uint8_t *in, int n, uint8_t *out, int max) {
+	uint32_t acc = 0;
+	int i, nbits = 0, op = 2;
+
+	out[0] = n & 0xff;
+	out[1] = n >> 8;
+	for (i = 0; i < n; i++) {
+		acc = (acc << m->bits[in[i]]) | m->code[in[i]];
+		nbits += m->bits[in[i]];
+		while (nbits >= 8) {
+			if (op >= max) return 0;
+			nbits -= 8;
+			out[op++] = acc >> nbits;
+		}
+		acc &= (1u << nbits) - 1;
+	}
+	if (nbits) {
+		if (op >= max) return 0;
+		out[op++] = acc << (8 - nbits);
+	}
+	return op;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_decode
+// Description  : Decode what zc_encode made
+//
+// Inputs       : m - the model
+//                in - the coded data
+//                n - its length
+//                out - the data
+//                max - room in out
+// Outputs      : data length, -1 if the input is damaged
+
+int zc_decode(struct ZModel *m, const uint8_t *in, int n, uint8_t *out, int max) {
+	int len, op, ip = 16, bits, code;
+
+	if (n < 2) return -1;
+	len = in[0] | (in[1] << 8);
+	if (len > max) return -1;
+	for (op = 0; op < len; op++) {
+		for (code = 0, bits = 1; bits <= FS3_ZC_MAX_BITS; bits++, ip++) {
+			if (ip >= n * 8) return -1;
+			code = (code << 1) | ((in[ip / 8] >> (7 - ip % 8)) & 1);
+			if ((code >= m->first[bits]) && (code - m->first[bits] < m->count[bits])) break;
+		}
+		if (bits > FS3_ZC_MAX_BITS) return -1;
+		out[op] = m->sorted[m->offset[bits] + code - m->first[bits]];
+		ip++;
+	}
+	return len;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_pack
+// Description  : Compress a line as far as it goes: by matches if that makes
+//                it smaller, then with the byte code once it is built
+//
+// Inputs       : buf - the line
+//                out - the compressed line, FS3_SECTOR_SIZE bytes of room
+//                codec - set to the passes applied
+// Outputs      : compressed length, FS3_SECTOR_SIZE if stored raw
+
+int zc_pack(const uint8_t *buf, uint8_t *out, uint8_t *codec) {
+	struct ZModel *m = &fs3_cur->zc_model;
+	uint8_t matched[FS3_SECTOR_SIZE];
+	const uint8_t *src = buf;
+	int n = FS3_SECTOR_SIZE, len, i;
+
+	*codec = 0;
+	if ((len = zc_compress(buf, FS3_SECTOR_SIZE, matched, FS3_SECTOR_SIZE - FS3_ZC_CLASS))) {
+		src = matched;
+		n = len;
+		*codec = FS3_ZC_LZ;
+	}
+	if (m->lines < FS3_ZC_TRAIN) {
+		for (i = 0; i < n; i++) {
+			m->freq[src[i]]++;
+		}
+		if (++m->lines == FS3_ZC_TRAIN) {
+			zc_build_model(m);
+		}
+	} else if ((len = zc_encode(m, src, n, out, n - FS3_ZC_CLASS))) {
+		*codec |= FS3_ZC_CODED;
+		return len;
+	}
+	memcpy(out, src, n);
+	return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_unpack
+// Description  : Undo zc_pack
+//
+// Inputs       : in - the compressed line
+//                n - its length
+//                codec - the passes applied
+//                buf - the line
+// Outputs      : 0 if successful, -1 if the line is damaged
+
+int zc_unpack(const uint8_t *in, int n, uint8_t codec, uint8_t *buf) {
+	uint8_t matched[FS3_SECTOR_SIZE];
+
+	if (codec & FS3_ZC_CODED) {
+		if ((n = zc_decode(&fs3_cur->zc_model, in, n, matched, FS3_SECTOR_SIZE)) == -1) return -1;
+		in = matched;
+	}
+	if (codec & FS3_ZC_LZ) {
+		return (zc_decompress(in, n, buf, FS3_SECTOR_SIZE) == FS3_SECTOR_SIZE) ? 0 : -1;
+	}
+	if (n != FS3_SECTOR_SIZE) return -1;
+	memcpy(buf, in, FS3_SECTOR_SIZE);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_unlink_page / zc_push_page
+// Description  : Take a page off, or put it at the front of, a page list
+//
+// Inputs       : list - the list
+//                pg - the page
+// Outputs      : none
+
+void zc_unlink_page(struct ZPage **list, struct ZPage *pg) {
+	if (pg->prev) pg->prev->next = pg->next;
+	else *list = pg->next;
+	if (pg->next) pg->next->prev = pg->prev;
+	pg->prev = pg->next = NULL;
+}
+
+void zc_push_page(struct ZPage **list, struct ZPage *pg) {
+	pg->prev = NULL;
+	pg->next = *list;
+	if (*list) (*list)->prev = pg;
+	*list = pg;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_alloc
+// Description  : Get a chunk of a size class, from a page of the class with
+//                room, a free page, or a new page while under the limit
+//
+// Inputs       : cls - the size class
+//                chunk - set to the chunk's index in its page
+// Outputs      : the page, NULL if none can be had
+
+struct ZPage * zc_alloc(int cls, uint16_t *chunk) {
+	struct ZPage *pg = fs3_cur->zc_partial[cls];
+	uint32_t i;
+
+	if (!pg) {
+		if ((pg = fs3_cur->zc_free)) {
+			zc_unlink_page(&fs3_cur->zc_free, pg);
+		} else if ((fs3_cur->zc_pages < fs3_cur->zc_max_pages) &&
+			(pg = (struct ZPage *) malloc(sizeof(struct ZPage)))) {
+			fs3_cur->zc_pages++;
+		} else {
+			return NULL;
+		}
+		pg->cls = cls;
+		pg->used = 0;
+		memset(pg->map, 0x0, sizeof(pg->map));
+		zc_push_page(&fs3_cur->zc_partial[cls], pg);
+	}
+	for (i = 0; pg->map[i / 64] & (1ULL << (i % 64)); i++)
+		;
+	pg->map[i / 64] |= 1ULL << (i % 64);
+	if (++pg->used == ZC_PER_PAGE(cls)) {
+		zc_unlink_page(&fs3_cur->zc_partial[cls], pg);
+	}
+	*chunk = i;
+	return pg;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_free_chunk
+// Description  : Give a chunk back, and its page once it is empty
+//
+// Inputs       : pg - the page
+//                chunk - the chunk
+// Outputs      : none
+
+void zc_free_chunk(struct ZPage *pg, uint16_t chunk) {
+	int cls = pg->cls;
+
+	pg->map[chunk / 64] &= ~(1ULL << (chunk % 64));
+	if (pg->used-- == ZC_PER_PAGE(cls)) {
+		zc_push_page(&fs3_cur->zc_partial[cls], pg);
+	}
+	if (pg->used == 0) {
+		zc_unlink_page(&fs3_cur->zc_partial[cls], pg);
+		pg->cls = -1;
+		zc_push_page(&fs3_cur->zc_free, pg);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_find
+// Description  : Find a compressed line
+//
+// Inputs       : key - its key
+//                prevp - set to the link pointing at it, if not NULL
+// Outputs      : the line, NULL if it is not compressed here
+
+struct ZEntry * zc_find(uint32_t key, struct ZEntry ***prevp) {
+	struct ZEntry **link = &fs3_cur->zc_buckets[(key * 2654435761u) % FS3_ZC_BUCKETS];
+
+	while (*link && ((*link)->key != key)) {
+		link = &(*link)->hnext;
+	}
+	if (prevp) *prevp = link;
+	return *link;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_remove
+// Description  : Remove a compressed line, optionally decompressing it
+//
+// Inputs       : e - the line
+//                link - the link pointing at it
+//                buf - where to decompress it, NULL to discard it
+// Outputs      : 0 if successful, -1 if the line was damaged
+
+int zc_remove(struct ZEntry *e, struct ZEntry **link, char *buf) {
+	char *data = e->page->data + e->chunk * ZC_CHUNK(e->page->cls);
+	int ret = 0;
+
+	if (buf) {
+		ret = zc_unpack((uint8_t *) data, e->len, e->codec, (uint8_t *) buf);
+	}
+	*link = e->hnext;
+	if (e->prev) e->prev->next = e->next;
+	else fs3_cur->zc_head = e->next;
+	if (e->next) e->next->prev = e->prev;
+	else fs3_cur->zc_tail = e->prev;
+	zc_free_chunk(e->page, e->chunk);
+	fs3_cur->zc_count--;
+	free(e);
+	return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zc_evict
+// Description  : Evict the least recently used compressed line, to the
+//                victim file if there is one
+//
+// Inputs       : none
+// Outputs      : none
+
+void zc_evict(void) {
+	struct ZEntry *e = fs3_cur->zc_head, **link;
+	char buf[FS3_SECTOR_SIZE];
+	uint32_t key = e->key, epoch = e->epoch;
+
+	zc_find(key, &link);
+	if ((zc_remove(e, link, fs3_cur->l2 ? buf : NULL) == 0) && fs3_cur->l2) {
+		l2_cache_put(key / FS3_TRACK_SIZE, key % FS3_TRACK_SIZE, buf, epoch);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zcache_init
+// Description  : Set up an empty compressed tier
+//
+// Inputs       : pages - slab pages it may use
+// Outputs      : 0 if successful, -1 if failure
+
+int zcache_init(uint32_t pages) {
+	fs3_cur->zc_buckets = (struct ZEntry **) calloc(FS3_ZC_BUCKETS, sizeof(struct ZEntry *));
+	if (!fs3_cur->zc_buckets) {
+		logMessage(LOG_ERROR_LEVEL, "Compressed cache could not be allocated");
+		return -1;
+	}
+	memset(fs3_cur->zc_partial, 0x0, sizeof(fs3_cur->zc_partial));
+	fs3_cur->zc_free = NULL;
+	fs3_cur->zc_head = fs3_cur->zc_tail = NULL;
+	fs3_cur->zc_pages = 0;
+	fs3_cur->zc_max_pages = pages;
+	memset(&fs3_cur->zc_model, 0x0, sizeof(fs3_cur->zc_model));
+	fs3_cur->zc_count = fs3_cur->zc_peak = 0;
+	fs3_cur->zc_bytes = fs3_cur->zc_raw = fs3_cur->zc_hits = fs3_cur->zc_stores = 0;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zcache_close
+// Description  : Evict every compressed line (to the victim file, if any)
+//                and free the pages
+//
+// Inputs       : none
+// Outputs      : none
+
+void zcache_close(void) {
+	struct ZPage *pg;
+	int cls;
+
+	while (fs3_cur->zc_head) {
+		zc_evict();
+	}
+	for (cls = 0; cls < FS3_ZC_CLASSES; cls++) {
+		while ((pg = fs3_cur->zc_partial[cls])) {
+			zc_unlink_page(&fs3_cur->zc_partial[cls], pg);
+			free(pg);
+		}
+	}
+	while ((pg = fs3_cur->zc_free)) {
+		zc_unlink_page(&fs3_cur->zc_free, pg);
+		free(pg);
+	}
+	free(fs3_cur->zc_buckets);
+	fs3_cur->zc_buckets = NULL;
+	fs3_cur->zc_pages = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zcache_get
+// Description  : Take a line out of the compressed tier
+//
+// Inputs       : track - the track
+//                sector - the sector
+//                buf - where to decompress it
+//                epoch - set to the lease epoch it was cached in
+// Outputs      : 1 if it was there, 0 if not
+
+int zcache_get(int track, int sector, char *buf, uint32_t *epoch) {
+	struct ZEntry *e, **link;
+
+	if (!(e = zc_find(track * FS3_TRACK_SIZE + sector, &link))) return 0;
+	*epoch = e->epoch;
+	if (zc_remove(e, link, buf) == -1) {
+		logMessage(LOG_ERROR_LEVEL, "Compressed line %d/%d is damaged, dropped", track, sector);
+		return 0;
+	}
+	return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zcache_put
+// Description  : Compress a line evicted from the LRU list, evicting old
+//                compressed lines until there is a chunk for it.  A line
+//                that does not compress is kept as it is.
+//
+// Inputs       : track - the track
+//                sector - the sector
+//                buf - the data
+//                epoch - the lease epoch it was cached in
+// Outputs      : none
+
+void zcache_put(int track, int sector, char *buf, uint32_t epoch) {
+	uint8_t packed[FS3_SECTOR_SIZE];
+	uint32_t key = track * FS3_TRACK_SIZE + sector;
+	struct ZEntry *e, **link;
+	struct ZPage *pg;
+	uint16_t chunk;
+	uint8_t codec;
+	int len;
+
+	if ((e = zc_find(key, &link))) {
+		zc_remove(e, link, NULL);
+	}
+	if ((len = zc_pack((uint8_t *) buf, packed, &codec)) == FS3_SECTOR_SIZE) {
+		fs3_cur->zc_raw++;
+	}
+	while (!(pg = zc_alloc((len - 1) / FS3_ZC_CLASS, &chunk))) {
+		if (!fs3_cur->zc_head) {
+			if (fs3_cur->l2) l2_cache_put(track, sector, buf, epoch);
+			return;
+		}
+		zc_evict();
+	}
+	if (!(e = (struct ZEntry *) malloc(sizeof(struct ZEntry)))) {
+		zc_free_chunk(pg, chunk);
+		if (fs3_cur->l2) l2_cache_put(track, sector, buf, epoch);
+		return;
+	}
+	memcpy(pg->data + chunk * ZC_CHUNK(pg->cls), packed, len);
+	e->key = key;
+	e->epoch = epoch;
+	e->len = len;
+	e->chunk = chunk;
+	e->codec = codec;
+	e->page = pg;
+	zc_find(key, &link);
+	e->hnext = NULL;
+	*link = e;
+	e->next = NULL;
+	e->prev = fs3_cur->zc_tail;
+	if (fs3_cur->zc_tail) fs3_cur->zc_tail->next = e;
+	else fs3_cur->zc_head = e;
+	fs3_cur->zc_tail = e;
+	fs3_cur->zc_count++;
+	if (fs3_cur->cache_size + fs3_cur->zc_count > fs3_cur->zc_peak) {
+		fs3_cur->zc_peak = fs3_cur->cache_size + fs3_cur->zc_count;
+	}
+	fs3_cur->zc_bytes += len;
+	fs3_cur->zc_stores++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zcache_drop
+// Description  : Forget a compressed line that is out of date
+//
+// Inputs       : track - the track
+//                sector - the sector
+// Outputs      : none
+
+void zcache_drop(int track, int sector) {
+	struct ZEntry *e, **link;
+
+	if ((e = zc_find(track * FS3_TRACK_SIZE + sector, &link))) {
+		zc_remove(e, link, NULL);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zcache_shrink
+// Description  : Change the pages the tier may use, evicting lines until it
+//                holds no more than that
+//
+// Inputs       : pages - the new limit
+// Outputs      : none
+
+void zcache_shrink(uint32_t pages) {
+	struct ZPage *pg;
+
+	fs3_cur->zc_max_pages = pages;
+	while (fs3_cur->zc_pages > pages) {
+		if ((pg = fs3_cur->zc_free)) {
+			zc_unlink_page(&fs3_cur->zc_free, pg);
+			free(pg);
+			fs3_cur->zc_pages--;
+		} else {
+			zc_evict();
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Function     : zcache_log
+// Description  : Log the compressed tier's use
+//
+// Inputs       : none
+// Outputs      : none
+
+void zcache_log(void) {
+	logMessage(LOG_OUTPUT_LEVEL, "Compressed tier  : %u KB of %u lines, up to %u lines cached at once with %u uncompressed",
+		fs3_cur->zc_max_pages * (FS3_ZC_PAGE / 1024), fs3_cur->cache_capacity + fs3_cur->zc_max_pages *
+		(FS3_ZC_PAGE / FS3_SECTOR_SIZE), fs3_cur->zc_peak, fs3_cur->cache_capacity);
+	logMessage(LOG_OUTPUT_LEVEL, "Compressed ratio [%9.2f]", fs3_cur->zc_bytes ?
+		(double) fs3_cur->zc_stores * FS3_SECTOR_SIZE / fs3_cur->zc_bytes : 0.0);
+	logMessage(LOG_OUTPUT_LEVEL, "Compressed stores[%9lu]", fs3_cur->zc_stores);
+	logMessage(LOG_OUTPUT_LEVEL, "Compressed hits  [%9lu]", fs3_cur->zc_hits);
+	logMessage(LOG_OUTPUT_LEVEL, "Stored raw       [%9lu]", fs3_cur->zc_raw);
+}